@@ -0,0 +1,196 @@
+#include "BowIndex.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+static const char BOW_MAGIC[8] = {'C', 'B', 'I', 'R', 'B', 'O', 'W', '\0'};
+
+template <typename T>
+static bool readValue(ifstream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+template <typename T>
+static void writeValue(ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void BowIndex::setVocabulary(VisualVocabulary&& trained) {
+    vocab = std::move(trained);
+    clearImages();
+}
+
+void BowIndex::clearImages() {
+    imageOffsets.assign(1, 0);
+    entries.clear();
+    idf.clear();
+    inverseNorms.clear();
+    postingOffsets.clear();
+    postings.clear();
+}
+
+void BowIndex::clear() {
+    vocab.clear();
+    clearImages();
+}
+
+void BowIndex::quantize(const uint8_t* descriptors, size_t count, vector<WordCount>& histogram) const {
+    histogram.clear();
+    thread_local vector<uint32_t> words;
+    words.resize(count);
+    const size_t bytes = vocab.descriptorBytes();
+    for (size_t i = 0; i < count; ++i) words[i] = vocab.quantize(descriptors + i * bytes);
+    sort(words.begin(), words.end());
+    for (uint32_t word : words) {
+        if (!histogram.empty() && histogram.back().first == word) ++histogram.back().second;
+        else histogram.emplace_back(word, 1);
+    }
+}
+
+void BowIndex::append(const DescriptorStore& store) {
+    if (empty() || store.descriptorBytes() != vocab.descriptorBytes() || store.images() <= images()) return;
+    const size_t first = images(), count = store.images() - first;
+    vector<vector<WordCount>> histograms(count);
+    ThreadPool::shared().parallelFor(0, count, [&](size_t i, size_t) {
+        quantize(store.descriptors(first + i), store.count(first + i), histograms[i]);
+    }, 16);
+    for (const auto& histogram : histograms) {
+        entries.insert(entries.end(), histogram.begin(), histogram.end());
+        imageOffsets.push_back(entries.size());
+    }
+    rebuildInvertedFile();
+}
+
+void BowIndex::rebuildInvertedFile() {
+    const size_t words = vocab.words(), imageCount = images();
+
+    // Danh sách ngược dạng CSR, các ảnh trong một danh sách theo thứ tự tăng dần
+    postingOffsets.assign(words + 1, 0);
+    for (const auto& entry : entries) postingOffsets[entry.first + 1]++;
+    for (size_t w = 0; w < words; ++w) postingOffsets[w + 1] += postingOffsets[w];
+    postings.resize(entries.size());
+    vector<uint64_t> cursor(postingOffsets.begin(), postingOffsets.end() - 1);
+    for (size_t i = 0; i < imageCount; ++i) {
+        for (uint64_t e = imageOffsets[i]; e < imageOffsets[i + 1]; ++e) {
+            postings[cursor[entries[e].first]++] = Posting{static_cast<uint32_t>(i), entries[e].second};
+        }
+    }
+
+    // Từ có trong mọi ảnh có idf = 0 và không ảnh hưởng tới kết quả
+    idf.assign(words, 0.0f);
+    for (size_t w = 0; w < words; ++w) {
+        const uint64_t df = postingOffsets[w + 1] - postingOffsets[w];
+        if (df > 0) idf[w] = static_cast<float>(std::log(double(imageCount) / double(df)));
+    }
+    inverseNorms.assign(imageCount, 0.0f);
+    for (size_t i = 0; i < imageCount; ++i) {
+        double norm = 0.0;
+        for (uint64_t e = imageOffsets[i]; e < imageOffsets[i + 1]; ++e) {
+            const double weight = double(entries[e].second) * idf[entries[e].first];
+            norm += weight * weight;
+        }
+        if (norm > 0.0) inverseNorms[i] = static_cast<float>(1.0 / std::sqrt(norm));
+    }
+}
+
+void BowIndex::search(const uint8_t* descriptors, size_t count, const uint8_t* dead, TopK& best) const {
+    if (empty() || images() == 0 || count == 0) return;
+    quantize(descriptors, count, queryWords);
+
+    double queryNorm = 0.0;
+    for (const auto& word : queryWords) {
+        const double weight = double(word.second) * idf[word.first];
+        queryNorm += weight * weight;
+    }
+    if (queryNorm <= 0.0) return;
+    const float queryScale = static_cast<float>(1.0 / std::sqrt(queryNorm));
+
+    // Tích vô hướng chỉ được cộng dồn cho các ảnh trong danh sách của các từ của query
+    scores.resize(images(), 0.0f);
+    touched.clear();
+    for (const auto& word : queryWords) {
+        const float weight = idf[word.first];
+        if (weight <= 0.0f) continue;
+        // q_w * idf_w, phần idf_w của ảnh được nhân vào đây luôn (x_w = count * idf_w / ||x||)
+        const float queryWeight = float(word.second) * weight * queryScale * weight;
+        for (uint64_t p = postingOffsets[word.first]; p < postingOffsets[word.first + 1]; ++p) {
+            const Posting& posting = postings[p];
+            if (scores[posting.image] == 0.0f) touched.push_back(posting.image);
+            scores[posting.image] += queryWeight * float(posting.count);
+        }
+    }
+    for (uint32_t image : touched) {
+        const double cosine = min(1.0, double(scores[image]) * inverseNorms[image]);
+        scores[image] = 0.0f;
+        if (dead && dead[image]) continue;
+        best.push(std::sqrt(max(0.0, 2.0 - 2.0 * cosine)), image);
+    }
+}
+
+bool BowIndex::save(const string& filePath, uint64_t pathsHash) const {
+    string tmpPath = filePath + ".tmp";
+    {
+        ofstream out(tmpPath, ios::binary | ios::trunc);
+        if (!out.is_open()) {
+            cerr << "Error opening file for writing: " << tmpPath << endl;
+            return false;
+        }
+        out.write(BOW_MAGIC, sizeof(BOW_MAGIC));
+        writeValue(out, VERSION);
+        writeValue(out, uint32_t(0));
+        writeValue(out, static_cast<uint64_t>(images()));
+        writeValue(out, pathsHash);
+        vocab.write(out);
+        out.write(reinterpret_cast<const char*>(imageOffsets.data()), imageOffsets.size() * sizeof(uint64_t));
+        out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(WordCount));
+        if (!out.good()) {
+            cerr << "[BowIndex] Failed writing " << tmpPath << endl;
+            return false;
+        }
+    }
+    error_code ec;
+    filesystem::rename(tmpPath, filePath, ec);
+    if (ec) {
+        cerr << "[BowIndex] Cannot move " << tmpPath << " to " << filePath << ": " << ec.message() << endl;
+        return false;
+    }
+    return true;
+}
+
+bool BowIndex::load(const string& filePath, uint64_t& pathsHash) {
+    clear();
+    ifstream in(filePath, ios::binary);
+    if (!in.is_open()) return false;
+
+    char magic[8];
+    uint32_t version, reserved;
+    uint64_t imageCount;
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, BOW_MAGIC, sizeof(magic)) != 0 ||
+        !readValue(in, version) || version != VERSION || !readValue(in, reserved) || !readValue(in, imageCount) ||
+        !readValue(in, pathsHash) || !vocab.read(in)) {
+        cerr << "[BowIndex] Invalid index: " << filePath << endl;
+        clear();
+        return false;
+    }
+    imageOffsets.resize(imageCount + 1);
+    bool ok = static_cast<bool>(in.read(reinterpret_cast<char*>(imageOffsets.data()), imageOffsets.size() * sizeof(uint64_t)));
+    ok = ok && imageOffsets[0] == 0 && is_sorted(imageOffsets.begin(), imageOffsets.end());
+    if (ok) {
+        entries.resize(imageOffsets.back());
+        ok = entries.empty() || in.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(WordCount));
+    }
+    for (size_t e = 0; ok && e < entries.size(); ++e) ok = entries[e].first < vocab.words();
+    if (!ok) {
+        cerr << "[BowIndex] Truncated index: " << filePath << endl;
+        clear();
+        return false;
+    }
+    rebuildInvertedFile();
+    return true;
+}
@@ -0,0 +1,232 @@
+#include "BuildPipeline.h"
+#include "BoundedQueue.h"
+#include "CvThreadScope.h"
+#include "Hash.h"
+#include <opencv2/imgcodecs.hpp>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+using namespace cv;
+
+typedef chrono::steady_clock Clock;
+
+static uint64_t nanosSince(Clock::time_point start) {
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count());
+}
+
+// Push có đo thời gian bị chặn (backpressure từ stage phía sau)
+static void timedPush(BoundedQueue<BuildPipeline::Item*>& queue, BuildPipeline::Item* item,
+                      BuildPipeline::StageStats& stats) {
+    if (queue.tryPush(item)) return;
+    Clock::time_point start = Clock::now();
+    queue.push(item);
+    stats.blockedNanos += nanosSince(start);
+}
+
+static bool readFile(const string& path, vector<uchar>& bytes) {
+    ifstream in(path, ios::binary | ios::ate);
+    if (!in.is_open()) return false;
+    streamsize size = in.tellg();
+    if (size <= 0) return false;
+    bytes.resize(static_cast<size_t>(size));
+    in.seekg(0);
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(bytes.data()), size));
+}
+
+BuildPipeline::BuildPipeline(const FeatureExtractor& prototype)
+    : BuildPipeline(prototype, Options()) {}
+
+BuildPipeline::BuildPipeline(const FeatureExtractor& prototype, const Options& options)
+    : prototype(prototype), options(options) {
+    size_t hw = max(1u, thread::hardware_concurrency());
+    if (this->options.decodeThreads == 0) this->options.decodeThreads = max<size_t>(1, hw / 4);
+    if (this->options.extractThreads == 0) this->options.extractThreads = hw;
+    this->options.queueDepth = max<size_t>(2, this->options.queueDepth);
+}
+
+void BuildPipeline::run(const vector<string>& paths, const Sink& sink) {
+    for (auto& stage : stageStats) {
+        stage.items = 0;
+        stage.bytes = 0;
+        stage.busyNanos = 0;
+        stage.blockedNanos = 0;
+    }
+    stageStats[Decode].threads = options.decodeThreads;
+    stageStats[Extract].threads = options.extractThreads;
+    Clock::time_point wallStart = Clock::now();
+
+    BoundedQueue<Item*> readQueue(options.queueDepth);
+    BoundedQueue<Item*> decodeQueue(options.queueDepth);
+    BoundedQueue<Item*> extractQueue(options.queueDepth);
+    const size_t maxInFlight = options.queueDepth * 4 + options.decodeThreads + options.extractThreads;
+    atomic<size_t> committed{0};
+    atomic<bool> aborted{false};
+
+    // Mỗi luồng extract có extractor riêng
+    vector<unique_ptr<FeatureExtractor>> extractors;
+    for (size_t i = 0; i < options.extractThreads; ++i) {
+        extractors.push_back(prototype.clone());
+    }
+
+    // OpenCV chạy đơn luồng bên trong mỗi stage để tránh tranh chấp CPU
+    CvThreadScope cvThreads;
+
+    vector<thread> threads;
+
+    // Stage 1: đọc file từ đĩa
+    threads.emplace_back([&] {
+        StageStats& stats = stageStats[Read];
+        for (size_t i = 0; i < paths.size() && !aborted; ++i) {
+            // Không đọc quá xa so với luồng ghi: giới hạn bộ nhớ
+            for (unsigned spins = 0; i >= committed.load() + maxInFlight && !aborted; ++spins) {
+                BoundedQueue<Item*>::backoff(spins);
+            }
+            Clock::time_point start = Clock::now();
+            Item* item = new Item();
+            item->index = i;
+            item->path = &paths[i];
+            if (readFile(paths[i], item->bytes)) {
+                item->contentHash = fnv1a64(item->bytes.data(), item->bytes.size());
+                FeatureCache* cache = options.cache;
+                item->bytesRead = item->bytes.size();
+                if (cache && cache->lookup(item->contentHash, item->bytesRead, item->features)) {
+                    item->cached = true;
+                }
+            } else {
+                item->error = "read failed";
+            }
+            stats.items++;
+            stats.bytes += item->bytes.size();
+            stats.busyNanos += nanosSince(start);
+            timedPush(readQueue, item, stats);
+        }
+        readQueue.close();
+    });
+
+    // Stage 2: giải mã ảnh
+    atomic<size_t> decodersLeft{options.decodeThreads};
+    for (size_t t = 0; t < options.decodeThreads; ++t) {
+        threads.emplace_back([&] {
+            StageStats& stats = stageStats[Decode];
+            Item* item;
+            while (readQueue.pop(item)) {
+                Clock::time_point start = Clock::now();
+                if (item->error.empty() && !item->cached) {
+                    // Dữ liệu hỏng có thể làm imdecode ném cv::Exception: ghi vào item thay vì để
+                    // exception thoát khỏi luồng (std::terminate)
+                    try {
+                        item->image = imdecode(item->bytes, IMREAD_COLOR);
+                        if (item->image.empty()) item->error = "decode failed";
+                    } catch (const exception& e) {
+                        item->error = string("decode failed: ") + e.what();
+                    }
+                }
+                vector<uchar>().swap(item->bytes);
+                stats.items++;
+                stats.busyNanos += nanosSince(start);
+                timedPush(decodeQueue, item, stats);
+            }
+            if (--decodersLeft == 0) decodeQueue.close();
+        });
+    }
+
+    // Stage 3: trích xuất đặc trưng
+    atomic<size_t> extractorsLeft{options.extractThreads};
+    for (size_t t = 0; t < options.extractThreads; ++t) {
+        threads.emplace_back([&, t] {
+            StageStats& stats = stageStats[Extract];
+            Item* item;
+            while (decodeQueue.pop(item)) {
+                Clock::time_point start = Clock::now();
+                if (item->error.empty() && !item->cached) {
+                    try {
+                        item->features = extractors[t]->extract(item->image);
+                    } catch (const exception& e) {
+                        item->error = e.what();
+                    }
+                }
+                item->image.release();
+                stats.items++;
+                stats.busyNanos += nanosSince(start);
+                timedPush(extractQueue, item, stats);
+            }
+            if (--extractorsLeft == 0) extractQueue.close();
+        });
+    }
+
+    // Stage 4: ghi theo đúng thứ tự (trên luồng gọi), dùng bộ đệm sắp xếp lại
+    exception_ptr sinkError;
+    {
+        StageStats& stats = stageStats[Write];
+        map<size_t, Item*> reorder;
+        size_t next = 0;
+        Item* item;
+        while (extractQueue.pop(item)) {
+            reorder[item->index] = item;
+            for (auto it = reorder.find(next); it != reorder.end(); it = reorder.find(next)) {
+                unique_ptr<Item> ready(it->second);
+                reorder.erase(it);
+                Clock::time_point start = Clock::now();
+                if (options.cache && !ready->cached && ready->error.empty()) {
+                    options.cache->insert(ready->contentHash, ready->bytesRead, ready->features);
+                }
+                if (!aborted) {
+                    try {
+                        sink(*ready);
+                    } catch (...) {
+                        sinkError = current_exception();
+                        aborted = true;
+                    }
+                }
+                stats.items++;
+                stats.busyNanos += nanosSince(start);
+                committed = ++next;
+            }
+        }
+        for (auto& entry : reorder) delete entry.second;
+    }
+
+    for (auto& t : threads) t.join();
+    wallSeconds = nanosSince(wallStart) * 1e-9;
+    if (sinkError) rethrow_exception(sinkError);
+}
+
+void BuildPipeline::printStats(ostream& stream) const {
+    // Định dạng trong một stream riêng: không đổi fixed/precision của stream gọi (cout)
+    ostringstream out;
+    static const char* names[StageCount] = {"read", "decode", "extract", "write"};
+    int bottleneck = 0;
+    double worstPerThread = -1.0;
+    out << "[BuildPipeline] " << stageStats[Write].items << " images in "
+        << fixed << setprecision(2) << wallSeconds << " s" << endl;
+    for (int s = 0; s < StageCount; ++s) {
+        const StageStats& stats = stageStats[s];
+        double busy = stats.busyNanos * 1e-9;
+        double perThread = busy / max<size_t>(1, stats.threads);
+        double rate = perThread > 0 ? stats.items / perThread : 0.0;
+        out << "  " << left << setw(8) << names[s] << right
+            << stats.items << " items, " << stats.threads << " thread(s), busy "
+            << setprecision(2) << busy << " s, blocked " << stats.blockedNanos * 1e-9 << " s, "
+            << setprecision(1) << rate << " img/s";
+        if (stats.bytes > 0) out << ", " << stats.bytes / (1024.0 * 1024.0) << " MB";
+        out << endl;
+        if (perThread > worstPerThread) {
+            worstPerThread = perThread;
+            bottleneck = s;
+        }
+    }
+    if (options.cache) {
+        out << "  cache: " << options.cache->hits() << " hits, "
+            << options.cache->entries() << " entries" << endl;
+    }
+    out << "  bottleneck: " << names[bottleneck] << endl;
+    stream << out.str();
+}
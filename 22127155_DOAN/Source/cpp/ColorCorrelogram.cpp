@@ -1,4 +1,5 @@
 #include "ColorCorrelogram.h"
+#include "DistanceKernels.h"
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
 
@@ -32,14 +33,27 @@ std::vector<float> ColorCorrelogram::extract(const cv::Mat& image) {
     return features;
 }
 
-double ColorCorrelogram::compare(const std::vector<float>& feat1, const std::vector<float>& feat2) {
-    // Sử dụng khoảng cách Euclidean
-    double sum = 0.0;
-    for (size_t i = 0; i < feat1.size(); ++i) {
-        double diff = feat1[i] - feat2[i];
-        sum += diff * diff;
+double ColorCorrelogram::compare(const std::vector<float>& feat1, const std::vector<float>& feat2) const {
+    return compareRaw(feat1.data(), feat2.data(), feat1.size());
+}
+
+double ColorCorrelogram::compareRaw(const float* feat1, const float* feat2, size_t dim) const {
+    // Khoảng cách Euclidean (kernel SIMD chọn theo CPU)
+    return DistanceKernels::l2(feat1, feat2, dim);
+}
+
+double ColorCorrelogram::compareBounded(const float* feat1, const float* feat2, size_t dim, double bound) const {
+    // Dừng sớm khi tổng riêng phần vượt ngưỡng
+    return DistanceKernels::l2Bounded(feat1, feat2, dim, bound);
+}
+
+std::string ColorCorrelogram::getConfig() const {
+    std::string config = getMethodName() + "(bins=" + std::to_string(colorBins) + ",dists=";
+    for (size_t i = 0; i < distances.size(); ++i) {
+        if (i != 0) config += ";";
+        config += std::to_string(distances[i]);
     }
-    return std::sqrt(sum);
+    return config + ",hsv=" + std::to_string(useHSV) + ")";
 }
 
 cv::Mat ColorCorrelogram::quantizeImage(const cv::Mat& image) {
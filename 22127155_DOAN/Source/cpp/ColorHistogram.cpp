@@ -1,4 +1,5 @@
 #include "ColorHistogram.h"
+#include "DistanceKernels.h"
 #include <opencv2/imgproc.hpp>
 
 ColorHistogram::ColorHistogram(int bins, bool hsv) 
@@ -31,14 +32,22 @@ std::vector<float> ColorHistogram::extract(const cv::Mat& image) {
     return features;
 }
 
-double ColorHistogram::compare(const std::vector<float>& feat1, const std::vector<float>& feat2) {
-    // Sử dụng khoảng cách Euclidean
-    double sum = 0.0;
-    for (size_t i = 0; i < feat1.size(); ++i) {
-        double diff = feat1[i] - feat2[i];
-        sum += diff * diff;
-    }
-    return std::sqrt(sum);
+double ColorHistogram::compare(const std::vector<float>& feat1, const std::vector<float>& feat2) const {
+    return compareRaw(feat1.data(), feat2.data(), feat1.size());
+}
+
+double ColorHistogram::compareRaw(const float* feat1, const float* feat2, size_t dim) const {
+    // Khoảng cách Euclidean (kernel SIMD chọn theo CPU)
+    return DistanceKernels::l2(feat1, feat2, dim);
+}
+
+double ColorHistogram::compareBounded(const float* feat1, const float* feat2, size_t dim, double bound) const {
+    // Dừng sớm khi tổng riêng phần vượt ngưỡng
+    return DistanceKernels::l2Bounded(feat1, feat2, dim, bound);
+}
+
+std::string ColorHistogram::getConfig() const {
+    return getMethodName() + "(bins=" + std::to_string(binsPerChannel) + ",hsv=" + std::to_string(useHSV) + ")";
 }
 
 cv::Mat ColorHistogram::computeHistogram(const cv::Mat& image) {
@@ -1,5 +1,8 @@
 #include "CombinedFeature.h"
 #include <stdexcept>
+#include <sstream>
+#include <limits>
+#include <algorithm>
 
 using namespace cv;
 using namespace std;
@@ -19,6 +22,14 @@ CombinedFeature::CombinedFeature(vector<unique_ptr<FeatureExtractor>>&& extracto
     }
 }
 
+unique_ptr<FeatureExtractor> CombinedFeature::clone() const {
+    vector<unique_ptr<FeatureExtractor>> copies;
+    for (const auto& extractor : extractors) {
+        copies.push_back(extractor->clone());
+    }
+    return make_unique<CombinedFeature>(std::move(copies), weights);
+}
+
 vector<float> CombinedFeature::extract(const Mat& image) {
     if (image.empty()) {
         throw runtime_error("Empty image provided to CombinedFeature");
@@ -43,17 +54,40 @@ vector<float> CombinedFeature::extract(const Mat& image) {
     return combinedFeatures;
 }
 
-double CombinedFeature::compare(const vector<float>& feat1, const vector<float>& feat2) {
+double CombinedFeature::compare(const vector<float>& feat1, const vector<float>& feat2) const {
+    return compareRaw(feat1.data(), feat2.data(), min(feat1.size(), feat2.size()));
+}
+
+double CombinedFeature::compareRaw(const float* feat1, const float* feat2, size_t dim) const {
     double totalDistance = 0.0;
     size_t startIdx = 0;
     for (size_t i = 0; i < extractors.size(); ++i) {
         size_t featSize = featureDims[i];
-        if (startIdx + featSize > feat1.size() || startIdx + featSize > feat2.size()) {
+        if (startIdx + featSize > dim) {
             throw std::runtime_error("CombinedFeature::compare: Feature vector size mismatch or extractor returned fewer features than expected.");
         }
-        vector<float> subFeat1(feat1.begin() + startIdx, feat1.begin() + startIdx + featSize);
-        vector<float> subFeat2(feat2.begin() + startIdx, feat2.begin() + startIdx + featSize);
-        totalDistance += weights[i] * extractors[i]->compare(subFeat1, subFeat2);
+        // Mỗi extractor so sánh trực tiếp trên đoạn con, không tạo vector tạm
+        totalDistance += weights[i] * extractors[i]->compareRaw(feat1 + startIdx, feat2 + startIdx, featSize);
+        startIdx += featSize;
+    }
+    return totalDistance;
+}
+
+double CombinedFeature::compareBounded(const float* feat1, const float* feat2, size_t dim, double bound) const {
+    // Tổng có trọng số chỉ tăng khi mọi trọng số >= 0: mỗi thành phần nhận phần ngưỡng còn lại
+    if (any_of(weights.begin(), weights.end(), [](double w) { return w < 0.0; })) {
+        return compareRaw(feat1, feat2, dim);
+    }
+    double totalDistance = 0.0;
+    size_t startIdx = 0;
+    for (size_t i = 0; i < extractors.size(); ++i) {
+        size_t featSize = featureDims[i];
+        if (startIdx + featSize > dim) {
+            throw std::runtime_error("CombinedFeature::compareBounded: Feature vector size mismatch or extractor returned fewer features than expected.");
+        }
+        double remaining = weights[i] > 0.0 ? (bound - totalDistance) / weights[i] : numeric_limits<double>::infinity();
+        totalDistance += weights[i] * extractors[i]->compareBounded(feat1 + startIdx, feat2 + startIdx, featSize, remaining);
+        if (totalDistance > bound) return numeric_limits<double>::infinity();
         startIdx += featSize;
     }
     return totalDistance;
@@ -66,4 +100,15 @@ string CombinedFeature::getMethodName() const {
     }
     name.pop_back(); // Remove last '+'
     return name;
-}
\ No newline at end of file
+}
+
+string CombinedFeature::getConfig() const {
+    ostringstream oss;
+    oss << "Combined(";
+    for (size_t i = 0; i < extractors.size(); ++i) {
+        if (i != 0) oss << "+";
+        oss << extractors[i]->getConfig() << "*" << weights[i];
+    }
+    oss << ")";
+    return oss.str();
+}
@@ -1,14 +1,23 @@
 #include "DatabaseManager.h"
+#include "FeatureStore.h"
+#include "BuildPipeline.h"
+#include "StreamingBuild.h"
+#include "ThreadPool.h"
+#include "CvThreadScope.h"
+#include "TopK.h"
+#include "DistanceKernels.h"
+#include "Hash.h"
 #include <fstream>
 #include <sstream>
 #include <algorithm>
 #include <filesystem>
+#include <unordered_map>
 
 using namespace std;
 using namespace cv;
 
 DatabaseManager::DatabaseManager(FeatureExtractor* extractor) 
-    : extractor(extractor) {}
+    : extractor(extractor), localFeature(dynamic_cast<const LocalFeature*>(extractor)) {}
 
 DatabaseManager::~DatabaseManager() {
     delete extractor;
@@ -19,26 +28,1056 @@ std::string DatabaseManager::getDatabasePath(const std::string& method, const st
     std::filesystem::path dsPath(datasetPath);
     // Nếu muốn chắc chắn không trùng, có thể dùng hash:
     std::size_t hashVal = std::hash<std::string>{}(datasetPath);
-    return "build/database/" + method + "_" + std::to_string(hashVal) + "_features.csv";
+    return "build/database/" + method + "_" + std::to_string(hashVal) + "_features.fdb";
     // return "build/database/" + method + "_" + datasetName + "_features.csv";
 }
 
 void DatabaseManager::buildDatabase(const vector<string>& imagePaths) {
     cout << "Building database" << endl;
-    featuresDB.clear();
-    for (const auto& path : imagePaths) {
-        Mat image = imread(path);
-        if (image.empty()) {
-            std::cerr << "[DEBUG] imread failed for: " << path << std::endl;
+    clearDatabase();
+
+    // Sắp xếp và loại trùng để thứ tự hàng luôn xác định
+    vector<string> sortedPaths(imagePaths);
+    sort(sortedPaths.begin(), sortedPaths.end());
+    sortedPaths.erase(unique(sortedPaths.begin(), sortedPaths.end()), sortedPaths.end());
+
+    // Pipeline đọc -> giải mã -> trích xuất -> ghi; các hàng được ghi theo đúng thứ tự
+    // đường dẫn nên kết quả giống hệt bản build tuần tự
+    BuildPipeline pipeline(*extractor, buildOptions());
+    pipeline.run(sortedPaths, [&](BuildPipeline::Item& item) {
+        if (!item.error.empty()) {
+            std::cerr << "[DEBUG] " << item.error << " for: " << *item.path << std::endl;
+            return;
+        }
+        addEntry(*item.path, item.features);
+    });
+    pipeline.printStats(cout);
+}
+
+bool DatabaseManager::buildDatabase(const vector<string>& imagePaths, const string& filePath) {
+    cout << "Building database" << endl;
+    clearDatabase();
+
+    vector<string> sortedPaths(imagePaths);
+    sort(sortedPaths.begin(), sortedPaths.end());
+    sortedPaths.erase(unique(sortedPaths.begin(), sortedPaths.end()), sortedPaths.end());
+
+    // Manifest cũ không còn đúng với file sắp được ghi
+    std::error_code ec;
+    std::filesystem::remove(Manifest::pathFor(filePath), ec);
+
+    StreamingBuild build(filePath, extractor->getConfig(), storeFlags());
+    size_t done = build.begin(sortedPaths);
+    if (done > 0) {
+        cout << "Resuming build: " << done << "/" << sortedPaths.size() << " images already committed" << endl;
+    }
+
+    vector<string> remaining(sortedPaths.begin() + done, sortedPaths.end());
+    unordered_map<string, uint64_t> contentHashes;
+    BuildPipeline pipeline(*extractor, buildOptions());
+    pipeline.run(remaining, [&](BuildPipeline::Item& item) {
+        if (item.contentHash != 0) contentHashes[*item.path] = item.contentHash;
+        if (!item.error.empty()) {
+            std::cerr << "[DEBUG] " << item.error << " for: " << *item.path << std::endl;
+            item.features.clear();
+        }
+        // Ảnh lỗi cũng được ghi (rỗng) để lần resume sau không xử lý lại
+        if (!build.append(*item.path, item.features)) {
+            throw runtime_error("Cannot write build segment for: " + filePath);
+        }
+    });
+    pipeline.printStats(cout);
+
+    if (!build.finish() || !openDatabase(filePath)) return false;
+
+    // Manifest cho các lần cập nhật sau; ảnh đã commit trước khi resume không có hash
+    vector<ManifestEntry> entries;
+    entries.reserve(sortedPaths.size());
+    for (const auto& path : sortedPaths) {
+        ManifestEntry entry;
+        entry.path = path;
+        if (!Manifest::statFile(path, entry.size, entry.mtime)) continue;
+        auto hash = contentHashes.find(path);
+        if (hash != contentHashes.end()) entry.contentHash = hash->second;
+        uint32_t id;
+        entry.row = pathCatalog.find(path, id) ? id : Manifest::NO_ROW;
+        entries.push_back(std::move(entry));
+    }
+    Manifest manifest;
+    manifest.assign(std::move(entries));
+    manifest.setRowCount(rowPathIds.size());
+    if (!manifest.save(Manifest::pathFor(filePath))) {
+        cerr << "[DatabaseManager] Could not write manifest, next run will rebuild: " << filePath << endl;
+    }
+    return true;
+}
+
+bool DatabaseManager::updateDatabase(const vector<string>& imagePaths, const string& filePath) {
+    // Mở ở chế độ streaming: chỉ cần header và bảng đường dẫn, không build index cho file sắp đổi
+    Manifest manifest;
+    if (!std::filesystem::exists(filePath) || !manifest.load(Manifest::pathFor(filePath)) ||
+        !openDatabase(filePath, true) || !mappedDB.isOpen() || manifest.rowCount() != mappedDB.rows()) {
+        cout << "No up-to-date manifest for " << filePath << ", building from scratch" << endl;
+        return buildDatabase(imagePaths, filePath);
+    }
+    const size_t dim = mappedDB.dimension();
+    const string config = mappedDB.config();
+
+    vector<string> sortedPaths(imagePaths);
+    sort(sortedPaths.begin(), sortedPaths.end());
+    sortedPaths.erase(unique(sortedPaths.begin(), sortedPaths.end()), sortedPaths.end());
+
+    // So sánh gallery với manifest: size + mtime giống nhau thì coi như không đổi
+    vector<ManifestEntry> entries;
+    vector<size_t> touched; // size/mtime khác: cần kiểm tra hash
+    vector<size_t> added;   // ảnh mới hoặc nội dung đã thay đổi: cần trích xuất
+    entries.reserve(sortedPaths.size());
+    size_t kept = 0;
+    for (const auto& path : sortedPaths) {
+        ManifestEntry entry;
+        entry.path = path;
+        if (!Manifest::statFile(path, entry.size, entry.mtime)) continue;
+        const ManifestEntry* old = manifest.find(path);
+        if (old && old->size == entry.size && old->mtime == entry.mtime) {
+            entries.push_back(*old);
+            kept++;
             continue;
         }
-        
-        vector<float> features = extractor->extract(image);
-        featuresDB[path] = features;
+        entry.row = Manifest::NO_ROW;
+        if (old && old->contentHash != 0) {
+            entry.contentHash = old->contentHash;
+            entry.row = old->row;
+            touched.push_back(entries.size());
+        } else {
+            added.push_back(entries.size());
+        }
+        entries.push_back(std::move(entry));
+    }
+    // File chỉ bị touch (copy, checkout...) có cùng hash thì giữ nguyên hàng cũ
+    vector<uint8_t> changed(touched.size(), 1);
+    ThreadPool::shared().parallelFor(0, touched.size(), [&](size_t i, size_t) {
+        uint64_t hash;
+        if (Manifest::hashFile(entries[touched[i]].path, hash) && hash == entries[touched[i]].contentHash) {
+            changed[i] = 0;
+        }
+    });
+    for (size_t i = 0; i < touched.size(); ++i) {
+        if (changed[i]) {
+            entries[touched[i]].row = Manifest::NO_ROW;
+            entries[touched[i]].contentHash = 0;
+            added.push_back(touched[i]);
+        } else {
+            kept++;
+        }
+    }
+    // Ảnh không còn trong gallery: hàng của chúng thành tombstone
+    size_t removed = count_if(manifest.entries().begin(), manifest.entries().end(), [&](const ManifestEntry& entry) {
+        return !binary_search(sortedPaths.begin(), sortedPaths.end(), entry.path);
+    });
+
+    cout << "Incremental update: " << kept << " unchanged, " << added.size()
+         << " new or changed, " << removed << " removed" << endl;
+
+    // Bỏ map trước khi ghi vào file
+    clearDatabase();
+    uint64_t rowCount = manifest.rowCount();
+    if (!added.empty()) {
+        sort(added.begin(), added.end());
+        vector<string> addedPaths;
+        addedPaths.reserve(added.size());
+        for (size_t i : added) addedPaths.push_back(entries[i].path);
+
+        FeatureStoreWriter writer;
+        if (!writer.openAppend(filePath, config, dim)) return buildDatabase(imagePaths, filePath);
+        BuildPipeline pipeline(*extractor, buildOptions());
+        pipeline.run(addedPaths, [&](BuildPipeline::Item& item) {
+            ManifestEntry& entry = entries[added[item.index]];
+            entry.contentHash = item.contentHash;
+            if (!item.error.empty()) {
+                std::cerr << "[DEBUG] " << item.error << " for: " << *item.path << std::endl;
+                return;
+            }
+            if (item.features.size() != dim) {
+                cerr << "[DatabaseManager] Skipping " << *item.path << ": dimension "
+                     << item.features.size() << " != " << dim << endl;
+                return;
+            }
+            entry.row = static_cast<uint32_t>(writer.rows());
+            if (!writer.append(*item.path, item.features.data())) {
+                throw runtime_error("Cannot append to database: " + filePath);
+            }
+        });
+        pipeline.printStats(cout);
+        if (!writer.close()) return false;
+        rowCount = writer.rows();
+    }
+
+    manifest.assign(std::move(entries));
+    manifest.setRowCount(rowCount);
+
+    // Nén lại khi tỉ lệ tombstone quá lớn
+    size_t dead = rowCount - manifest.liveRows();
+    if (rowCount > 0 && dead > rowCount * COMPACT_DEAD_RATIO) {
+        cout << "Compacting database: " << dead << "/" << rowCount << " rows are dead" << endl;
+        if (!compactDatabase(filePath, manifest)) return false;
+    }
+
+    if (!manifest.save(Manifest::pathFor(filePath))) return false;
+    return openDatabase(filePath);
+}
+
+bool DatabaseManager::compactDatabase(const string& filePath, Manifest& manifest) {
+    vector<string> paths;
+    FeatureStoreView view;
+    if (!view.open(filePath, paths, true)) return false;
+    const size_t dim = view.dimension();
+
+    // Hàng cũ -> hàng mới, giữ nguyên thứ tự
+    vector<uint32_t> newRow(view.rows(), Manifest::NO_ROW);
+    for (const auto& entry : manifest.entries()) {
+        if (entry.row != Manifest::NO_ROW && entry.row < newRow.size()) newRow[entry.row] = 0;
+    }
+    uint32_t live = 0;
+    for (auto& row : newRow) {
+        if (row != Manifest::NO_ROW) row = live++;
+    }
+
+    string tmpPath = filePath + ".compact";
+    FeatureStoreWriter writer;
+    if (!writer.open(tmpPath, view.config(), dim, view.flags())) return false;
+    view.scanBlocks([&](size_t firstRow, size_t count, const float* block) {
+        for (size_t r = 0; r < count; ++r) {
+            if (newRow[firstRow + r] != Manifest::NO_ROW) {
+                writer.append(paths[firstRow + r], block + r * dim);
+            }
+        }
+    });
+    view.close();
+    if (!writer.close()) return false;
+
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, filePath, ec);
+    if (ec) {
+        cerr << "[DatabaseManager] Cannot move " << tmpPath << " to " << filePath << ": " << ec.message() << endl;
+        return false;
+    }
+
+    vector<ManifestEntry> entries(manifest.entries());
+    for (auto& entry : entries) {
+        if (entry.row != Manifest::NO_ROW) entry.row = entry.row < newRow.size() ? newRow[entry.row] : Manifest::NO_ROW;
+    }
+    manifest.assign(std::move(entries));
+    manifest.setRowCount(live);
+    return true;
+}
+
+void DatabaseManager::loadTombstones(const string& filePath) {
+    deadRows.clear();
+    deadCount = 0;
+    Manifest manifest;
+    if (!std::filesystem::exists(Manifest::pathFor(filePath)) || !manifest.load(Manifest::pathFor(filePath))) {
+        return;
+    }
+    const size_t rows = rowPathIds.size();
+    if (manifest.rowCount() != rows) {
+        cerr << "[DatabaseManager] Manifest is out of date, ignoring tombstones: " << filePath << endl;
+        return;
+    }
+    deadRows.assign(rows, 1);
+    for (const auto& entry : manifest.entries()) {
+        if (entry.row < rows) deadRows[entry.row] = 0;
+    }
+    deadCount = count(deadRows.begin(), deadRows.end(), uint8_t(1));
+    if (deadCount == 0) deadRows.clear();
+}
+
+BuildPipeline::Options DatabaseManager::buildOptions() {
+    BuildPipeline::Options options;
+    if (featureCache.isOpen() || featureCache.open(FeatureCache::defaultDirectory(), extractor->getConfig())) {
+        options.cache = &featureCache;
+    }
+    return options;
+}
+
+void DatabaseManager::clearDatabase() {
+    mappedDB.close();
+    databasePath.clear();
+    matrixReleased = false;
+    featuresDB.clear();
+    rowPathIds.clear();
+    pathCatalog.clear();
+    deadRows.clear();
+    deadCount = 0;
+    rowNorms.clear();
+    columnStats = ColumnStats{};
+    blockOrder.clear();
+    blockOrderRows = 0;
+    ivfIndex.clear();
+    graphIndex.clear();
+    pqCodes.clear();
+    sqCodes.clear();
+    localDescriptors.clear();
+    bowIndex.clear();
+    descriptorIndex.clear();
+    pendingDescriptorIndex.clear();
+    lshIndex.clear();
+}
+
+bool DatabaseManager::addEntry(const string& path, const vector<float>& features) {
+    if (rowPathIds.empty()) {
+        featuresDB.reset(features.size());
+        columnStats.reset(features.size());
+    }
+    // Tất cả các hàng phải có cùng số chiều (fixed stride)
+    if (features.empty() || features.size() != featuresDB.dimension()) {
+        cerr << "[DatabaseManager] Skipping " << path << ": dimension "
+             << features.size() << " != " << featuresDB.dimension() << endl;
+        return false;
+    }
+    featuresDB.append(features.data());
+    // Hàng đóng gói của SIFT/ORB là byte descriptor, thống kê cột không có nghĩa
+    if (!localFeature) columnStats.add(features.data());
+    rowPathIds.push_back(pathCatalog.intern(path));
+    return true;
+}
+
+size_t DatabaseManager::databaseDimension() const {
+    return mappedDB.isOpen() ? mappedDB.dimension() : featuresDB.dimension();
+}
+
+void DatabaseManager::scanBlocks(const FeatureStoreView::BlockFn& fn) const {
+    if (mappedDB.isOpen()) {
+        mappedDB.scanBlocks(fn);
+    } else if (!featuresDB.empty()) {
+        fn(0, featuresDB.rows(), featuresDB.data());
     }
 }
 
+void DatabaseManager::prepareDescriptors() {
+    const size_t rows = rowPathIds.size();
+    const size_t bytes = localFeature->descriptorBytes();
+    if (localDescriptors.descriptorBytes() != bytes || localDescriptors.images() > rows) {
+        localDescriptors.reset(bytes);
+    }
+    if (localDescriptors.images() == rows) return;
+    if (!databasePath.empty() && mapDescriptors()) return;
+    const size_t first = localDescriptors.images();
+
+    // Chỉ đọc phần đầu có dữ liệu của mỗi hàng: trang toàn số 0 ở cuối hàng map không bị đọc
+    const size_t dim = databaseDimension();
+    localDescriptors.reserve(rows, 0);
+    scanBlocks([&](size_t firstRow, size_t count, const float* block) {
+        for (size_t r = 0; r < count; ++r) {
+            if (firstRow + r < first) continue;
+            localDescriptors.appendRow(block + r * dim, dim);
+        }
+    });
+    cout << "[DatabaseManager] " << localDescriptors.size() << " local descriptors ("
+         << localDescriptors.memoryBytes() / (1024.0 * 1024.0) << " MB) for "
+         << localDescriptors.images() << " images" << endl;
+}
+
+bool DatabaseManager::mapDescriptors() {
+    const size_t rows = rowPathIds.size();
+    const size_t bytes = localFeature->descriptorBytes();
+    const string storePath = DescriptorStore::pathFor(databasePath);
+    if (!localDescriptors.isMapped()) {
+        // Lần đầu: dùng file .dsc nếu nó khớp với các hàng đầu của database
+        uint64_t pathsHash;
+        if (!std::filesystem::exists(storePath) || !localDescriptors.map(storePath, bytes, pathsHash) ||
+            localDescriptors.images() > rows || rowPathsHash(localDescriptors.images()) != pathsHash) {
+            localDescriptors.reset(bytes);
+        }
+    }
+    const size_t first = localDescriptors.images();
+    if (first < rows) {
+        // Các hàng mới được nối vào bản sao của file rồi map lại, không chép descriptor vào heap
+        const size_t dim = databaseDimension();
+        DescriptorStoreWriter writer;
+        if (!writer.open(storePath, bytes) || !writer.append(localDescriptors)) return false;
+        bool ok = true;
+        scanBlocks([&](size_t firstRow, size_t count, const float* block) {
+            for (size_t r = 0; r < count && ok; ++r) {
+                if (firstRow + r >= first) ok = writer.appendRow(block + r * dim, dim);
+            }
+        });
+        localDescriptors.reset(bytes);
+        uint64_t pathsHash;
+        if (!ok || !writer.close(rowPathsHash(rows)) || !localDescriptors.map(storePath, bytes, pathsHash) ||
+            localDescriptors.images() != rows) {
+            cerr << "[DatabaseManager] Could not write " << storePath << ", keeping descriptors in memory" << endl;
+            localDescriptors.reset(bytes);
+            return false;
+        }
+        cout << "[DatabaseManager] " << localDescriptors.size() << " local descriptors of "
+             << rows << " images mapped from " << storePath << endl;
+    }
+    releaseMatrix();
+    return true;
+}
+
+void DatabaseManager::scanDescriptors(const float* queryFeatures, size_t dim, size_t k, const vector<QueryHit>* subset) {
+    prepareDescriptors();
+    const size_t nq = LocalFeature::packedCount(queryFeatures, dim, localFeature->descriptorBytes());
+    // Phần chuẩn bị phía query (SIFT: đổi sang float32, norm) dùng chung cho mọi ảnh
+    const unique_ptr<LocalFeature::PreparedQuery> prepared =
+        localFeature->prepareQuery(LocalFeature::packedDescriptors(queryFeatures), nq);
+    const size_t rows = subset ? subset->size() : localDescriptors.images();
+
+    // Mỗi ảnh là một lần match (đắt), chia thành đoạn nhỏ để work stealing cân bằng tải
+    ThreadPool& pool = ThreadPool::shared();
+    workerHeaps.resize(pool.size());
+    for (auto& heap : workerHeaps) heap.reset(k);
+    {
+        CvThreadScope cvThreads(pool.size() > 1);
+        pool.parallelFor(0, rows, [&](size_t r, size_t worker) {
+            const size_t i = subset ? (*subset)[r].row : r;
+            if (isDead(i)) return;
+            double distance = prepared->match(localDescriptors.descriptors(i), localDescriptors.count(i));
+            workerHeaps[worker].push(distance, static_cast<uint32_t>(i));
+        }, 8);
+    }
+    for (const auto& heap : workerHeaps) queryHeap.merge(heap);
+}
+
+const vector<float>& DatabaseManager::databaseNorms() {
+    if (mappedDB.isOpen() && mappedDB.norms().size() == mappedDB.rows()) {
+        return mappedDB.norms();
+    }
+    // Database trong bộ nhớ hoặc file version 1: tính một lần, dùng lại cho các lô sau
+    if (rowNorms.size() != rowPathIds.size()) {
+        const size_t dim = databaseDimension();
+        rowNorms.resize(rowPathIds.size());
+        scanBlocks([&](size_t firstRow, size_t count, const float* block) {
+            for (size_t r = 0; r < count; ++r) {
+                rowNorms[firstRow + r] = DistanceKernels::squaredNorm(block + r * dim, dim);
+            }
+        });
+    }
+    return rowNorms;
+}
+
+void DatabaseManager::prepareBlockOrder() {
+    const size_t dim = databaseDimension();
+    const size_t blocks = (dim + DistanceKernels::BOUND_BLOCK - 1) / DistanceKernels::BOUND_BLOCK;
+    if (!varianceOrdering || !extractor->usesL2Distance() || blocks < 2) {
+        blockOrder.clear();
+        return;
+    }
+    if (blockOrderRows == rowPathIds.size() && blockOrder.size() == blocks) return;
+
+    // Thống kê cột được ghi cùng file .fdb (version 3) hoặc cộng dồn khi thêm hàng; tombstone vẫn
+    // được tính, chúng chỉ ảnh hưởng thứ tự duyệt chứ không ảnh hưởng kết quả
+    const ColumnStats* stats = mappedDB.isOpen() ? &mappedDB.columnStats() : &columnStats;
+    if (stats->rows != rowPathIds.size() || stats->sums.size() != dim) {
+        columnStats.reset(dim);
+        scanBlocks([&](size_t, size_t count, const float* block) {
+            for (size_t r = 0; r < count; ++r) columnStats.add(block + r * dim);
+        });
+        stats = &columnStats;
+    }
+    // Phương sai từng chiều, cộng lại theo khối
+    vector<double> blockVariance(blocks, 0.0);
+    for (size_t j = 0; j < dim; ++j) {
+        blockVariance[j / DistanceKernels::BOUND_BLOCK] += stats->variance(j);
+    }
+    blockOrder.resize(blocks);
+    iota(blockOrder.begin(), blockOrder.end(), 0u);
+    stable_sort(blockOrder.begin(), blockOrder.end(), [&](uint32_t a, uint32_t b) {
+        return blockVariance[a] > blockVariance[b];
+    });
+    blockOrderRows = rowPathIds.size();
+}
+
 void DatabaseManager::saveDatabase(const string& filePath) {
+    if (std::filesystem::path(filePath).extension() == ".csv") {
+        saveDatabaseCSV(filePath);
+        return;
+    }
+    if (rowPathIds.empty()) {
+        cerr << "Database is empty, nothing to save: " << filePath << endl;
+        return;
+    }
+
+    const size_t dim = databaseDimension();
+    FeatureStoreWriter writer;
+    if (!writer.open(filePath, extractor->getConfig(), dim, storeFlags())) return;
+    scanBlocks([&](size_t firstRow, size_t count, const float* block) {
+        for (size_t r = 0; r < count; ++r) {
+            if (isDead(firstRow + r)) continue;
+            writer.append(rowPath(firstRow + r), block + r * dim);
+        }
+    });
+    writer.close();
+}
+
+bool DatabaseManager::loadDatabase(const string& filePath) {
+    if (!FeatureStore::isFeatureStore(filePath)) {
+        return loadDatabaseCSV(filePath);
+    }
+
+    FeatureStoreHeader header;
+    string config;
+    vector<string> paths;
+    FeatureMatrix matrix;
+    ColumnStats stats;
+    if (!FeatureStore::read(filePath, header, config, paths, matrix, stats)) {
+        return false;
+    }
+    if (config != extractor->getConfig()) {
+        cerr << "[DatabaseManager] Extractor config mismatch: file has '" << config
+             << "', expected '" << extractor->getConfig() << "'" << endl;
+        return false;
+    }
+
+    clearDatabase();
+    featuresDB = std::move(matrix);
+    columnStats = std::move(stats);
+    pathCatalog.assign(std::move(paths));
+    rowPathIds.resize(featuresDB.rows());
+    iota(rowPathIds.begin(), rowPathIds.end(), 0u);
+    loadGraphIndex(filePath);
+    if (graphIndex.empty()) loadIndex(filePath);
+    loadProductQuantizer(filePath);
+    loadScalarQuantizer(filePath);
+    loadVocabulary(filePath);
+    loadDescriptorIndex(filePath);
+    return true;
+}
+
+bool DatabaseManager::openDatabase(const string& filePath, bool streaming) {
+    if (!FeatureStore::isFeatureStore(filePath)) {
+        return loadDatabase(filePath);
+    }
+    clearDatabase();
+    vector<string> paths;
+    if (!mappedDB.open(filePath, paths, streaming)) {
+        return false;
+    }
+    if (mappedDB.config() != extractor->getConfig()) {
+        cerr << "[DatabaseManager] Extractor config mismatch: file has '" << mappedDB.config()
+             << "', expected '" << extractor->getConfig() << "'" << endl;
+        clearDatabase();
+        return false;
+    }
+
+    databasePath = filePath;
+    pathCatalog.assign(std::move(paths));
+    rowPathIds.resize(mappedDB.rows());
+    iota(rowPathIds.begin(), rowPathIds.end(), 0u);
+    if (mappedDB.matrixData()) {
+        featuresDB.setView(mappedDB.matrixData(), mappedDB.rows(), mappedDB.dimension());
+    }
+    loadTombstones(filePath);
+    loadGraphIndex(filePath);
+    if (graphIndex.empty()) loadIndex(filePath);
+    loadProductQuantizer(filePath);
+    loadScalarQuantizer(filePath);
+    loadVocabulary(filePath);
+    loadDescriptorIndex(filePath);
+    releaseMatrix();
+    return true;
+}
+
+void DatabaseManager::releaseMatrix() {
+    const size_t rows = rowPathIds.size();
+    const bool mappedDescriptors = localFeature && localDescriptors.isMapped() && localDescriptors.images() == rows;
+    const bool quantized = !rerankExact && graphIndex.empty() && ivfIndex.empty() &&
+                           (pqCodes.rows() == rows || sqCodes.rows() == rows);
+    if (!mappedDB.isMapped() || (!mappedDescriptors && !quantized)) return;
+    featuresDB.clear();
+    mappedDB.unmap();
+    matrixReleased = true;
+}
+
+void DatabaseManager::remapMatrix() {
+    if (!matrixReleased) return;
+    matrixReleased = false;
+    if (mappedDB.map()) featuresDB.setView(mappedDB.matrixData(), mappedDB.rows(), mappedDB.dimension());
+}
+
+void DatabaseManager::setRerank(bool enabled) {
+    rerankExact = enabled;
+    if (enabled) remapMatrix();
+    releaseMatrix();
+}
+
+uint64_t DatabaseManager::rowPathsHash(size_t rows) const {
+    uint64_t hash = fnv1a64(nullptr, 0);
+    for (size_t row = 0; row < rows; ++row) {
+        const string& path = rowPath(row);
+        uint32_t len = static_cast<uint32_t>(path.size());
+        hash = fnv1a64(&len, sizeof(len), hash);
+        hash = fnv1a64(path, hash);
+    }
+    return hash;
+}
+
+void DatabaseManager::loadGraphIndex(const string& filePath) {
+    graphIndex.clear();
+    const string graphPath = HNSWIndex::pathFor(filePath);
+    if (!std::filesystem::exists(graphPath)) return;
+    if (!extractor->usesL2Distance() || featuresDB.empty()) return;
+
+    uint64_t pathsHash;
+    if (graphIndex.load(graphPath, databaseDimension(), pathsHash) && graphIndex.size() <= rowPathIds.size() &&
+        rowPathsHash(graphIndex.size()) == pathsHash) {
+        graphIndex.attach(featuresDB.data());
+        if (graphIndex.size() == rowPathIds.size()) return;
+        // Các hàng được append từ lần index trước: chèn thêm vào đồ thị
+        cout << "Inserting " << rowPathIds.size() - graphIndex.size() << " new rows into " << graphPath << endl;
+        graphIndex.extend(featuresDB.data(), featuresDB.rows());
+        if (!graphIndex.save(graphPath, rowPathsHash(graphIndex.size()))) {
+            cerr << "[DatabaseManager] Could not save HNSW index: " << graphPath << endl;
+        }
+        return;
+    }
+    // File .fdb đã được ghi lại (build lại, nén...): build lại đồ thị với cùng tham số
+    HNSWIndex::Params params = graphIndex.empty() ? HNSWIndex::Params() : graphIndex.params();
+    buildGraphIndex(filePath, params);
+}
+
+bool DatabaseManager::buildGraphIndex(const string& filePath, const HNSWIndex::Params& params) {
+    remapMatrix();
+    graphIndex.clear();
+    if (!extractor->usesL2Distance() || featuresDB.empty()) {
+        cerr << "[DatabaseManager] HNSW index needs an L2 extractor and a mapped or loaded database" << endl;
+        return false;
+    }
+    cout << "Building HNSW index (M=" << params.M << ", efConstruction=" << params.efConstruction
+         << ") over " << featuresDB.rows() << " rows" << endl;
+    if (!graphIndex.build(featuresDB.data(), featuresDB.rows(), featuresDB.dimension(), params)) return false;
+    if (!graphIndex.save(HNSWIndex::pathFor(filePath), rowPathsHash(graphIndex.size()))) {
+        cerr << "[DatabaseManager] Could not save HNSW index: " << filePath << endl;
+    }
+    return true;
+}
+
+void DatabaseManager::loadIndex(const string& filePath) {
+    ivfIndex.clear();
+    // Chỉ dùng index đã được build bằng buildIndex(); index cần truy cập ngẫu nhiên vào các hàng
+    // (không dùng được ở chế độ streaming)
+    const string ivfPath = IVFIndex::pathFor(filePath);
+    if (!std::filesystem::exists(ivfPath)) return;
+    if (!extractor->usesL2Distance() || featuresDB.empty()) return;
+    uint64_t size;
+    int64_t mtime;
+    if (!Manifest::statFile(filePath, size, mtime)) return;
+    if (ivfIndex.load(ivfPath, rowPathIds.size(), databaseDimension(), size, mtime)) return;
+    // File .fdb đã đổi kể từ lần build index: build lại
+    buildIndex(filePath);
+}
+
+bool DatabaseManager::buildIndex(const string& filePath) {
+    ivfIndex.clear();
+    remapMatrix();
+    if (!extractor->usesL2Distance() || featuresDB.empty()) {
+        cerr << "[DatabaseManager] IVF index needs an L2 extractor and a mapped or loaded database" << endl;
+        return false;
+    }
+    size_t lists = IVFIndex::defaultListCount(featuresDB.rows());
+    cout << "Building IVF index (" << lists << " lists) for " << filePath << endl;
+    if (!ivfIndex.build(featuresDB.data(), featuresDB.rows(), featuresDB.dimension(), lists)) return false;
+    uint64_t size;
+    int64_t mtime;
+    if (!Manifest::statFile(filePath, size, mtime) || !ivfIndex.save(IVFIndex::pathFor(filePath), size, mtime)) {
+        cerr << "[DatabaseManager] Could not save IVF index, it will be rebuilt next time: " << filePath << endl;
+    }
+    return true;
+}
+
+void DatabaseManager::loadProductQuantizer(const string& filePath) {
+    pqCodes.clear();
+    const string pqPath = ProductQuantizer::pathFor(filePath);
+    if (!std::filesystem::exists(pqPath) || !extractor->usesL2Distance()) return;
+
+    uint64_t pathsHash;
+    if (pqCodes.load(pqPath, databaseDimension(), pathsHash) && pqCodes.rows() <= rowPathIds.size() &&
+        rowPathsHash(pqCodes.rows()) == pathsHash) {
+        if (pqCodes.rows() == rowPathIds.size()) return;
+        // Codebook giữ nguyên, chỉ mã hóa các hàng được append
+        cout << "Encoding " << rowPathIds.size() - pqCodes.rows() << " new rows into " << pqPath << endl;
+        appendQuantized();
+        if (!pqCodes.save(pqPath, rowPathsHash(pqCodes.rows()))) {
+            cerr << "[DatabaseManager] Could not save PQ codes: " << pqPath << endl;
+        }
+        return;
+    }
+    size_t subspaces = pqCodes.empty() ? ProductQuantizer::DEFAULT_SUBSPACES : pqCodes.subspaces();
+    buildProductQuantizer(filePath, subspaces);
+}
+
+void DatabaseManager::appendQuantized() {
+    const size_t dim = databaseDimension();
+    auto extend = [dim](auto& codes, size_t firstRow, size_t count, const float* block) {
+        size_t coded = codes.rows();
+        if (codes.empty() || firstRow + count <= coded) return;
+        size_t skip = coded - firstRow;
+        codes.append(block + skip * dim, count - skip);
+    };
+    scanBlocks([&](size_t firstRow, size_t count, const float* block) {
+        extend(pqCodes, firstRow, count, block);
+        extend(sqCodes, firstRow, count, block);
+    });
+}
+
+void DatabaseManager::sampleRows(size_t maxRows, vector<float>& samples) const {
+    const size_t dim = databaseDimension();
+    const size_t step = max<size_t>(1, rowPathIds.size() / maxRows);
+    samples.clear();
+    scanBlocks([&](size_t firstRow, size_t count, const float* block) {
+        for (size_t r = 0; r < count; ++r) {
+            size_t row = firstRow + r;
+            if (row % step != 0 || isDead(row) || samples.size() >= maxRows * dim) continue;
+            samples.insert(samples.end(), block + r * dim, block + (r + 1) * dim);
+        }
+    });
+}
+
+bool DatabaseManager::buildProductQuantizer(const string& filePath, size_t subspaces) {
+    pqCodes.clear();
+    if (!extractor->usesL2Distance() || rowPathIds.empty()) {
+        cerr << "[DatabaseManager] Product quantization needs an L2 extractor and an open database" << endl;
+        return false;
+    }
+    // Mẫu huấn luyện: các hàng còn sống cách đều nhau
+    const size_t dim = databaseDimension();
+    vector<float> samples;
+    sampleRows(ProductQuantizer::MAX_TRAIN_ROWS, samples);
+    cout << "Training product quantizer (" << subspaces << " bytes per image) on "
+         << samples.size() / dim << " rows" << endl;
+    if (!pqCodes.train(samples.data(), samples.size() / dim, dim, subspaces)) return false;
+    appendQuantized();
+    if (!pqCodes.save(ProductQuantizer::pathFor(filePath), rowPathsHash(pqCodes.rows()))) {
+        cerr << "[DatabaseManager] Could not save PQ codes: " << filePath << endl;
+    }
+    releaseMatrix();
+    return true;
+}
+
+void DatabaseManager::loadScalarQuantizer(const string& filePath) {
+    sqCodes.clear();
+    const string sqPath = ScalarQuantizer::pathFor(filePath);
+    if (!std::filesystem::exists(sqPath) || !extractor->usesL2Distance()) return;
+
+    uint64_t pathsHash;
+    if (sqCodes.load(sqPath, databaseDimension(), pathsHash) && sqCodes.rows() <= rowPathIds.size() &&
+        rowPathsHash(sqCodes.rows()) == pathsHash) {
+        if (sqCodes.rows() == rowPathIds.size()) return;
+        // Khoảng giá trị (int8) giữ nguyên, chỉ mã hóa các hàng được append
+        cout << "Encoding " << rowPathIds.size() - sqCodes.rows() << " new rows into " << sqPath << endl;
+        appendQuantized();
+        if (!sqCodes.save(sqPath, rowPathsHash(sqCodes.rows()))) {
+            cerr << "[DatabaseManager] Could not save SQ codes: " << sqPath << endl;
+        }
+        return;
+    }
+    buildScalarQuantizer(filePath, sqCodes.type());
+}
+
+bool DatabaseManager::buildScalarQuantizer(const string& filePath, ScalarQuantizer::Type type) {
+    sqCodes.clear();
+    if (!extractor->usesL2Distance() || rowPathIds.empty()) {
+        cerr << "[DatabaseManager] Scalar quantization needs an L2 extractor and an open database" << endl;
+        return false;
+    }
+    const size_t dim = databaseDimension();
+    vector<float> samples;
+    if (type == ScalarQuantizer::Int8) sampleRows(ScalarQuantizer::MAX_TRAIN_ROWS, samples);
+    cout << "Encoding " << rowPathIds.size() << " rows as " << ScalarQuantizer::typeName(type) << endl;
+    if (!sqCodes.train(samples.data(), samples.size() / dim, dim, type)) return false;
+    appendQuantized();
+    if (!sqCodes.save(ScalarQuantizer::pathFor(filePath), rowPathsHash(sqCodes.rows()))) {
+        cerr << "[DatabaseManager] Could not save SQ codes: " << filePath << endl;
+    }
+    releaseMatrix();
+    return true;
+}
+
+void DatabaseManager::loadVocabulary(const string& filePath) {
+    bowIndex.clear();
+    const string bowPath = BowIndex::pathFor(filePath);
+    if (!std::filesystem::exists(bowPath) || !localFeature) return;
+
+    uint64_t pathsHash;
+    if (!bowIndex.load(bowPath, pathsHash)) return;
+    const VisualVocabulary& vocabulary = bowIndex.vocabulary();
+    if (vocabulary.descriptorBytes() != localFeature->descriptorBytes() ||
+        vocabulary.usesHamming() != localFeature->binaryDescriptors()) {
+        cerr << "[DatabaseManager] Vocabulary does not match the extractor: " << bowPath << endl;
+        bowIndex.clear();
+        return;
+    }
+    if (bowIndex.images() <= rowPathIds.size() && rowPathsHash(bowIndex.images()) == pathsHash) {
+        if (bowIndex.images() == rowPathIds.size()) return;
+        cout << "Quantizing " << rowPathIds.size() - bowIndex.images() << " new images into " << bowPath << endl;
+    } else {
+        // File .fdb đã được ghi lại: vocabulary vẫn dùng được, chỉ lượng tử hóa lại các ảnh
+        cout << "Re-indexing " << rowPathIds.size() << " images with the vocabulary of " << bowPath << endl;
+        bowIndex.clearImages();
+    }
+    prepareDescriptors();
+    bowIndex.append(localDescriptors);
+    if (!bowIndex.save(bowPath, rowPathsHash(bowIndex.images()))) {
+        cerr << "[DatabaseManager] Could not save BoW index: " << bowPath << endl;
+    }
+}
+
+void DatabaseManager::sampleDescriptors(size_t maxSamples, vector<uint8_t>& samples) const {
+    // Các descriptor cách đều nhau của các ảnh còn sống
+    const size_t bytes = localDescriptors.descriptorBytes();
+    const size_t step = max<size_t>(1, localDescriptors.size() / maxSamples);
+    samples.clear();
+    for (size_t i = 0; i < localDescriptors.images(); ++i) {
+        if (isDead(i)) continue;
+        for (size_t d = localDescriptors.offset(i), end = d + localDescriptors.count(i); d < end; ++d) {
+            if (d % step != 0 || samples.size() >= maxSamples * bytes) continue;
+            samples.insert(samples.end(), localDescriptors.descriptor(d), localDescriptors.descriptor(d) + bytes);
+        }
+    }
+}
+
+void DatabaseManager::loadDescriptorIndex(const string& filePath) {
+    descriptorIndex.clear();
+    pendingDescriptorIndex.clear();
+    const string indexPath = DescriptorIndex::pathFor(filePath);
+    if (!std::filesystem::exists(indexPath) || !localFeature) return;
+
+    uint64_t pathsHash;
+    if (!descriptorIndex.load(indexPath, pathsHash)) return;
+    const VisualVocabulary& tree = descriptorIndex.tree();
+    if (tree.descriptorBytes() != localFeature->descriptorBytes() ||
+        tree.usesHamming() != localFeature->binaryDescriptors()) {
+        cerr << "[DatabaseManager] Descriptor index does not match the extractor: " << indexPath << endl;
+        descriptorIndex.clear();
+        return;
+    }
+    pendingDescriptorIndex = indexPath;
+    pendingDescriptorHash = pathsHash;
+}
+
+void DatabaseManager::syncDescriptorIndex() {
+    prepareDescriptors();
+    if (pendingDescriptorIndex.empty()) {
+        // Ảnh được thêm vào database trong bộ nhớ từ lần xếp trước
+        descriptorIndex.append(localDescriptors);
+        return;
+    }
+    const string indexPath = pendingDescriptorIndex;
+    pendingDescriptorIndex.clear();
+    const size_t indexed = descriptorIndex.images();
+    if (indexed <= rowPathIds.size() && rowPathsHash(indexed) == pendingDescriptorHash &&
+        localDescriptors.offset(indexed) == descriptorIndex.size()) {
+        if (indexed == rowPathIds.size()) return;
+        cout << "Indexing descriptors of " << rowPathIds.size() - indexed << " new images into " << indexPath << endl;
+    } else {
+        // File .fdb đã được ghi lại: cây vẫn dùng được, chỉ xếp lại các descriptor vào lá
+        cout << "Re-indexing " << localDescriptors.size() << " descriptors with the tree of " << indexPath << endl;
+        descriptorIndex.clearImages();
+    }
+    descriptorIndex.append(localDescriptors);
+    if (!descriptorIndex.save(indexPath, rowPathsHash(descriptorIndex.images()))) {
+        cerr << "[DatabaseManager] Could not save descriptor index: " << indexPath << endl;
+    }
+}
+
+bool DatabaseManager::buildDescriptorIndex(const string& filePath, size_t branching) {
+    descriptorIndex.clear();
+    pendingDescriptorIndex.clear();
+    if (!localFeature || rowPathIds.empty()) {
+        cerr << "[DatabaseManager] Descriptor index needs a SIFT/ORB extractor and an open database" << endl;
+        return false;
+    }
+    prepareDescriptors();
+
+    // Cây được huấn luyện trên một mẫu, sau đó mọi descriptor được xếp vào lá (song song)
+    const size_t bytes = localDescriptors.descriptorBytes();
+    vector<uint8_t> samples;
+    sampleDescriptors(DescriptorIndex::MAX_TRAIN_DESCRIPTORS, samples);
+    const size_t depth = DescriptorIndex::depthFor(localDescriptors.size(), samples.size() / bytes, branching);
+    cout << "Training descriptor tree (branching " << branching << ", depth " << depth << ") on "
+         << samples.size() / bytes << " of " << localDescriptors.size() << " descriptors" << endl;
+    VisualVocabulary tree;
+    if (!tree.train(samples.data(), samples.size() / bytes, bytes, localFeature->binaryDescriptors(), branching, depth)) {
+        return false;
+    }
+    descriptorIndex.setTree(std::move(tree));
+    descriptorIndex.append(localDescriptors);
+    cout << descriptorIndex.tree().words() << " leaves, " << descriptorIndex.size() << " descriptors indexed" << endl;
+    if (!descriptorIndex.save(DescriptorIndex::pathFor(filePath), rowPathsHash(descriptorIndex.images()))) {
+        cerr << "[DatabaseManager] Could not save descriptor index: " << filePath << endl;
+    }
+    return true;
+}
+
+bool DatabaseManager::buildVocabulary(const string& filePath, size_t branching, size_t depth) {
+    bowIndex.clear();
+    if (!localFeature || rowPathIds.empty()) {
+        cerr << "[DatabaseManager] Visual vocabulary needs a SIFT/ORB extractor and an open database" << endl;
+        return false;
+    }
+    prepareDescriptors();
+
+    const size_t bytes = localDescriptors.descriptorBytes();
+    vector<uint8_t> samples;
+    sampleDescriptors(VisualVocabulary::MAX_TRAIN_DESCRIPTORS, samples);
+    cout << "Training vocabulary tree (branching " << branching << ", depth " << depth << ") on "
+         << samples.size() / bytes << " descriptors" << endl;
+    VisualVocabulary vocabulary;
+    if (!vocabulary.train(samples.data(), samples.size() / bytes, bytes, localFeature->binaryDescriptors(),
+                          branching, depth)) {
+        return false;
+    }
+    cout << vocabulary.words() << " visual words, quantizing " << localDescriptors.images() << " images" << endl;
+    bowIndex.setVocabulary(std::move(vocabulary));
+    bowIndex.append(localDescriptors);
+    if (!bowIndex.save(BowIndex::pathFor(filePath), rowPathsHash(bowIndex.images()))) {
+        cerr << "[DatabaseManager] Could not save BoW index: " << filePath << endl;
+    }
+    return true;
+}
+
+template <typename Search>
+bool DatabaseManager::searchLocalCandidates(const float* queryFeatures, size_t dim, size_t k, const Search& search) {
+    const size_t count = LocalFeature::packedCount(queryFeatures, dim, localFeature->descriptorBytes());
+    const uint8_t* descriptors = LocalFeature::packedDescriptors(queryFeatures);
+    const uint8_t* dead = deadRows.empty() ? nullptr : deadRows.data();
+    if (!rerankExact) {
+        search(descriptors, count, dead, queryHeap);
+        return queryHeap.full();
+    }
+    // Ảnh không có từ chung/phiếu nào không vào danh sách: chỉ cần đủ k ứng viên
+    candidateHeap.reset(k * RERANK_FACTOR);
+    search(descriptors, count, dead, candidateHeap);
+    if (candidateHeap.size() < k) return false;
+    candidateHeap.sortedInto(candidates);
+    scanDescriptors(queryFeatures, dim, k, &candidates);
+    return true;
+}
+
+bool DatabaseManager::searchVocabulary(const float* queryFeatures, size_t dim, size_t k) {
+    return searchLocalCandidates(queryFeatures, dim, k,
+        [this](const uint8_t* descriptors, size_t count, const uint8_t* dead, TopK& best) {
+            bowIndex.search(descriptors, count, dead, best);
+        });
+}
+
+bool DatabaseManager::buildHashIndex(const LSHIndex::Params& params) {
+    lshIndex.clear();
+    if (!localFeature || !localFeature->binaryDescriptors() || rowPathIds.empty()) {
+        cerr << "[DatabaseManager] LSH index needs an ORB extractor and an open database" << endl;
+        return false;
+    }
+    if (!lshIndex.setup(localFeature->descriptorBytes(), params)) {
+        cerr << "[DatabaseManager] Invalid LSH parameters" << endl;
+        return false;
+    }
+    prepareDescriptors();
+    lshIndex.append(localDescriptors);
+    cout << "Hashed " << localDescriptors.size() << " descriptors of " << lshIndex.images() << " images into "
+         << params.tables << " LSH tables" << endl;
+    return true;
+}
+
+bool DatabaseManager::searchHashTables(const float* queryFeatures, size_t dim, size_t k) {
+    prepareDescriptors();
+    lshIndex.append(localDescriptors);
+    if (lshIndex.images() != rowPathIds.size()) return false;
+    return searchLocalCandidates(queryFeatures, dim, k,
+        [this](const uint8_t* descriptors, size_t count, const uint8_t* dead, TopK& best) {
+            lshIndex.search(descriptors, count, localDescriptors, dead, best);
+        });
+}
+
+bool DatabaseManager::searchDescriptorIndex(const float* queryFeatures, size_t dim, size_t k) {
+    syncDescriptorIndex();
+    if (localDescriptors.size() != descriptorIndex.size()) return false;
+    return searchLocalCandidates(queryFeatures, dim, k,
+        [this](const uint8_t* descriptors, size_t count, const uint8_t* dead, TopK& best) {
+            descriptorIndex.search(descriptors, count, localDescriptors, dead, best);
+        });
+}
+
+bool DatabaseManager::searchQuantized(const float* queryFeatures, size_t dim, size_t k) {
+    if (pqCodes.rows() == rowPathIds.size()) {
+        pqCodes.computeTable(queryFeatures, pqTable);
+        const float* table = pqTable.data();
+        return searchCandidates(queryFeatures, dim, k, [this, table](size_t row) { return pqCodes.distance(table, row); });
+    }
+    return searchCandidates(queryFeatures, dim, k,
+                            [this, queryFeatures](size_t row) { return sqCodes.distance(queryFeatures, row); });
+}
+
+template <typename Approx>
+bool DatabaseManager::searchCandidates(const float* queryFeatures, size_t dim, size_t k, const Approx& approx) {
+    const bool rerank = rerankExact && !featuresDB.empty();
+    const size_t candidateCount = rerank ? k * RERANK_FACTOR : k;
+    candidateHeap.reset(candidateCount);
+
+    if (indexEnabled && !ivfIndex.empty()) {
+        // IVF-PQ / IVF-SQ: chỉ các cell gần query
+        ivfIndex.probe(queryFeatures, searchProbes, probeCells);
+        for (uint32_t cell : probeCells) {
+            const uint32_t* rows = ivfIndex.listRows(cell);
+            for (size_t i = 0, n = ivfIndex.listSize(cell); i < n; ++i) {
+                if (isDead(rows[i])) continue;
+                candidateHeap.push(approx(rows[i]), rows[i]);
+            }
+        }
+    } else {
+        // Quét toàn bộ code: ít byte mỗi hàng hơn dim float
+        const size_t rows = rowPathIds.size();
+        ThreadPool& pool = ThreadPool::shared();
+        if (pool.size() > 1 && rows >= PARALLEL_MIN_ROWS) {
+            workerHeaps.resize(pool.size());
+            for (auto& heap : workerHeaps) heap.reset(candidateCount);
+            const size_t chunkRows = max<size_t>(1024, rows / (pool.size() * 8));
+            pool.parallelFor(0, (rows + chunkRows - 1) / chunkRows, [&](size_t chunk, size_t worker) {
+                TopK& best = workerHeaps[worker];
+                for (size_t r = chunk * chunkRows, end = min(rows, r + chunkRows); r < end; ++r) {
+                    if (isDead(r)) continue;
+                    best.push(approx(r), static_cast<uint32_t>(r));
+                }
+            });
+            for (const auto& heap : workerHeaps) candidateHeap.merge(heap);
+        } else {
+            for (size_t r = 0; r < rows; ++r) {
+                if (isDead(r)) continue;
+                candidateHeap.push(approx(r), static_cast<uint32_t>(r));
+            }
+        }
+    }
+    if (!candidateHeap.full()) return false;
+
+    candidateHeap.sortedInto(candidates);
+    for (const auto& candidate : candidates) {
+        double distance = rerank ? rowDistance(queryFeatures, featuresDB.row(candidate.row), dim, queryHeap.worst())
+                                 : std::sqrt(candidate.distance);
+        queryHeap.push(distance, candidate.row);
+    }
+    return true;
+}
+
+bool DatabaseManager::searchIndex(const float* queryFeatures, size_t dim) {
+    ivfIndex.probe(queryFeatures, searchProbes, probeCells);
+    for (uint32_t cell : probeCells) {
+        const uint32_t* rows = ivfIndex.listRows(cell);
+        for (size_t i = 0, n = ivfIndex.listSize(cell); i < n; ++i) {
+            if (isDead(rows[i])) continue;
+            double distance = rowDistance(queryFeatures, featuresDB.row(rows[i]), dim, queryHeap.worst());
+            queryHeap.push(distance, rows[i]);
+        }
+    }
+    return queryHeap.full();
+}
+
+void DatabaseManager::saveDatabaseCSV(const string& filePath) {
+    if (localFeature) {
+        // Byte descriptor trong hàng đóng gói không phải số thực: in ra dạng thập phân sẽ hỏng
+        cerr << "[DatabaseManager] " << extractor->getMethodName()
+             << " databases cannot be saved as CSV, use a .fdb file: " << filePath << endl;
+        return;
+    }
     std::filesystem::create_directories(std::filesystem::path(filePath).parent_path());
     ofstream outFile(filePath);
     if (!outFile.is_open()) {
@@ -50,23 +1089,33 @@ void DatabaseManager::saveDatabase(const string& filePath) {
     outFile << "image_path,feature_method,features\n";
     
     // Ghi dữ liệu
-    for (const auto& entry : featuresDB) {
-        outFile << entry.first << ","
-                << extractor->getMethodName() << ","
-                << extractor->featuresToString(entry.second) << "\n";
-    }
+    const size_t dim = databaseDimension();
+    scanBlocks([&](size_t firstRow, size_t count, const float* block) {
+        for (size_t r = 0; r < count; ++r) {
+            if (isDead(firstRow + r)) continue;
+            const float* row = block + r * dim;
+            outFile << rowPath(firstRow + r) << ","
+                    << extractor->getMethodName() << ","
+                    << extractor->featuresToString(vector<float>(row, row + dim)) << "\n";
+        }
+    });
     
     outFile.close();
 }
 
-bool DatabaseManager::loadDatabase(const string& filePath) {
+bool DatabaseManager::loadDatabaseCSV(const string& filePath) {
+    if (localFeature) {
+        cerr << "[DatabaseManager] " << extractor->getMethodName()
+             << " databases cannot be loaded from CSV, use a .fdb file: " << filePath << endl;
+        return false;
+    }
     ifstream inFile(filePath);
     if (!inFile.is_open()) {
         cerr << "Error opening file for reading: " << filePath << endl;
         return false;
     }
     
-    featuresDB.clear();
+    clearDatabase();
     string line;
     
     // Bỏ qua header
@@ -87,7 +1136,7 @@ bool DatabaseManager::loadDatabase(const string& filePath) {
         
         // Chỉ đọc nếu phương pháp trích xuất phù hợp
         if (method == extractor->getMethodName()) {
-            featuresDB[path] = extractor->stringToFeatures(featureStr);
+            addEntry(path, extractor->stringToFeatures(featureStr));
         }
     }
     
@@ -99,23 +1148,8 @@ vector<pair<string, double>> DatabaseManager::query(const Mat& queryImage, int t
     cout << "Querying database for image" << endl;
     vector<float> queryFeatures = extractor->extract(queryImage);
     vector<pair<string, double>> results;
-    
-    for (const auto& entry : featuresDB) {
-        double distance = extractor->compare(queryFeatures, entry.second);
-        results.emplace_back(entry.first, distance);
-    }
-    
-    // Sắp xếp theo khoảng cách (tăng dần)
-    sort(results.begin(), results.end(), 
-        [](const pair<string, double>& a, const pair<string, double>& b) {
-            return a.second < b.second;
-        });
-    
-    // Giới hạn số lượng kết quả
-    if (topK > 0 && results.size() > topK) {
-        results.resize(topK);
-    }
-    
+    // topK <= 0: xếp hạng toàn bộ database
+    scanDatabase(queryFeatures, topK > 0 ? topK : getDatabaseSize(), results);
     return results;
 }
 
@@ -124,12 +1158,289 @@ std::string DatabaseManager::getExtractorName() const {
 }
 
 size_t DatabaseManager::getDatabaseSize() const {
-    return featuresDB.size();
+    return rowPathIds.size() - deadCount;
+}
+
+bool DatabaseManager::indexAllowed(size_t k) const {
+    // k phủ mọi ảnh còn sống (topK <= 0): index không bỏ được hàng nào, quét toàn bộ (chính xác)
+    return indexEnabled && k < getDatabaseSize();
+}
+
+bool DatabaseManager::hasActiveIndex(size_t k) const {
+    if (!indexAllowed(k)) return false;
+    const size_t rows = rowPathIds.size();
+    if (graphIndex.size() == rows || pqCodes.rows() == rows || sqCodes.rows() == rows || !ivfIndex.empty()) {
+        return true;
+    }
+    return localFeature && ((bowIndex.images() == rows && rows > 0) || !descriptorIndex.empty() || !lshIndex.empty());
+}
+
+void DatabaseManager::queryRows(const float* queryFeatures, size_t dimension, size_t k, vector<QueryHit>& hits) {
+    hits.clear();
+    const size_t dim = databaseDimension();
+    if (rowPathIds.empty() || k == 0) return;
+    if (dimension != dim) {
+        cerr << "[DatabaseManager] Query has " << dimension
+             << " features, database rows have " << dim << endl;
+        return;
+    }
+
+    // Các hàng nằm liên tiếp trong bộ nhớ (hoặc vùng map / buffer streaming), duyệt tuyến tính;
+    // chỉ k ứng viên tốt nhất được giữ lại trong heap dùng lại giữa các truy vấn. Khi heap đã đầy,
+    // khoảng cách của ứng viên thứ k là ngưỡng để dừng sớm các hàng chắc chắn kém hơn.
+    prepareBlockOrder();
+    queryHeap.reset(k);
+    const bool useIndex = indexAllowed(k);
+    // Đồ thị HNSW, code PQ hoặc SQ, rồi index IVF: chỉ duyệt vùng gần query hoặc dữ liệu nén;
+    // quét toàn bộ khi không đủ k ứng viên
+    if (useIndex && graphIndex.size() == rowPathIds.size()) {
+        graphIndex.search(queryFeatures, k, deadRows.empty() ? nullptr : deadRows.data(), queryHeap);
+        if (queryHeap.full()) {
+            queryHeap.sortedInto(hits);
+            return;
+        }
+        queryHeap.reset(k);
+    }
+    if (useIndex && (pqCodes.rows() == rowPathIds.size() || sqCodes.rows() == rowPathIds.size())) {
+        if (searchQuantized(queryFeatures, dim, k)) {
+            queryHeap.sortedInto(hits);
+            return;
+        }
+        queryHeap.reset(k);
+    }
+    if (useIndex && !ivfIndex.empty()) {
+        if (searchIndex(queryFeatures, dim)) {
+            queryHeap.sortedInto(hits);
+            return;
+        }
+        queryHeap.reset(k);
+    }
+    // Đặc trưng cục bộ: ứng viên từ inverted file, phiếu của cây descriptor hoặc bảng LSH (ORB),
+    // hoặc match trên các descriptor thật thay vì các hàng có đệm
+    if (localFeature) {
+        if (useIndex && bowIndex.images() == rowPathIds.size() && rowPathIds.size() > 0) {
+            if (searchVocabulary(queryFeatures, dim, k)) {
+                queryHeap.sortedInto(hits);
+                return;
+            }
+            queryHeap.reset(k);
+        } else if (useIndex && !descriptorIndex.empty() && rowPathIds.size() > 0) {
+            if (searchDescriptorIndex(queryFeatures, dim, k)) {
+                queryHeap.sortedInto(hits);
+                return;
+            }
+            queryHeap.reset(k);
+        } else if (useIndex && !lshIndex.empty() && rowPathIds.size() > 0) {
+            if (searchHashTables(queryFeatures, dim, k)) {
+                queryHeap.sortedInto(hits);
+                return;
+            }
+            queryHeap.reset(k);
+        }
+        scanDescriptors(queryFeatures, dim, k);
+        queryHeap.sortedInto(hits);
+        return;
+    }
+    ThreadPool& pool = ThreadPool::shared();
+    const bool parallel = pool.size() > 1 && rowPathIds.size() >= PARALLEL_MIN_ROWS;
+    if (parallel) {
+        workerHeaps.resize(pool.size());
+        for (auto& heap : workerHeaps) heap.reset(k);
+    }
+    struct Scan {
+        const DatabaseManager* db;
+        const float* query;
+        size_t dim;
+        TopK* best;
+        std::vector<TopK>* workerHeaps;
+        ThreadPool* pool;
+    } scan{this, queryFeatures, dim, &queryHeap, parallel ? &workerHeaps : nullptr, &pool};
+
+    // OpenCV (BFMatcher của SIFT) chạy đơn luồng bên trong mỗi task
+    CvThreadScope cvThreads(parallel);
+
+    // Lambda chỉ bắt một tham chiếu để std::function không phải cấp phát
+    scanBlocks([&scan](size_t firstRow, size_t count, const float* block) {
+        if (!scan.workerHeaps) {
+            for (size_t r = 0; r < count; ++r) {
+                if (scan.db->isDead(firstRow + r)) continue;
+                double distance = scan.db->rowDistance(scan.query, block + r * scan.dim, scan.dim, scan.best->worst());
+                scan.best->push(distance, static_cast<uint32_t>(firstRow + r));
+            }
+            return;
+        }
+        // Chia khối thành nhiều đoạn hơn số luồng: work stealing cân bằng các hàng so sánh chậm
+        const size_t chunkRows = max<size_t>(1, count / (scan.pool->size() * 8));
+        const size_t chunks = (count + chunkRows - 1) / chunkRows;
+        scan.pool->parallelFor(0, chunks, [&scan, firstRow, count, block, chunkRows](size_t chunk, size_t worker) {
+            TopK& best = (*scan.workerHeaps)[worker];
+            size_t end = min(count, (chunk + 1) * chunkRows);
+            for (size_t r = chunk * chunkRows; r < end; ++r) {
+                if (scan.db->isDead(firstRow + r)) continue;
+                double distance = scan.db->rowDistance(scan.query, block + r * scan.dim, scan.dim, best.worst());
+                best.push(distance, static_cast<uint32_t>(firstRow + r));
+            }
+        });
+    });
+
+    if (parallel) {
+        for (const auto& heap : workerHeaps) queryHeap.merge(heap);
+    }
+    queryHeap.sortedInto(hits);
+}
+
+void DatabaseManager::queryBatch(const FeatureMatrix& queries, size_t k, vector<vector<QueryHit>>& hits) {
+    const size_t queryCount = queries.rows();
+    hits.resize(queryCount);
+    for (auto& list : hits) list.clear();
+    const size_t dim = databaseDimension();
+    if (rowPathIds.empty() || k == 0 || queryCount == 0) return;
+    if (queries.dimension() != dim) {
+        cerr << "[DatabaseManager] Queries have " << queries.dimension()
+             << " features, database rows have " << dim << endl;
+        return;
+    }
+    // Có index: từng query đi đúng đường của queryRows, để lô và truy vấn đơn xếp hạng như nhau
+    if (hasActiveIndex(k)) {
+        for (size_t q = 0; q < queryCount; ++q) queryRows(queries.row(q), dim, k, hits[q]);
+        return;
+    }
+
+    // blockOrder chỉ dùng cho extractor L2, và khi đó lô luôn đi đường gemm: không cần tính
+    const bool gemmPath = extractor->usesL2Distance();
+    const float* norms = gemmPath ? databaseNorms().data() : nullptr;
+    vector<float> queryNorms(queryCount);
+    for (size_t q = 0; q < queryCount; ++q) {
+        queryNorms[q] = DistanceKernels::squaredNorm(queries.row(q), dim);
+    }
+
+    ThreadPool& pool = ThreadPool::shared();
+    batchHeaps.resize(pool.size());
+    for (auto& heaps : batchHeaps) {
+        heaps.resize(queryCount);
+        for (auto& heap : heaps) heap.reset(k);
+    }
+    vector<Mat> dots(pool.size()); // kết quả gemm riêng của từng luồng, dùng lại giữa các ô
+    const Mat queryMat(static_cast<int>(queryCount), static_cast<int>(dim), CV_32F, const_cast<float*>(queries.data()));
+
+    // Các ô đã song song trên ThreadPool, gemm của OpenCV chạy đơn luồng bên trong mỗi task
+    CvThreadScope cvThreads(pool.size() > 1);
+
+    scanBlocks([&](size_t firstRow, size_t count, const float* block) {
+        const size_t tiles = (count + BATCH_ROW_TILE - 1) / BATCH_ROW_TILE;
+        pool.parallelFor(0, tiles, [&](size_t tile, size_t worker) {
+            vector<TopK>& heaps = batchHeaps[worker];
+            const size_t begin = tile * BATCH_ROW_TILE;
+            const size_t rows = min(BATCH_ROW_TILE, count - begin);
+            const float* tileData = block + begin * dim;
+
+            if (!gemmPath) {
+                // Không có dạng nhân ma trận: so sánh từng cặp, ô hàng vẫn nằm trong cache cho mọi query
+                for (size_t r = 0; r < rows; ++r) {
+                    const size_t row = firstRow + begin + r;
+                    if (isDead(row)) continue;
+                    for (size_t q = 0; q < queryCount; ++q) {
+                        double distance = rowDistance(queries.row(q), tileData + r * dim, dim, heaps[q].worst());
+                        heaps[q].push(distance, static_cast<uint32_t>(row));
+                    }
+                }
+                return;
+            }
+
+            const Mat tileMat(static_cast<int>(rows), static_cast<int>(dim), CV_32F, const_cast<float*>(tileData));
+            Mat& dot = dots[worker];
+            for (size_t q0 = 0; q0 < queryCount; q0 += BATCH_QUERY_TILE) {
+                const size_t q1 = min(queryCount, q0 + BATCH_QUERY_TILE);
+                // dot(i, j) = query(q0 + i) · row(begin + j)
+                gemm(queryMat.rowRange(static_cast<int>(q0), static_cast<int>(q1)), tileMat, 1.0, noArray(), 0.0, dot, GEMM_2_T);
+                for (size_t q = q0; q < q1; ++q) {
+                    TopK& heap = heaps[q];
+                    const float* dotRow = dot.ptr<float>(static_cast<int>(q - q0));
+                    for (size_t r = 0; r < rows; ++r) {
+                        const size_t row = firstRow + begin + r;
+                        // Sai số làm tròn có thể cho giá trị âm rất nhỏ với hai vector gần trùng nhau
+                        double squared = max(0.0, double(queryNorms[q]) + norms[row] - 2.0 * dotRow[r]);
+                        double worst = heap.worst();
+                        if (squared >= worst * worst || isDead(row)) continue;
+                        heap.push(std::sqrt(squared), static_cast<uint32_t>(row));
+                    }
+                }
+            }
+        });
+    });
+
+    for (size_t q = 0; q < queryCount; ++q) {
+        queryHeap.reset(k);
+        for (const auto& heaps : batchHeaps) queryHeap.merge(heaps[q]);
+        queryHeap.sortedInto(hits[q]);
+    }
+}
+
+vector<vector<pair<string, double>>> DatabaseManager::queryBatch(const vector<Mat>& queryImages, int topK) {
+    vector<vector<pair<string, double>>> results(queryImages.size());
+    const size_t dim = databaseDimension();
+    if (queryImages.empty() || rowPathIds.empty()) return results;
+
+    // Trích xuất song song, mỗi luồng một bản sao extractor (extract() có trạng thái)
+    ThreadPool& pool = ThreadPool::shared();
+    vector<unique_ptr<FeatureExtractor>> extractors(pool.size());
+    FeatureMatrix queries;
+    queries.reset(dim);
+    queries.resize(queryImages.size());
+    vector<uint8_t> valid(queryImages.size(), 0);
+    pool.parallelFor(0, queryImages.size(), [&](size_t i, size_t worker) {
+        if (!extractors[worker]) extractors[worker] = extractor->clone();
+        vector<float> features = queryImages[i].empty() ? vector<float>() : extractors[worker]->extract(queryImages[i]);
+        valid[i] = features.size() == dim;
+        if (valid[i]) copy(features.begin(), features.end(), queries.mutableRow(i));
+        else fill(queries.mutableRow(i), queries.mutableRow(i) + dim, 0.0f);
+    });
+
+    vector<vector<QueryHit>> hits;
+    queryBatch(queries, topK > 0 ? topK : getDatabaseSize(), hits);
+    for (size_t i = 0; i < hits.size(); ++i) {
+        if (!valid[i]) continue;
+        results[i].reserve(hits[i].size());
+        for (const auto& hit : hits[i]) {
+            results[i].emplace_back(rowPath(hit.row), hit.distance);
+        }
+    }
+    return results;
+}
+
+void DatabaseManager::scanDatabase(const vector<float>& queryFeatures, size_t k,
+                                   vector<pair<string, double>>& results) {
+    results.clear();
+    queryRows(queryFeatures.data(), queryFeatures.size(), k, hitBuffer);
+    // Chỉ copy đường dẫn của k kết quả cuối cùng
+    results.reserve(hitBuffer.size());
+    for (const auto& hit : hitBuffer) {
+        results.emplace_back(rowPath(hit.row), hit.distance);
+    }
+}
+
+int DatabaseManager::countRelevant(const string& queryClass, int datasetType) const {
+    int totalRelevant = 0;
+    for (size_t i = 0; i < rowPathIds.size(); ++i) {
+        if (isDead(i)) continue;
+        if (getImageClass(rowPath(i), datasetType, false) == queryClass)
+            totalRelevant++;
+    }
+    return totalRelevant;
 }
 
 void DatabaseManager::setExtractor(FeatureExtractor* newExtractor) {
+    featureCache.close();
     delete extractor;
     extractor = newExtractor;
+    localFeature = dynamic_cast<const LocalFeature*>(newExtractor);
+    localDescriptors.clear();
+    bowIndex.clear();
+    descriptorIndex.clear();
+    pendingDescriptorIndex.clear();
+    lshIndex.clear();
+    blockOrder.clear();
+    blockOrderRows = 0;
 }
 
 std::string DatabaseManager::getImageClass(const std::string& filename, int datasetType, bool queryfix) {
@@ -149,26 +1460,14 @@ vector<pair<string, double>> DatabaseManager::queryWithMAP(const Mat& queryImage
     vector<float> queryFeatures = extractor->extract(queryImage);
     vector<pair<string, double>> allResults;
     
-    // Tính toán kết quả cho tất cả ảnh
-    for (const auto& entry : featuresDB) {
-        double distance = extractor->compare(queryFeatures, entry.second);
-        allResults.emplace_back(entry.first, distance);
-    }
-    
-    // Sắp xếp theo khoảng cách tăng dần
-    sort(allResults.begin(), allResults.end(), 
-        [](const pair<string, double>& a, const pair<string, double>& b) {
-            return a.second < b.second;
-        });
+    // Chỉ cần xếp hạng tới k lớn nhất
+    int maxK = kValues.empty() ? 0 : *max_element(kValues.begin(), kValues.end());
+    scanDatabase(queryFeatures, max(maxK, 0), allResults);
 
     // 4. Đếm tổng số ảnh liên quan (trong toàn bộ DB)
     std::string queryClass = getImageClass(queryImagePath, datasetType);
 
-    int totalRelevant = 0;
-    for (const auto& entry : featuresDB) {
-        if (getImageClass(entry.first, datasetType, false) == queryClass)
-            totalRelevant++;
-    }
+    int totalRelevant = countRelevant(queryClass, datasetType);
     
     // Tính MAP cho các giá trị k khác nhau
     mapScores.clear();
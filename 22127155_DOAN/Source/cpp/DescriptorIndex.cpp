@@ -0,0 +1,200 @@
+#include "DescriptorIndex.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <functional>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+static const char KMT_MAGIC[8] = {'C', 'B', 'I', 'R', 'K', 'M', 'T', '\0'};
+
+template <typename T>
+static bool readValue(ifstream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+template <typename T>
+static void writeValue(ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+size_t DescriptorIndex::depthFor(size_t descriptors, size_t samples, size_t branching) {
+    const size_t leaves = max<size_t>(1, (descriptors + LEAF_SIZE - 1) / LEAF_SIZE);
+    size_t depth = 1, capacity = branching;
+    while (capacity < leaves && depth < MAX_DEPTH) {
+        capacity *= branching;
+        ++depth;
+    }
+    // Không nhiều lá hơn số mà mẫu huấn luyện được: lá thiếu mẫu có tâm gần như ngẫu nhiên
+    const size_t trainable = samples / MIN_SAMPLES_PER_LEAF;
+    while (depth > 1 && capacity > trainable) {
+        capacity /= branching;
+        --depth;
+    }
+    return depth;
+}
+
+void DescriptorIndex::setTree(VisualVocabulary&& trained) {
+    vocab = std::move(trained);
+    clearImages();
+}
+
+void DescriptorIndex::clearImages() {
+    imageOffsets.assign(1, 0);
+    leafOf.clear();
+    owners.clear();
+    leafOffsets.clear();
+    members.clear();
+}
+
+void DescriptorIndex::clear() {
+    vocab.clear();
+    clearImages();
+}
+
+void DescriptorIndex::append(const DescriptorStore& store) {
+    if (empty() || store.descriptorBytes() != vocab.descriptorBytes() || store.images() <= images()) return;
+    const size_t first = leafOf.size(), total = store.size();
+    if (store.offset(images()) != first) return; // store không phải store đã được index
+
+    leafOf.resize(total);
+    ThreadPool::shared().parallelFor(first, total, [&](size_t d, size_t) {
+        leafOf[d] = vocab.quantize(store.descriptor(d));
+    }, 1024);
+    for (size_t i = images(); i < store.images(); ++i) imageOffsets.push_back(store.offset(i) + store.count(i));
+    rebuildLeaves();
+}
+
+void DescriptorIndex::rebuildLeaves() {
+    const size_t words = vocab.words(), n = leafOf.size();
+    owners.resize(n);
+    for (size_t i = 0; i < images(); ++i) {
+        fill(owners.begin() + imageOffsets[i], owners.begin() + imageOffsets[i + 1], static_cast<uint32_t>(i));
+    }
+    leafOffsets.assign(words + 1, 0);
+    for (uint32_t leaf : leafOf) leafOffsets[leaf + 1]++;
+    for (size_t w = 0; w < words; ++w) leafOffsets[w + 1] += leafOffsets[w];
+    members.resize(n);
+    vector<uint64_t> cursor(leafOffsets.begin(), leafOffsets.end() - 1);
+    for (size_t d = 0; d < n; ++d) members[cursor[leafOf[d]]++] = static_cast<uint32_t>(d);
+}
+
+void DescriptorIndex::search(const uint8_t* descriptors, size_t count, const DescriptorStore& store,
+                             const uint8_t* dead, TopK& best) const {
+    if (empty() || images() == 0 || count == 0 || store.size() != size()) return;
+    const size_t bytes = vocab.descriptorBytes();
+    const bool hamming = vocab.usesHamming();
+    // Khoảng cách L2 là bình phương nên tỉ lệ cũng được bình phương
+    const double ratio = hamming ? RATIO : RATIO * RATIO;
+    votes.resize(images(), 0);
+    voteStamp.assign(images(), 0);
+    touched.clear();
+
+    pair<uint32_t, uint32_t> nearest[NEIGHBOURS]; // (khoảng cách, descriptor) tăng dần
+    for (size_t q = 0; q < count; ++q) {
+        const uint8_t* query = descriptors + q * bytes;
+        // Best-first: lá gần nhất trước, rồi nhánh gần nhất trong hàng đợi cho tới khi đủ checks
+        pending.clear();
+        uint32_t leaf = vocab.descend(query, 0, pending);
+        size_t found = 0, examined = 0;
+        for (;;) {
+            for (uint64_t m = leafOffsets[leaf]; m < leafOffsets[leaf + 1]; ++m) {
+                uint32_t distance;
+                if (hamming) hammingFn(query, store.descriptor(members[m]), 1, bytes, &distance);
+                else l2Fn(query, store.descriptor(members[m]), 1, bytes, &distance);
+                if (found == NEIGHBOURS && distance >= nearest[found - 1].first) continue;
+                size_t at = found < NEIGHBOURS ? found++ : found - 1;
+                for (; at > 0 && nearest[at - 1].first > distance; --at) nearest[at] = nearest[at - 1];
+                nearest[at] = make_pair(distance, members[m]);
+            }
+            examined += leafOffsets[leaf + 1] - leafOffsets[leaf];
+            if (examined >= checks || pending.empty()) break;
+            pop_heap(pending.begin(), pending.end(), greater<VisualVocabulary::Branch>());
+            const uint32_t next = pending.back().second;
+            pending.pop_back();
+            leaf = vocab.descend(query, next, pending);
+        }
+        // Mỗi ảnh nhận tối đa một phiếu của một descriptor query
+        const uint32_t stamp = static_cast<uint32_t>(q + 1);
+        for (size_t i = 0; i < found; ++i) {
+            if (ratio * double(nearest[i].first) > double(nearest[0].first)) break;
+            const uint32_t image = owners[nearest[i].second];
+            if (voteStamp[image] == stamp) continue;
+            voteStamp[image] = stamp;
+            if (votes[image]++ == 0) touched.push_back(image);
+        }
+    }
+    for (uint32_t image : touched) {
+        const uint32_t imageVotes = votes[image];
+        votes[image] = 0;
+        if (dead && dead[image]) continue;
+        best.push(1.0 - double(imageVotes) / double(count), image);
+    }
+}
+
+bool DescriptorIndex::save(const string& filePath, uint64_t pathsHash) const {
+    string tmpPath = filePath + ".tmp";
+    {
+        ofstream out(tmpPath, ios::binary | ios::trunc);
+        if (!out.is_open()) {
+            cerr << "Error opening file for writing: " << tmpPath << endl;
+            return false;
+        }
+        out.write(KMT_MAGIC, sizeof(KMT_MAGIC));
+        writeValue(out, VERSION);
+        writeValue(out, uint32_t(0));
+        writeValue(out, static_cast<uint64_t>(images()));
+        writeValue(out, static_cast<uint64_t>(size()));
+        writeValue(out, pathsHash);
+        vocab.write(out);
+        out.write(reinterpret_cast<const char*>(imageOffsets.data()), imageOffsets.size() * sizeof(uint64_t));
+        out.write(reinterpret_cast<const char*>(leafOf.data()), leafOf.size() * sizeof(uint32_t));
+        if (!out.good()) {
+            cerr << "[DescriptorIndex] Failed writing " << tmpPath << endl;
+            return false;
+        }
+    }
+    error_code ec;
+    filesystem::rename(tmpPath, filePath, ec);
+    if (ec) {
+        cerr << "[DescriptorIndex] Cannot move " << tmpPath << " to " << filePath << ": " << ec.message() << endl;
+        return false;
+    }
+    return true;
+}
+
+bool DescriptorIndex::load(const string& filePath, uint64_t& pathsHash) {
+    clear();
+    ifstream in(filePath, ios::binary);
+    if (!in.is_open()) return false;
+
+    char magic[8];
+    uint32_t version, reserved;
+    uint64_t imageCount, descriptorCount;
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, KMT_MAGIC, sizeof(magic)) != 0 ||
+        !readValue(in, version) || version != VERSION || !readValue(in, reserved) || !readValue(in, imageCount) ||
+        !readValue(in, descriptorCount) || !readValue(in, pathsHash) || !vocab.read(in)) {
+        cerr << "[DescriptorIndex] Invalid index: " << filePath << endl;
+        clear();
+        return false;
+    }
+    imageOffsets.resize(imageCount + 1);
+    bool ok = static_cast<bool>(in.read(reinterpret_cast<char*>(imageOffsets.data()), imageOffsets.size() * sizeof(uint64_t)));
+    ok = ok && imageOffsets[0] == 0 && imageOffsets.back() == descriptorCount &&
+         is_sorted(imageOffsets.begin(), imageOffsets.end());
+    if (ok) {
+        leafOf.resize(descriptorCount);
+        ok = leafOf.empty() || in.read(reinterpret_cast<char*>(leafOf.data()), leafOf.size() * sizeof(uint32_t));
+    }
+    for (size_t d = 0; ok && d < leafOf.size(); ++d) ok = leafOf[d] < vocab.words();
+    if (!ok) {
+        cerr << "[DescriptorIndex] Truncated index: " << filePath << endl;
+        clear();
+        return false;
+    }
+    rebuildLeaves();
+    return true;
+}
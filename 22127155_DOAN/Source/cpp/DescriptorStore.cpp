@@ -0,0 +1,166 @@
+#include "DescriptorStore.h"
+#include "LocalFeature.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+using namespace std;
+
+static const char DSC_MAGIC[8] = {'C', 'B', 'I', 'R', 'D', 'S', 'C', '\0'};
+
+struct DescriptorStoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t descriptorBytes;
+    uint64_t imageCount;
+    uint64_t descriptorCount;
+    uint64_t pathsHash;
+};
+static_assert(sizeof(DescriptorStoreHeader) <= DescriptorStore::HEADER_SIZE, "header must fit in HEADER_SIZE");
+
+static uint64_t offsetsPosition(uint64_t descriptorCount, size_t bytes) {
+    return (DescriptorStore::HEADER_SIZE + descriptorCount * bytes + 7) & ~uint64_t(7);
+}
+
+void DescriptorStore::reset(size_t descriptorBytes) {
+    file.close();
+    bytes = descriptorBytes;
+    offsets.assign(1, 0);
+    data.clear();
+    syncPointers();
+}
+
+void DescriptorStore::syncPointers() {
+    offsetData = offsets.data();
+    descriptorData = data.data();
+    imageCount = offsets.size() - 1;
+}
+
+void DescriptorStore::reserve(size_t images, size_t descriptors) {
+    offsets.reserve(images + 1);
+    data.reserve(descriptors * bytes);
+}
+
+void DescriptorStore::appendRow(const float* row, size_t dim) {
+    if (isMapped()) {
+        // Chép vùng map vào bộ nhớ rồi nối tiếp như bình thường
+        offsets.assign(offsetData, offsetData + imageCount + 1);
+        data.assign(descriptorData, descriptorData + size() * bytes);
+        file.close();
+    }
+    const size_t count = bytes ? LocalFeature::packedCount(row, dim, bytes) : 0;
+    const uint8_t* src = LocalFeature::packedDescriptors(row);
+    data.insert(data.end(), src, src + count * bytes);
+    offsets.push_back(offsets.back() + count);
+    syncPointers();
+}
+
+bool DescriptorStore::map(const string& filePath, size_t descriptorBytes, uint64_t& pathsHash) {
+    reset(descriptorBytes);
+    if (!file.open(filePath)) return false;
+
+    DescriptorStoreHeader header;
+    bool ok = file.size() >= HEADER_SIZE;
+    if (ok) {
+        memcpy(&header, file.data(), sizeof(header));
+        ok = memcmp(header.magic, DSC_MAGIC, sizeof(DSC_MAGIC)) == 0 && header.version == VERSION &&
+             header.descriptorBytes == descriptorBytes &&
+             file.size() >= offsetsPosition(header.descriptorCount, bytes) + (header.imageCount + 1) * sizeof(uint64_t);
+    }
+    if (ok) {
+        const uint64_t* mappedOffsets =
+            reinterpret_cast<const uint64_t*>(file.data() + offsetsPosition(header.descriptorCount, bytes));
+        ok = mappedOffsets[0] == 0 && mappedOffsets[header.imageCount] == header.descriptorCount &&
+             is_sorted(mappedOffsets, mappedOffsets + header.imageCount + 1);
+        offsetData = mappedOffsets;
+    }
+    if (!ok) {
+        cerr << "[DescriptorStore] Invalid descriptor file: " << filePath << endl;
+        reset(descriptorBytes);
+        return false;
+    }
+    descriptorData = reinterpret_cast<const uint8_t*>(file.data() + HEADER_SIZE);
+    imageCount = static_cast<size_t>(header.imageCount);
+    pathsHash = header.pathsHash;
+    return true;
+}
+
+uint32_t DescriptorStore::imageOf(size_t index) const {
+    // Ảnh đầu tiên có offset kết thúc lớn hơn index (bỏ qua các ảnh rỗng)
+    const uint64_t* it = upper_bound(offsetData + 1, offsetData + imageCount + 1, static_cast<uint64_t>(index));
+    return static_cast<uint32_t>(it - offsetData - 1);
+}
+
+DescriptorStoreWriter::~DescriptorStoreWriter() {
+    if (!out.is_open()) return;
+    out.close();
+    std::error_code ec;
+    std::filesystem::remove(filePath + ".tmp", ec);
+}
+
+bool DescriptorStoreWriter::open(const string& path, size_t descriptorBytes) {
+    filePath = path;
+    bytes = descriptorBytes;
+    offsets.assign(1, 0);
+    out.open(filePath + ".tmp", ios::binary | ios::trunc);
+    if (!out.is_open()) {
+        cerr << "Error opening file for writing: " << filePath << ".tmp" << endl;
+        return false;
+    }
+    // Header tạm thời, sẽ được ghi lại khi close()
+    static const char zeros[DescriptorStore::HEADER_SIZE] = {};
+    out.write(zeros, sizeof(zeros));
+    return out.good();
+}
+
+bool DescriptorStoreWriter::append(const DescriptorStore& store) {
+    if (store.descriptorBytes() != bytes) return false;
+    out.write(reinterpret_cast<const char*>(store.descriptor(0)), store.size() * bytes);
+    const uint64_t base = offsets.back();
+    for (size_t i = 0; i < store.images(); ++i) offsets.push_back(base + store.offset(i) + store.count(i));
+    return out.good();
+}
+
+bool DescriptorStoreWriter::appendRow(const float* row, size_t dim) {
+    const size_t count = bytes ? LocalFeature::packedCount(row, dim, bytes) : 0;
+    out.write(reinterpret_cast<const char*>(LocalFeature::packedDescriptors(row)), count * bytes);
+    offsets.push_back(offsets.back() + count);
+    return out.good();
+}
+
+bool DescriptorStoreWriter::close(uint64_t pathsHash) {
+    if (!out.is_open()) return false;
+    const uint64_t descriptorCount = offsets.back();
+    static const char zeros[8] = {};
+    const uint64_t position = offsetsPosition(descriptorCount, bytes);
+    out.write(zeros, position - (DescriptorStore::HEADER_SIZE + descriptorCount * bytes));
+    out.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+
+    DescriptorStoreHeader header{};
+    memcpy(header.magic, DSC_MAGIC, sizeof(DSC_MAGIC));
+    header.version = DescriptorStore::VERSION;
+    header.descriptorBytes = static_cast<uint32_t>(bytes);
+    header.imageCount = images();
+    header.descriptorCount = descriptorCount;
+    header.pathsHash = pathsHash;
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    bool ok = out.good();
+    out.close();
+
+    const string tmpPath = filePath + ".tmp";
+    std::error_code ec;
+    if (!ok) {
+        cerr << "[DescriptorStore] Failed writing " << tmpPath << endl;
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    std::filesystem::rename(tmpPath, filePath, ec);
+    if (ec) {
+        cerr << "[DescriptorStore] Cannot move " << tmpPath << " to " << filePath << ": " << ec.message() << endl;
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,744 @@
+#include "DistanceKernels.h"
+#include "Half.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CBIR_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC/Clang cần thuộc tính target để sinh lệnh AVX trong một file biên dịch cho SSE2;
+// MSVC cho phép dùng intrinsics trực tiếp
+#if defined(CBIR_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_SSE42 __attribute__((target("sse4.2,popcnt")))
+#define TARGET_AVX2 __attribute__((target("avx2,fma,popcnt")))
+#define TARGET_AVX2_F16C __attribute__((target("avx2,fma,f16c,popcnt")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#define TARGET_VPOPCNT __attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+#else
+#define TARGET_SSE42
+#define TARGET_AVX2
+#define TARGET_AVX2_F16C
+#define TARGET_AVX512
+#define TARGET_VPOPCNT
+#endif
+
+using namespace std;
+
+// Với D != 0 số chiều là hằng số lúc biên dịch: trình biên dịch trải hết vòng lặp
+
+template <size_t D>
+static float squaredL2Scalar(const float* a, const float* b, size_t dim) {
+    const size_t n = D ? D : dim;
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float d0 = a[i] - b[i], d1 = a[i + 1] - b[i + 1];
+        float d2 = a[i + 2] - b[i + 2], d3 = a[i + 3] - b[i + 3];
+        s0 += d0 * d0;
+        s1 += d1 * d1;
+        s2 += d2 * d2;
+        s3 += d3 * d3;
+    }
+    if (D == 0 || D % 4 != 0) {
+        for (; i < n; ++i) {
+            float d = a[i] - b[i];
+            s0 += d * d;
+        }
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+static float squaredL2ScalarDispatch(const float* a, const float* b, size_t dim) {
+    switch (dim) {
+        case 8: return squaredL2Scalar<8>(a, b, dim);
+        case 64: return squaredL2Scalar<64>(a, b, dim); // khối của squaredL2Bounded
+        case 384: return squaredL2Scalar<384>(a, b, dim);
+        case 512: return squaredL2Scalar<512>(a, b, dim);
+        default: return squaredL2Scalar<0>(a, b, dim);
+    }
+}
+
+// Hàng đã lượng tử hóa (ScalarQuantizer): giải mã từng phần tử rồi trừ với query
+
+static float squaredL2HalfScalar(const float* query, const uint16_t* row, size_t dim) {
+    float s0 = 0.0f, s1 = 0.0f;
+    size_t i = 0;
+    for (; i + 2 <= dim; i += 2) {
+        float d0 = query[i] - halfToFloat(row[i]), d1 = query[i + 1] - halfToFloat(row[i + 1]);
+        s0 += d0 * d0;
+        s1 += d1 * d1;
+    }
+    if (i < dim) {
+        float d = query[i] - halfToFloat(row[i]);
+        s0 += d * d;
+    }
+    return s0 + s1;
+}
+
+static float squaredL2ByteScalar(const float* query, const uint8_t* row, const float* scale, const float* offset,
+                                 size_t dim) {
+    float s0 = 0.0f, s1 = 0.0f;
+    size_t i = 0;
+    for (; i + 2 <= dim; i += 2) {
+        float d0 = query[i] - (offset[i] + scale[i] * row[i]);
+        float d1 = query[i + 1] - (offset[i + 1] + scale[i + 1] * row[i + 1]);
+        s0 += d0 * d0;
+        s1 += d1 * d1;
+    }
+    if (i < dim) {
+        float d = query[i] - (offset[i] + scale[i] * row[i]);
+        s0 += d * d;
+    }
+    return s0 + s1;
+}
+
+// Descriptor nhị phân: popcount của a XOR b theo từng từ 64-bit
+
+static inline uint64_t loadWord(const uint8_t* p) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+static inline uint32_t popcountScalar(uint64_t x) {
+    // SWAR: đếm bit song song trong các nhóm 2, 4, 8 bit rồi cộng 8 byte bằng một phép nhân
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return static_cast<uint32_t>((x * 0x0101010101010101ULL) >> 56);
+}
+
+static void hammingScalar(const uint8_t* query, const uint8_t* rows, size_t count, size_t bytes, uint32_t* out) {
+    for (size_t r = 0; r < count; ++r) {
+        const uint8_t* row = rows + r * bytes;
+        uint32_t sum = 0;
+        for (size_t i = 0; i < bytes; i += 8) sum += popcountScalar(loadWord(query + i) ^ loadWord(row + i));
+        out[r] = sum;
+    }
+}
+
+// Descriptor uint8 (SIFT): bình phương khoảng cách Euclidean, tính chính xác bằng số nguyên
+static void squaredL2U8Scalar(const uint8_t* query, const uint8_t* rows, size_t count, size_t bytes, uint32_t* out) {
+    for (size_t r = 0; r < count; ++r) {
+        const uint8_t* row = rows + r * bytes;
+        uint32_t sum = 0;
+        for (size_t i = 0; i < bytes; ++i) {
+            const int d = int(query[i]) - int(row[i]);
+            sum += static_cast<uint32_t>(d * d);
+        }
+        out[r] = sum;
+    }
+}
+
+#ifdef CBIR_X86
+
+TARGET_SSE42 static inline float horizontalSum128(__m128 v) {
+    __m128 shuf = _mm_movehdup_ps(v);
+    __m128 sums = _mm_add_ps(v, shuf);
+    shuf = _mm_movehl_ps(shuf, sums);
+    return _mm_cvtss_f32(_mm_add_ss(sums, shuf));
+}
+
+template <size_t D>
+TARGET_SSE42 static float squaredL2Sse(const float* a, const float* b, size_t dim) {
+    const size_t n = D ? D : dim;
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128 d0 = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+        __m128 d1 = _mm_sub_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4));
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(d0, d0));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(d1, d1));
+    }
+    for (; i + 4 <= n; i += 4) {
+        __m128 d = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(d, d));
+    }
+    float sum = horizontalSum128(_mm_add_ps(acc0, acc1));
+    for (; i < n; ++i) {
+        float d = a[i] - b[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+TARGET_SSE42 static float squaredL2SseDispatch(const float* a, const float* b, size_t dim) {
+    switch (dim) {
+        case 8: return squaredL2Sse<8>(a, b, dim);
+        case 64: return squaredL2Sse<64>(a, b, dim); // khối của squaredL2Bounded
+        case 384: return squaredL2Sse<384>(a, b, dim);
+        case 512: return squaredL2Sse<512>(a, b, dim);
+        default: return squaredL2Sse<0>(a, b, dim);
+    }
+}
+
+TARGET_AVX2 static inline float horizontalSum256(__m256 v) {
+    __m128 low = _mm256_castps256_ps128(v);
+    __m128 high = _mm256_extractf128_ps(v, 1);
+    __m128 sum = _mm_add_ps(low, high);
+    __m128 shuf = _mm_movehdup_ps(sum);
+    sum = _mm_add_ps(sum, shuf);
+    shuf = _mm_movehl_ps(shuf, sum);
+    return _mm_cvtss_f32(_mm_add_ss(sum, shuf));
+}
+
+template <size_t D>
+TARGET_AVX2 static float squaredL2Avx2(const float* a, const float* b, size_t dim) {
+    const size_t n = D ? D : dim;
+    // Bốn bộ tích lũy độc lập để che độ trễ của FMA
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+        __m256 d2 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16));
+        __m256 d3 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+        acc2 = _mm256_fmadd_ps(d2, d2, acc2);
+        acc3 = _mm256_fmadd_ps(d3, d3, acc3);
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        acc0 = _mm256_fmadd_ps(d, d, acc0);
+    }
+    float sum = horizontalSum256(_mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3)));
+    for (; i < n; ++i) {
+        float d = a[i] - b[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+TARGET_AVX2 static float squaredL2Avx2Dispatch(const float* a, const float* b, size_t dim) {
+    switch (dim) {
+        case 8: return squaredL2Avx2<8>(a, b, dim);
+        case 64: return squaredL2Avx2<64>(a, b, dim); // khối của squaredL2Bounded
+        case 384: return squaredL2Avx2<384>(a, b, dim);
+        case 512: return squaredL2Avx2<512>(a, b, dim);
+        default: return squaredL2Avx2<0>(a, b, dim);
+    }
+}
+
+// GCC 12 báo nhầm -Wmaybe-uninitialized / -Wuninitialized bên trong header AVX-512 của chính nó
+// (_mm512_undefined_ps, _mm256_undefined_pd trong _mm512_reduce_add_ps)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+
+template <size_t D>
+TARGET_AVX512 static float squaredL2Avx512(const float* a, const float* b, size_t dim) {
+    const size_t n = D ? D : dim;
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    __m512 acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+        __m512 d2 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 32), _mm512_loadu_ps(b + i + 32));
+        __m512 d3 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 48), _mm512_loadu_ps(b + i + 48));
+        acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+        acc2 = _mm512_fmadd_ps(d2, d2, acc2);
+        acc3 = _mm512_fmadd_ps(d3, d3, acc3);
+    }
+    for (; i + 16 <= n; i += 16) {
+        __m512 d = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        acc0 = _mm512_fmadd_ps(d, d, acc0);
+    }
+    if (i < n) {
+        // Phần dư (< 16 phần tử) được nạp bằng mask, không cần vòng lặp vô hướng
+        __mmask16 mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+        __m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i));
+        acc1 = _mm512_fmadd_ps(d, d, acc1);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(acc0, acc1), _mm512_add_ps(acc2, acc3)));
+}
+
+TARGET_AVX512 static float squaredL2Avx512Dispatch(const float* a, const float* b, size_t dim) {
+    switch (dim) {
+        case 8: return squaredL2Avx2<8>(a, b, dim); // một thanh ghi 256-bit là đủ
+        case 64: return squaredL2Avx512<64>(a, b, dim); // khối của squaredL2Bounded
+        case 384: return squaredL2Avx512<384>(a, b, dim);
+        case 512: return squaredL2Avx512<512>(a, b, dim);
+        default: return squaredL2Avx512<0>(a, b, dim);
+    }
+}
+
+// Hàng byte: 8 code -> 8 int32 -> float, x = offset + scale * code ngay trong thanh ghi
+TARGET_SSE42 static float squaredL2ByteSse(const float* query, const uint8_t* row, const float* scale,
+                                           const float* offset, size_t dim) {
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= dim; i += 8) {
+        __m128i codes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + i));
+        __m128 x0 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(codes));
+        __m128 x1 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(codes, 4)));
+        x0 = _mm_add_ps(_mm_mul_ps(x0, _mm_loadu_ps(scale + i)), _mm_loadu_ps(offset + i));
+        x1 = _mm_add_ps(_mm_mul_ps(x1, _mm_loadu_ps(scale + i + 4)), _mm_loadu_ps(offset + i + 4));
+        __m128 d0 = _mm_sub_ps(_mm_loadu_ps(query + i), x0);
+        __m128 d1 = _mm_sub_ps(_mm_loadu_ps(query + i + 4), x1);
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(d0, d0));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(d1, d1));
+    }
+    float sum = horizontalSum128(_mm_add_ps(acc0, acc1));
+    for (; i < dim; ++i) {
+        float d = query[i] - (offset[i] + scale[i] * row[i]);
+        sum += d * d;
+    }
+    return sum;
+}
+
+// Hàng float16: vcvtph2ps đổi 8 half sang 8 float trong một lệnh
+TARGET_AVX2_F16C static float squaredL2HalfAvx2(const float* query, const uint16_t* row, size_t dim) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= dim; i += 16) {
+        __m256 x0 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i)));
+        __m256 x1 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i + 8)));
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(query + i), x0);
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(query + i + 8), x1);
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+    }
+    for (; i + 8 <= dim; i += 8) {
+        __m256 x = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i)));
+        __m256 d = _mm256_sub_ps(_mm256_loadu_ps(query + i), x);
+        acc0 = _mm256_fmadd_ps(d, d, acc0);
+    }
+    float sum = horizontalSum256(_mm256_add_ps(acc0, acc1));
+    for (; i < dim; ++i) {
+        float d = query[i] - halfToFloat(row[i]);
+        sum += d * d;
+    }
+    return sum;
+}
+
+TARGET_AVX2 static float squaredL2ByteAvx2(const float* query, const uint8_t* row, const float* scale,
+                                           const float* offset, size_t dim) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= dim; i += 16) {
+        __m128i codes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m256 x0 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(codes));
+        __m256 x1 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(codes, 8)));
+        x0 = _mm256_fmadd_ps(x0, _mm256_loadu_ps(scale + i), _mm256_loadu_ps(offset + i));
+        x1 = _mm256_fmadd_ps(x1, _mm256_loadu_ps(scale + i + 8), _mm256_loadu_ps(offset + i + 8));
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(query + i), x0);
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(query + i + 8), x1);
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+    }
+    for (; i + 8 <= dim; i += 8) {
+        __m256 x = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + i))));
+        x = _mm256_fmadd_ps(x, _mm256_loadu_ps(scale + i), _mm256_loadu_ps(offset + i));
+        __m256 d = _mm256_sub_ps(_mm256_loadu_ps(query + i), x);
+        acc0 = _mm256_fmadd_ps(d, d, acc0);
+    }
+    float sum = horizontalSum256(_mm256_add_ps(acc0, acc1));
+    for (; i < dim; ++i) {
+        float d = query[i] - (offset[i] + scale[i] * row[i]);
+        sum += d * d;
+    }
+    return sum;
+}
+
+TARGET_SSE42 static inline uint32_t popcount64(uint64_t x) {
+#if defined(__x86_64__) || defined(_M_X64)
+    return static_cast<uint32_t>(_mm_popcnt_u64(x));
+#else
+    return static_cast<uint32_t>(_mm_popcnt_u32(static_cast<uint32_t>(x)) + _mm_popcnt_u32(static_cast<uint32_t>(x >> 32)));
+#endif
+}
+
+// Lệnh popcnt trên từng từ 64-bit
+TARGET_SSE42 static void hammingPopcnt(const uint8_t* query, const uint8_t* rows, size_t count, size_t bytes,
+                                       uint32_t* out) {
+    for (size_t r = 0; r < count; ++r) {
+        const uint8_t* row = rows + r * bytes;
+        uint32_t sum = 0;
+        for (size_t i = 0; i < bytes; i += 8) sum += popcount64(loadWord(query + i) ^ loadWord(row + i));
+        out[r] = sum;
+    }
+}
+
+// Popcount của từng byte bằng bảng 16 phần tử (vpshufb trên hai nửa nibble), cộng theo 8 byte -> 4 x uint64
+TARGET_AVX2 static inline __m256i popcountAvx2(__m256i v) {
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lowMask = _mm256_set1_epi8(0x0F);
+    __m256i low = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, lowMask));
+    __m256i high = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), lowMask));
+    return _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256());
+}
+
+TARGET_AVX2 static void hammingAvx2(const uint8_t* query, const uint8_t* rows, size_t count, size_t bytes,
+                                    uint32_t* out) {
+    const size_t chunks = bytes / 32;
+    size_t r = 0;
+    // Bốn descriptor một lượt: phần cộng ngang được dùng chung cho cả bốn
+    for (; chunks > 0 && r + 4 <= count; r += 4) {
+        const uint8_t* row = rows + r * bytes;
+        __m256i s0 = _mm256_setzero_si256(), s1 = _mm256_setzero_si256();
+        __m256i s2 = _mm256_setzero_si256(), s3 = _mm256_setzero_si256();
+        for (size_t c = 0; c < chunks; ++c) {
+            const size_t at = c * 32;
+            __m256i q = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(query + at));
+            s0 = _mm256_add_epi64(s0, popcountAvx2(_mm256_xor_si256(q, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + at)))));
+            s1 = _mm256_add_epi64(s1, popcountAvx2(_mm256_xor_si256(q, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + bytes + at)))));
+            s2 = _mm256_add_epi64(s2, popcountAvx2(_mm256_xor_si256(q, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + 2 * bytes + at)))));
+            s3 = _mm256_add_epi64(s3, popcountAvx2(_mm256_xor_si256(q, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + 3 * bytes + at)))));
+        }
+        // Lane 64-bit d của sums là tổng bốn lane của s_d
+        __m256i t01 = _mm256_add_epi64(_mm256_unpacklo_epi64(s0, s1), _mm256_unpackhi_epi64(s0, s1));
+        __m256i t23 = _mm256_add_epi64(_mm256_unpacklo_epi64(s2, s3), _mm256_unpackhi_epi64(s2, s3));
+        __m256i sums = _mm256_add_epi64(_mm256_permute2x128_si256(t01, t23, 0x20), _mm256_permute2x128_si256(t01, t23, 0x31));
+        sums = _mm256_permutevar8x32_epi32(sums, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + r), _mm256_castsi256_si128(sums));
+        for (size_t i = chunks * 32; i < bytes; i += 8) {
+            const uint64_t q = loadWord(query + i);
+            for (size_t d = 0; d < 4; ++d) out[r + d] += popcount64(q ^ loadWord(row + d * bytes + i));
+        }
+    }
+    hammingPopcnt(query, rows + r * bytes, count - r, bytes, out + r);
+}
+
+// Mở rộng 8 byte -> int16, hiệu bình phương cộng theo cặp bằng pmaddwd (không tràn: 2 x 255² < 2^31)
+TARGET_SSE42 static void squaredL2U8Sse(const uint8_t* query, const uint8_t* rows, size_t count, size_t bytes,
+                                        uint32_t* out) {
+    const size_t vectorBytes = bytes & ~size_t(15);
+    for (size_t r = 0; r < count; ++r) {
+        const uint8_t* row = rows + r * bytes;
+        __m128i sum = _mm_setzero_si128();
+        for (size_t i = 0; i < vectorBytes; i += 16) {
+            __m128i q = _mm_loadu_si128(reinterpret_cast<const __m128i*>(query + i));
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+            __m128i dLow = _mm_sub_epi16(_mm_cvtepu8_epi16(q), _mm_cvtepu8_epi16(x));
+            __m128i dHigh = _mm_sub_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(q, 8)), _mm_cvtepu8_epi16(_mm_srli_si128(x, 8)));
+            sum = _mm_add_epi32(sum, _mm_add_epi32(_mm_madd_epi16(dLow, dLow), _mm_madd_epi16(dHigh, dHigh)));
+        }
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+        uint32_t total = static_cast<uint32_t>(_mm_cvtsi128_si32(sum));
+        for (size_t i = vectorBytes; i < bytes; ++i) {
+            const int d = int(query[i]) - int(row[i]);
+            total += static_cast<uint32_t>(d * d);
+        }
+        out[r] = total;
+    }
+}
+
+TARGET_AVX2 static void squaredL2U8Avx2(const uint8_t* query, const uint8_t* rows, size_t count, size_t bytes,
+                                        uint32_t* out) {
+    const size_t vectorBytes = bytes & ~size_t(15);
+    for (size_t r = 0; r < count; ++r) {
+        const uint8_t* row = rows + r * bytes;
+        __m256i sum = _mm256_setzero_si256();
+        for (size_t i = 0; i < vectorBytes; i += 16) {
+            __m256i q = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(query + i)));
+            __m256i x = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i)));
+            __m256i d = _mm256_sub_epi16(q, x);
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(d, d));
+        }
+        __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+        uint32_t total = static_cast<uint32_t>(_mm_cvtsi128_si32(half));
+        for (size_t i = vectorBytes; i < bytes; ++i) {
+            const int d = int(query[i]) - int(row[i]);
+            total += static_cast<uint32_t>(d * d);
+        }
+        out[r] = total;
+    }
+}
+
+TARGET_AVX512 static float squaredL2HalfAvx512(const float* query, const uint16_t* row, size_t dim) {
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= dim; i += 32) {
+        __m512 x0 = _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i)));
+        __m512 x1 = _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i + 16)));
+        __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(query + i), x0);
+        __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(query + i + 16), x1);
+        acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+    }
+    for (; i + 16 <= dim; i += 16) {
+        __m512 x = _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i)));
+        __m512 d = _mm512_sub_ps(_mm512_loadu_ps(query + i), x);
+        acc0 = _mm512_fmadd_ps(d, d, acc0);
+    }
+    float sum = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+    for (; i < dim; ++i) {
+        float d = query[i] - halfToFloat(row[i]);
+        sum += d * d;
+    }
+    return sum;
+}
+
+TARGET_AVX512 static float squaredL2ByteAvx512(const float* query, const uint8_t* row, const float* scale,
+                                               const float* offset, size_t dim) {
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= dim; i += 32) {
+        __m512 x0 = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i))));
+        __m512 x1 = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i + 16))));
+        x0 = _mm512_fmadd_ps(x0, _mm512_loadu_ps(scale + i), _mm512_loadu_ps(offset + i));
+        x1 = _mm512_fmadd_ps(x1, _mm512_loadu_ps(scale + i + 16), _mm512_loadu_ps(offset + i + 16));
+        __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(query + i), x0);
+        __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(query + i + 16), x1);
+        acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+    }
+    for (; i + 16 <= dim; i += 16) {
+        __m512 x = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i))));
+        x = _mm512_fmadd_ps(x, _mm512_loadu_ps(scale + i), _mm512_loadu_ps(offset + i));
+        __m512 d = _mm512_sub_ps(_mm512_loadu_ps(query + i), x);
+        acc0 = _mm512_fmadd_ps(d, d, acc0);
+    }
+    float sum = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+    for (; i < dim; ++i) {
+        float d = query[i] - (offset[i] + scale[i] * row[i]);
+        sum += d * d;
+    }
+    return sum;
+}
+
+// VPOPCNTDQ: popcount trực tiếp trên 8 từ 64-bit. Descriptor 32 byte (ORB) đi theo cặp trong một thanh ghi.
+TARGET_VPOPCNT static void hammingAvx512(const uint8_t* query, const uint8_t* rows, size_t count, size_t bytes,
+                                         uint32_t* out) {
+    size_t r = 0;
+    if (bytes == 32) {
+        const __m512i q = _mm512_broadcast_i64x4(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(query)));
+        for (; r + 2 <= count; r += 2) {
+            __m512i bits = _mm512_popcnt_epi64(_mm512_xor_si512(q, _mm512_loadu_si512(rows + r * 32)));
+            // Cộng 4 từ của mỗi nửa 256-bit: đổi chỗ trong từng cặp từ, rồi từng cặp lane 128-bit
+            bits = _mm512_add_epi64(bits, _mm512_shuffle_epi32(bits, _MM_PERM_BADC));
+            bits = _mm512_add_epi64(bits, _mm512_shuffle_i64x2(bits, bits, _MM_SHUFFLE(2, 3, 0, 1)));
+            __m256i sums = _mm512_cvtepi64_epi32(bits);
+            out[r] = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm256_castsi256_si128(sums)));
+            out[r + 1] = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm256_extracti128_si256(sums, 1)));
+        }
+    }
+    const size_t words = bytes / 8;
+    for (; r < count; ++r) {
+        const uint8_t* row = rows + r * bytes;
+        __m512i acc = _mm512_setzero_si512();
+        size_t w = 0;
+        for (; w + 8 <= words; w += 8) {
+            __m512i x = _mm512_xor_si512(_mm512_loadu_si512(query + w * 8), _mm512_loadu_si512(row + w * 8));
+            acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(x));
+        }
+        if (w < words) {
+            // Phần dư (< 8 từ) nạp bằng mask
+            __mmask8 mask = static_cast<__mmask8>((1u << (words - w)) - 1);
+            __m512i x = _mm512_xor_si512(_mm512_maskz_loadu_epi64(mask, query + w * 8), _mm512_maskz_loadu_epi64(mask, row + w * 8));
+            acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(x));
+        }
+        out[r] = static_cast<uint32_t>(_mm512_reduce_add_epi64(acc));
+    }
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// Phát hiện ISA: CPU phải hỗ trợ lệnh và hệ điều hành phải lưu các thanh ghi rộng
+static DistanceKernels::Isa detectIsa() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool sse42 = (info[2] & (1 << 20)) != 0 && (info[2] & (1 << 23)) != 0; // kèm popcnt
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    bool fma = (info[2] & (1 << 12)) != 0;
+    bool f16c = (info[2] & (1 << 29)) != 0;
+    bool avx2 = false, avx512 = false;
+    if (maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+        avx512 = (info[1] & (1 << 16)) != 0;
+    }
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    bool ymmState = (xcr0 & 0x6) == 0x6;
+    bool zmmState = (xcr0 & 0xE6) == 0xE6;
+    if (avx512 && avx2 && fma && f16c && avx && zmmState) return DistanceKernels::AVX512;
+    if (avx2 && fma && f16c && avx && ymmState) return DistanceKernels::AVX2;
+    if (sse42) return DistanceKernels::SSE42;
+    return DistanceKernels::Scalar;
+#else
+    // libgcc kiểm tra cả XCR0 cho các tính năng AVX. F16C (kernel float16) có trên mọi CPU AVX2
+    // thực tế nhưng vẫn được kiểm tra cho chắc chắn.
+    __builtin_cpu_init();
+    const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c");
+    if (avx2 && __builtin_cpu_supports("avx512f")) return DistanceKernels::AVX512;
+    if (avx2) return DistanceKernels::AVX2;
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt")) return DistanceKernels::SSE42;
+    return DistanceKernels::Scalar;
+#endif
+}
+
+// VPOPCNTDQ là phần mở rộng riêng của AVX-512 (Ice Lake, Zen 4 trở đi), chỉ kernel Hamming cần
+static bool hasVpopcntdq() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuidex(info, 7, 0);
+    return (info[2] & (1 << 14)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512vpopcntdq");
+#endif
+}
+
+#endif // CBIR_X86
+
+DistanceKernels::Isa DistanceKernels::isa() {
+    static const Isa selected = [] {
+#ifdef CBIR_X86
+        Isa detected = detectIsa();
+#else
+        Isa detected = Scalar;
+#endif
+        // Cho phép ép xuống mức thấp hơn (kiểm thử, đo hiệu năng)
+        if (const char* forced = getenv("CBIR_SIMD")) {
+            for (int level = Scalar; level <= AVX512; ++level) {
+                if (strcmp(forced, isaName(static_cast<Isa>(level))) == 0) {
+                    if (level <= detected) detected = static_cast<Isa>(level);
+                    else cerr << "[DistanceKernels] " << forced << " is not supported on this CPU" << endl;
+                }
+            }
+        }
+        return detected;
+    }();
+    return selected;
+}
+
+const char* DistanceKernels::isaName(Isa isa) {
+    switch (isa) {
+        case SSE42: return "sse4.2";
+        case AVX2: return "avx2";
+        case AVX512: return "avx512";
+        default: return "scalar";
+    }
+}
+
+DistanceKernels::SquaredL2Fn DistanceKernels::squaredL2Kernel(Isa level) {
+    switch (level) {
+#ifdef CBIR_X86
+        case SSE42: return squaredL2SseDispatch;
+        case AVX2: return squaredL2Avx2Dispatch;
+        case AVX512: return squaredL2Avx512Dispatch;
+#endif
+        case Scalar: return squaredL2ScalarDispatch;
+        default: return nullptr;
+    }
+}
+
+DistanceKernels::SquaredL2Fn DistanceKernels::squaredL2Kernel() {
+    static const SquaredL2Fn kernel = squaredL2Kernel(isa());
+    return kernel;
+}
+
+DistanceKernels::SquaredL2HalfFn DistanceKernels::squaredL2HalfKernel(Isa level) {
+    switch (level) {
+#ifdef CBIR_X86
+        case SSE42: return squaredL2HalfScalar; // F16C cần mức AVX2
+        case AVX2: return squaredL2HalfAvx2;
+        case AVX512: return squaredL2HalfAvx512;
+#endif
+        case Scalar: return squaredL2HalfScalar;
+        default: return nullptr;
+    }
+}
+
+DistanceKernels::SquaredL2HalfFn DistanceKernels::squaredL2HalfKernel() {
+    static const SquaredL2HalfFn kernel = squaredL2HalfKernel(isa());
+    return kernel;
+}
+
+DistanceKernels::SquaredL2ByteFn DistanceKernels::squaredL2ByteKernel(Isa level) {
+    switch (level) {
+#ifdef CBIR_X86
+        case SSE42: return squaredL2ByteSse;
+        case AVX2: return squaredL2ByteAvx2;
+        case AVX512: return squaredL2ByteAvx512;
+#endif
+        case Scalar: return squaredL2ByteScalar;
+        default: return nullptr;
+    }
+}
+
+DistanceKernels::SquaredL2ByteFn DistanceKernels::squaredL2ByteKernel() {
+    static const SquaredL2ByteFn kernel = squaredL2ByteKernel(isa());
+    return kernel;
+}
+
+DistanceKernels::HammingFn DistanceKernels::hammingKernel(Isa level) {
+    switch (level) {
+#ifdef CBIR_X86
+        case SSE42: return hammingPopcnt;
+        case AVX2: return hammingAvx2;
+        case AVX512: return hasVpopcntdq() ? hammingAvx512 : hammingAvx2;
+#endif
+        case Scalar: return hammingScalar;
+        default: return nullptr;
+    }
+}
+
+DistanceKernels::HammingFn DistanceKernels::hammingKernel() {
+    static const HammingFn kernel = hammingKernel(isa());
+    return kernel;
+}
+
+DistanceKernels::SquaredL2U8Fn DistanceKernels::squaredL2U8Kernel(Isa level) {
+    switch (level) {
+#ifdef CBIR_X86
+        case SSE42: return squaredL2U8Sse;
+        // pmaddwd trên zmm cần AVX-512BW, mức AVX512 chỉ yêu cầu AVX-512F
+        case AVX2:
+        case AVX512: return squaredL2U8Avx2;
+#endif
+        case Scalar: return squaredL2U8Scalar;
+        default: return nullptr;
+    }
+}
+
+DistanceKernels::SquaredL2U8Fn DistanceKernels::squaredL2U8Kernel() {
+    static const SquaredL2U8Fn kernel = squaredL2U8Kernel(isa());
+    return kernel;
+}
+
+float DistanceKernels::squaredNorm(const float* a, size_t dim) {
+    double sum = 0.0;
+    for (size_t i = 0; i < dim; ++i) sum += static_cast<double>(a[i]) * a[i];
+    return static_cast<float>(sum);
+}
+
+float DistanceKernels::squaredL2Bounded(const float* a, const float* b, size_t dim, float boundSquared,
+                                        const uint32_t* blockOrder) {
+    const SquaredL2Fn kernel = squaredL2Kernel();
+    const size_t blocks = (dim + BOUND_BLOCK - 1) / BOUND_BLOCK;
+    float sum = 0.0f;
+    for (size_t i = 0; i < blocks; ++i) {
+        const size_t offset = (blockOrder ? blockOrder[i] : i) * BOUND_BLOCK;
+        sum += kernel(a + offset, b + offset, min(BOUND_BLOCK, dim - offset));
+        // Các khối còn lại chỉ làm tổng tăng thêm: hàng này chắc chắn không vào top-k
+        if (sum > boundSquared) return numeric_limits<float>::infinity();
+    }
+    return sum;
+}
@@ -1,7 +1,9 @@
 #include "EdgeFeatureExtractor.h"
+#include "DistanceKernels.h"
 #include <opencv2/imgproc.hpp>
 #include <cmath>
 #include <numeric>
+#include <sstream>
 
 // Thay thế hàm extract trong EdgeFeatureExtractor
 std::vector<float> EdgeFeatureExtractor::extract(const cv::Mat& image) {
@@ -39,14 +41,25 @@ std::vector<float> EdgeFeatureExtractor::extract(const cv::Mat& image) {
     return hist;
 }
 
+std::string EdgeFeatureExtractor::getConfig() const {
+    std::ostringstream oss;
+    oss << getMethodName() << "(t1=" << thresh1 << ",t2=" << thresh2 << ")";
+    return oss.str();
+}
+
 // Compare two feature vectors
-double EdgeFeatureExtractor::compare(const std::vector<float>& feat1, const std::vector<float>& feat2) {
+double EdgeFeatureExtractor::compare(const std::vector<float>& feat1, const std::vector<float>& feat2) const {
     // Khoảng cách Euclidean đơn giản
     if (feat1.size() != feat2.size()) return 9999.0;
-    double sum = 0.0;
-    for (size_t i = 0; i < feat1.size(); ++i) {
-        double diff = feat1[i] - feat2[i];
-        sum += diff * diff;
-    }
-    return std::sqrt(sum);
+    return compareRaw(feat1.data(), feat2.data(), feat1.size());
+}
+
+double EdgeFeatureExtractor::compareRaw(const float* feat1, const float* feat2, size_t dim) const {
+    // Khoảng cách Euclidean (kernel SIMD chọn theo CPU)
+    return DistanceKernels::l2(feat1, feat2, dim);
+}
+
+double EdgeFeatureExtractor::compareBounded(const float* feat1, const float* feat2, size_t dim, double bound) const {
+    // Dừng sớm khi tổng riêng phần vượt ngưỡng
+    return DistanceKernels::l2Bounded(feat1, feat2, dim, bound);
 }
\ No newline at end of file
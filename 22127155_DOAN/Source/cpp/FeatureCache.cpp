@@ -0,0 +1,144 @@
+#include "FeatureCache.h"
+#include "Hash.h"
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static const char FEATURE_CACHE_MAGIC[8] = {'C', 'B', 'I', 'R', 'F', 'C', 'A', '\0'};
+
+// Kích thước phần đầu của một bản ghi: hash, size, count
+static const uint64_t RECORD_HEADER_BYTES = sizeof(uint64_t) * 2 + sizeof(uint32_t);
+
+bool FeatureCache::open(const string& directory, const string& config) {
+    close();
+    char fingerprint[17];
+    snprintf(fingerprint, sizeof(fingerprint), "%016llx", static_cast<unsigned long long>(fnv1a64(config)));
+    fs::path dir = fs::path(directory) / fingerprint;
+    error_code ec;
+    fs::create_directories(dir, ec);
+    packPath = (dir / "features.pack").string();
+
+    uint32_t configLength = static_cast<uint32_t>(config.size());
+    uint64_t dataStart = sizeof(FEATURE_CACHE_MAGIC) + sizeof(VERSION) + sizeof(configLength) + configLength;
+    uint64_t fileSize = fs::exists(packPath, ec) ? fs::file_size(packPath, ec) : 0;
+
+    if (fileSize < dataStart) {
+        // Pack mới (hoặc header bị hỏng): ghi lại header
+        ofstream out(packPath, ios::binary | ios::trunc);
+        if (!out.is_open()) {
+            cerr << "[FeatureCache] Cannot create " << packPath << endl;
+            return false;
+        }
+        out.write(FEATURE_CACHE_MAGIC, sizeof(FEATURE_CACHE_MAGIC));
+        out.write(reinterpret_cast<const char*>(&VERSION), sizeof(VERSION));
+        out.write(reinterpret_cast<const char*>(&configLength), sizeof(configLength));
+        out.write(config.data(), configLength);
+        if (!out.good()) return false;
+        fileSize = dataStart;
+    } else {
+        ifstream in(packPath, ios::binary);
+        char magic[8];
+        uint32_t version = 0, length = 0;
+        in.read(magic, sizeof(magic));
+        in.read(reinterpret_cast<char*>(&version), sizeof(version));
+        in.read(reinterpret_cast<char*>(&length), sizeof(length));
+        string stored(length, '\0');
+        if (length > 0) in.read(&stored[0], length);
+        if (!in || memcmp(magic, FEATURE_CACHE_MAGIC, sizeof(magic)) != 0 || version != VERSION || stored != config) {
+            cerr << "[FeatureCache] " << packPath << " belongs to another config, cache disabled" << endl;
+            return false;
+        }
+    }
+
+    pack.open(packPath, ios::in | ios::out | ios::binary);
+    if (!pack.is_open()) {
+        cerr << "[FeatureCache] Cannot open " << packPath << endl;
+        return false;
+    }
+    packSize = dataStart;
+    if (!loadIndex(fileSize)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool FeatureCache::loadIndex(uint64_t fileSize) {
+    index.clear();
+    uint64_t pos = packSize;
+    while (pos + RECORD_HEADER_BYTES <= fileSize) {
+        Key key;
+        uint32_t count;
+        pack.seekg(pos);
+        pack.read(reinterpret_cast<char*>(&key.hash), sizeof(key.hash));
+        pack.read(reinterpret_cast<char*>(&key.size), sizeof(key.size));
+        pack.read(reinterpret_cast<char*>(&count), sizeof(count));
+        if (!pack) break;
+        uint64_t end = pos + RECORD_HEADER_BYTES + uint64_t(count) * sizeof(float);
+        if (end > fileSize) break;
+        index[key] = Location{pos + RECORD_HEADER_BYTES, count};
+        pos = end;
+    }
+    pack.clear();
+
+    // Bỏ bản ghi ghi dở ở cuối (chương trình bị ngắt khi đang ghi)
+    if (pos < fileSize) {
+        pack.close();
+        error_code ec;
+        fs::resize_file(packPath, pos, ec);
+        if (ec) return false;
+        pack.open(packPath, ios::in | ios::out | ios::binary);
+        if (!pack.is_open()) return false;
+    }
+    packSize = pos;
+    return true;
+}
+
+void FeatureCache::close() {
+    lock_guard<mutex> lock(cacheMutex);
+    if (pack.is_open()) pack.close();
+    index.clear();
+    packSize = 0;
+    hitCount = 0;
+}
+
+bool FeatureCache::lookup(uint64_t contentHash, uint64_t size, vector<float>& features) {
+    lock_guard<mutex> lock(cacheMutex);
+    if (!pack.is_open()) return false;
+    auto it = index.find(Key{contentHash, size});
+    if (it == index.end()) return false;
+    features.resize(it->second.count);
+    pack.seekg(it->second.offset);
+    if (!pack.read(reinterpret_cast<char*>(features.data()), features.size() * sizeof(float))) {
+        pack.clear();
+        features.clear();
+        return false;
+    }
+    hitCount++;
+    return true;
+}
+
+void FeatureCache::insert(uint64_t contentHash, uint64_t size, const vector<float>& features) {
+    lock_guard<mutex> lock(cacheMutex);
+    if (!pack.is_open() || features.empty()) return;
+    Key key{contentHash, size};
+    if (index.count(key)) return;
+
+    uint32_t count = static_cast<uint32_t>(features.size());
+    pack.seekp(packSize);
+    pack.write(reinterpret_cast<const char*>(&key.hash), sizeof(key.hash));
+    pack.write(reinterpret_cast<const char*>(&key.size), sizeof(key.size));
+    pack.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    pack.write(reinterpret_cast<const char*>(features.data()), count * sizeof(float));
+    if (!pack.good()) {
+        // Cache chỉ là tối ưu hóa: lỗi ghi thì tắt cache, không làm hỏng việc build
+        cerr << "[FeatureCache] Write failed, cache disabled: " << packPath << endl;
+        pack.close();
+        return;
+    }
+    index[key] = Location{packSize + RECORD_HEADER_BYTES, count};
+    packSize += RECORD_HEADER_BYTES + uint64_t(count) * sizeof(float);
+}
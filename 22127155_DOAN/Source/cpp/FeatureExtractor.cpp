@@ -1,16 +1,34 @@
 #include "FeatureExtractor.h"
 #include <sstream>
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <limits>
 
 using namespace std;
 using namespace cv;
 
+// Default raw comparison: wrap both rows into vectors and reuse compare()
+double FeatureExtractor::compareRaw(const float* feat1, const float* feat2, size_t dim) const {
+    return compare(vector<float>(feat1, feat1 + dim), vector<float>(feat2, feat2 + dim));
+}
+
 // Extract features from the image
 string FeatureExtractor::featuresToString(const vector<float>& features) {
     ostringstream oss;
+    oss << setprecision(numeric_limits<float>::max_digits10);
     for (size_t i = 0; i < features.size(); ++i) {
         if (i != 0) oss << ",";
-        oss << features[i];
+        // Hàng đóng gói (ORB...) chứa byte thô: NaN, inf, subnormal được ghi nguyên bit dạng #hex
+        if (!std::isnormal(features[i]) && features[i] != 0.0f) {
+            uint32_t bits;
+            memcpy(&bits, &features[i], sizeof(bits));
+            oss << '#' << hex << setw(8) << setfill('0') << bits << dec;
+        } else {
+            oss << features[i];
+        }
     }
     return oss.str();
 }
@@ -22,7 +40,14 @@ vector<float> FeatureExtractor::stringToFeatures(const string& featureStr) {
     string item;
     
     while (getline(ss, item, ',')) {
-        features.push_back(stof(item));
+        if (!item.empty() && item[0] == '#') {
+            uint32_t bits = static_cast<uint32_t>(stoul(item.substr(1), nullptr, 16));
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            features.push_back(value);
+        } else {
+            features.push_back(stof(item));
+        }
     }
     
     return features;
@@ -0,0 +1,104 @@
+#include "FeatureMatrix.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+using namespace std;
+
+FeatureMatrix::~FeatureMatrix() {
+    release();
+}
+
+FeatureMatrix::FeatureMatrix(FeatureMatrix&& other) noexcept {
+    *this = std::move(other);
+}
+
+FeatureMatrix& FeatureMatrix::operator=(FeatureMatrix&& other) noexcept {
+    if (this != &other) {
+        release();
+        buffer = other.buffer;
+        view = other.view;
+        stride = other.stride;
+        rowCount = other.rowCount;
+        capacity = other.capacity;
+        other.buffer = nullptr;
+        other.view = nullptr;
+        other.stride = other.rowCount = other.capacity = 0;
+    }
+    return *this;
+}
+
+void FeatureMatrix::release() {
+    if (buffer) ::operator delete[](buffer, align_val_t(ALIGNMENT));
+    buffer = nullptr;
+    view = nullptr;
+    rowCount = 0;
+    capacity = 0;
+}
+
+void FeatureMatrix::reset(size_t dimension) {
+    release();
+    stride = dimension;
+}
+
+void FeatureMatrix::reserve(size_t rows) {
+    if (view || rows <= capacity || stride == 0) return;
+    float* grown = static_cast<float*>(::operator new[](rows * stride * sizeof(float), align_val_t(ALIGNMENT)));
+    if (buffer) {
+        memcpy(grown, buffer, rowCount * stride * sizeof(float));
+        ::operator delete[](buffer, align_val_t(ALIGNMENT));
+    }
+    buffer = grown;
+    capacity = rows;
+}
+
+void FeatureMatrix::resize(size_t rows) {
+    reserve(rows);
+    rowCount = rows;
+}
+
+size_t FeatureMatrix::append(const float* features) {
+    if (rowCount == capacity) {
+        reserve(max<size_t>(64, capacity * 2));
+    }
+    memcpy(buffer + rowCount * stride, features, stride * sizeof(float));
+    return rowCount++;
+}
+
+void FeatureMatrix::setView(const float* data, size_t rows, size_t dimension) {
+    release();
+    view = data;
+    stride = dimension;
+    rowCount = rows;
+}
+
+uint32_t PathCatalog::intern(const string& path) {
+    uint32_t id;
+    if (find(path, id)) return id;
+    id = static_cast<uint32_t>(paths.size());
+    paths.push_back(path);
+    ids.emplace(string_view(paths.back()), id);
+    return id;
+}
+
+bool PathCatalog::find(const string& path, uint32_t& id) const {
+    auto it = ids.find(string_view(path));
+    if (it == ids.end()) return false;
+    id = it->second;
+    return true;
+}
+
+void PathCatalog::clear() {
+    ids.clear();
+    paths.clear();
+}
+
+void PathCatalog::assign(vector<string>&& list) {
+    clear();
+    ids.reserve(list.size());
+    for (auto& path : list) {
+        paths.push_back(std::move(path));
+        ids.emplace(string_view(paths.back()), static_cast<uint32_t>(paths.size() - 1));
+    }
+    list.clear();
+}
@@ -0,0 +1,448 @@
+#include "FeatureStore.h"
+#include "DistanceKernels.h"
+#include "FileSync.h"
+#include <cstring>
+#include <filesystem>
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+static const char FEATURE_STORE_MAGIC[8] = {'C', 'B', 'I', 'R', 'F', 'D', 'B', '\0'};
+
+void ColumnStats::reset(size_t dimension) {
+    sums.assign(dimension, 0.0);
+    squares.assign(dimension, 0.0);
+    rows = 0;
+}
+
+void ColumnStats::add(const float* row) {
+    for (size_t j = 0; j < sums.size(); ++j) {
+        sums[j] += row[j];
+        squares[j] += double(row[j]) * row[j];
+    }
+    ++rows;
+}
+
+double ColumnStats::variance(size_t column) const {
+    if (rows == 0) return 0.0;
+    double mean = sums[column] / rows;
+    return squares[column] / rows - mean * mean;
+}
+
+bool FeatureStore::isFeatureStore(const string& filePath) {
+    ifstream in(filePath, ios::binary);
+    char magic[8] = {};
+    if (!in.read(magic, sizeof(magic))) return false;
+    return memcmp(magic, FEATURE_STORE_MAGIC, sizeof(magic)) == 0;
+}
+
+bool FeatureStore::readHeader(ifstream& in, FeatureStoreHeader& header, string& config) {
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+    if (memcmp(header.magic, FEATURE_STORE_MAGIC, sizeof(header.magic)) != 0) {
+        cerr << "[FeatureStore] Bad magic, not a feature store" << endl;
+        return false;
+    }
+    // Version 1: chưa có khối norm (normsOffset == 0)
+    if (header.version == 0 || header.version > VERSION) {
+        cerr << "[FeatureStore] Unsupported version " << header.version << endl;
+        return false;
+    }
+    if (header.version < 2) header.normsOffset = 0;
+
+    // Kích thước file thật: header lấy từ file cũ / hỏng không được khiến ta đọc hay map ngoài file
+    const streampos start = in.tellg();
+    in.seekg(0, ios::end);
+    const uint64_t fileSize = static_cast<uint64_t>(in.tellg());
+    in.seekg(start);
+    if (!validLayout(header, fileSize)) {
+        cerr << "[FeatureStore] Header does not match the file size (" << fileSize << " bytes)" << endl;
+        return false;
+    }
+    config.resize(header.configLength);
+    if (header.configLength > 0 && !in.read(&config[0], header.configLength)) return false;
+    return true;
+}
+
+bool FeatureStore::validLayout(const FeatureStoreHeader& header, uint64_t fileSize) {
+    // Mỗi vùng [offset, offset + size) phải nằm trong file; so sánh theo kiểu không tràn số
+    auto fits = [fileSize](uint64_t offset, uint64_t size) {
+        return offset <= fileSize && size <= fileSize - offset;
+    };
+    if (!fits(0, sizeof(FeatureStoreHeader) + uint64_t(header.configLength)) ||
+        header.matrixOffset < sizeof(FeatureStoreHeader) + uint64_t(header.configLength)) {
+        return false;
+    }
+    const uint64_t rowBytes = uint64_t(header.dimension) * sizeof(float);
+    if (header.rowCount > 0 && (rowBytes == 0 || header.rowCount > fileSize / rowBytes)) return false;
+    const uint64_t matrixEnd = header.matrixOffset + header.rowCount * rowBytes;
+    if (!fits(header.matrixOffset, header.rowCount * rowBytes)) return false;
+    if (header.normsOffset != 0) {
+        uint64_t tail = header.rowCount * sizeof(float);
+        if (header.version >= 3) tail += 2 * uint64_t(header.dimension) * sizeof(double);
+        if (header.normsOffset < matrixEnd || !fits(header.normsOffset, tail)) return false;
+    }
+    return header.pathTableOffset >= matrixEnd && fits(header.pathTableOffset, header.pathTableSize);
+}
+
+bool FeatureStore::read(const string& filePath, FeatureStoreHeader& header, string& config,
+                        vector<string>& paths, FeatureMatrix& matrix, ColumnStats& stats) {
+    ifstream in(filePath, ios::binary);
+    if (!in.is_open()) {
+        cerr << "Error opening file for reading: " << filePath << endl;
+        return false;
+    }
+    if (!readHeader(in, header, config)) return false;
+
+    // Ma trận đặc trưng: một lần đọc duy nhất
+    matrix.reset(header.dimension);
+    matrix.resize(header.rowCount);
+    in.seekg(header.matrixOffset);
+    if (!matrix.empty() && !in.read(reinterpret_cast<char*>(matrix.mutableData()), header.rowCount * header.dimension * sizeof(float))) {
+        cerr << "[FeatureStore] Truncated feature matrix in " << filePath << endl;
+        return false;
+    }
+
+    stats.reset(header.dimension);
+    if (header.version >= 3 && !readColumnStats(in, header, stats)) {
+        cerr << "[FeatureStore] Truncated column statistics in " << filePath << endl;
+        return false;
+    }
+
+    // Bảng đường dẫn
+    string table(header.pathTableSize, '\0');
+    in.seekg(header.pathTableOffset);
+    if (!table.empty() && !in.read(&table[0], table.size())) {
+        cerr << "[FeatureStore] Truncated path table in " << filePath << endl;
+        return false;
+    }
+    return parsePathTable(table.data(), table.size(), header.rowCount, paths);
+}
+
+bool FeatureStore::readColumnStats(ifstream& in, const FeatureStoreHeader& header, ColumnStats& stats) {
+    stats.reset(header.dimension);
+    if (header.flags & PACKED_ROWS) return true;
+    if (header.version < 3 || header.normsOffset == 0) return false;
+    const size_t bytes = header.dimension * sizeof(double);
+    in.seekg(header.normsOffset + header.rowCount * sizeof(float));
+    if (bytes > 0 && (!in.read(reinterpret_cast<char*>(stats.sums.data()), bytes) ||
+                      !in.read(reinterpret_cast<char*>(stats.squares.data()), bytes))) {
+        stats.reset(header.dimension);
+        return false;
+    }
+    stats.rows = header.rowCount;
+    return true;
+}
+
+bool FeatureStore::parsePathTable(const char* table, size_t tableSize, uint64_t rowCount,
+                                  vector<string>& paths) {
+    paths.clear();
+    paths.reserve(rowCount);
+    size_t pos = 0;
+    for (uint64_t i = 0; i < rowCount; ++i) {
+        uint32_t len;
+        if (pos + sizeof(len) > tableSize) return false;
+        memcpy(&len, table + pos, sizeof(len));
+        pos += sizeof(len);
+        if (pos + len > tableSize) return false;
+        paths.emplace_back(table + pos, len);
+        pos += len;
+    }
+    return true;
+}
+
+FeatureStoreWriter::~FeatureStoreWriter() {
+    if (!out.is_open()) return;
+    if (targetPath.empty()) close();
+    else abandon();
+}
+
+void FeatureStoreWriter::abandon() {
+    out.close();
+    pathsOut.close();
+    normsOut.close();
+    std::error_code ec;
+    std::filesystem::remove(filePath, ec);
+    std::filesystem::remove(filePath + ".norms", ec);
+    std::filesystem::remove(filePath + ".paths", ec);
+}
+
+bool FeatureStoreWriter::open(const string& path, const string& config, size_t dimension, uint32_t flags) {
+    filePath = path;
+    targetPath.clear();
+    rowCount = 0;
+    std::filesystem::path parent = std::filesystem::path(filePath).parent_path();
+    if (!parent.empty()) std::filesystem::create_directories(parent);
+    out.open(filePath, ios::binary | ios::trunc);
+    pathsOut.open(filePath + ".paths", ios::binary | ios::trunc);
+    normsOut.open(filePath + ".norms", ios::binary | ios::trunc);
+    if (!out.is_open() || !pathsOut.is_open() || !normsOut.is_open()) {
+        cerr << "Error opening file for writing: " << filePath << endl;
+        out.close();
+        pathsOut.close();
+        normsOut.close();
+        return false;
+    }
+
+    header = FeatureStoreHeader{};
+    memcpy(header.magic, FEATURE_STORE_MAGIC, sizeof(header.magic));
+    header.version = FeatureStore::VERSION;
+    header.dimension = static_cast<uint32_t>(dimension);
+    header.configLength = static_cast<uint32_t>(config.size());
+    header.flags = flags;
+    header.matrixOffset = FeatureStore::alignUp(sizeof(FeatureStoreHeader) + config.size());
+    packed = (flags & FeatureStore::PACKED_ROWS) != 0;
+    stats.reset(dimension);
+
+    // Header tạm thời, sẽ được ghi lại khi close()
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(config.data(), config.size());
+    static const char zeros[FeatureStore::ALIGNMENT] = {};
+    out.write(zeros, header.matrixOffset - sizeof(header) - config.size());
+    return out.good();
+}
+
+bool FeatureStoreWriter::openAppend(const string& path, const string& config, size_t dimension) {
+    FeatureStoreHeader existing;
+    string existingConfig;
+    {
+        ifstream in(path, ios::binary);
+        if (!in.is_open() || !FeatureStore::readHeader(in, existing, existingConfig)) {
+            cerr << "Error opening file for appending: " << path << endl;
+            return false;
+        }
+        if (existingConfig != config || existing.dimension != dimension) {
+            cerr << "[FeatureStore] Cannot append to " << path << ": config or dimension mismatch" << endl;
+            return false;
+        }
+
+        // Header + ma trận hiện có sang <path>.tmp, norm và bảng đường dẫn sang file tạm
+        filePath = path + ".tmp";
+        targetPath = path;
+        out.open(filePath, ios::binary | ios::trunc);
+        pathsOut.open(filePath + ".paths", ios::binary | ios::trunc);
+        normsOut.open(filePath + ".norms", ios::binary | ios::trunc);
+        if (!out.is_open() || !pathsOut.is_open() || !normsOut.is_open()) {
+            cerr << "Error opening file for writing: " << filePath << endl;
+            abandon();
+            return false;
+        }
+        auto copyRange = [&in](ofstream& to, uint64_t offset, uint64_t size) {
+            in.seekg(offset);
+            vector<char> buffer(1 << 20);
+            for (uint64_t left = size; left > 0;) {
+                size_t chunk = static_cast<size_t>(min<uint64_t>(left, buffer.size()));
+                if (!in.read(buffer.data(), chunk)) return false;
+                to.write(buffer.data(), chunk);
+                left -= chunk;
+            }
+            return true;
+        };
+        const uint64_t matrixEnd = existing.matrixOffset + existing.rowCount * existing.dimension * sizeof(float);
+        bool ok = copyRange(out, 0, matrixEnd);
+        ok = ok && copyRange(pathsOut, existing.pathTableOffset, existing.pathTableSize);
+        const bool hasNorms = existing.normsOffset != 0;
+        packed = (existing.flags & FeatureStore::PACKED_ROWS) != 0;
+        if (ok && hasNorms) {
+            ok = copyRange(normsOut, existing.normsOffset, existing.rowCount * sizeof(float));
+        }
+        const bool hasStats = ok && FeatureStore::readColumnStats(in, existing, stats);
+        if (ok && packed && !hasNorms) {
+            // Descriptor đóng gói: norm chỉ giữ chỗ
+            const float zero = 0.0f;
+            for (uint64_t r = 0; r < existing.rowCount; ++r) {
+                normsOut.write(reinterpret_cast<const char*>(&zero), sizeof(zero));
+            }
+        } else if (ok && (!hasNorms || !hasStats)) {
+            // File version 1-2: tính norm và/hoặc thống kê cột từ ma trận hiện có (một lần)
+            stats.reset(existing.dimension);
+            vector<float> row(existing.dimension);
+            in.clear();
+            in.seekg(existing.matrixOffset);
+            for (uint64_t r = 0; ok && r < existing.rowCount; ++r) {
+                ok = static_cast<bool>(in.read(reinterpret_cast<char*>(row.data()), row.size() * sizeof(float)));
+                stats.add(row.data());
+                if (hasNorms) continue;
+                float norm = DistanceKernels::squaredNorm(row.data(), row.size());
+                normsOut.write(reinterpret_cast<const char*>(&norm), sizeof(norm));
+            }
+        }
+        if (!ok) {
+            cerr << "[FeatureStore] Cannot copy " << path << " for appending" << endl;
+            abandon();
+            return false;
+        }
+    }
+
+    // Hàng mới được ghi ngay sau hàng cuối của ma trận trong bản sao
+    header = existing;
+    header.version = FeatureStore::VERSION;
+    rowCount = existing.rowCount;
+    return out.good() && pathsOut.good() && normsOut.good();
+}
+
+bool FeatureStoreWriter::append(const string& path, const float* features) {
+    out.write(reinterpret_cast<const char*>(features), header.dimension * sizeof(float));
+    float norm = packed ? 0.0f : DistanceKernels::squaredNorm(features, header.dimension);
+    normsOut.write(reinterpret_cast<const char*>(&norm), sizeof(norm));
+    if (!packed) stats.add(features);
+    uint32_t len = static_cast<uint32_t>(path.size());
+    pathsOut.write(reinterpret_cast<const char*>(&len), sizeof(len));
+    pathsOut.write(path.data(), len);
+    header.pathTableSize += sizeof(len) + len;
+    ++rowCount;
+    return out.good() && pathsOut.good() && normsOut.good();
+}
+
+bool FeatureStoreWriter::close() {
+    if (!out.is_open()) return false;
+
+    header.rowCount = rowCount;
+    header.normsOffset = header.matrixOffset + header.rowCount * header.dimension * sizeof(float);
+    const size_t statsBytes = header.dimension * sizeof(double);
+    header.pathTableOffset = header.normsOffset + header.rowCount * sizeof(float) + 2 * statsBytes;
+
+    // Nối norm, thống kê cột và bảng đường dẫn tạm vào cuối file
+    normsOut.close();
+    pathsOut.close();
+    {
+        ifstream normsIn(filePath + ".norms", ios::binary);
+        if (header.rowCount > 0) out << normsIn.rdbuf();
+        out.write(reinterpret_cast<const char*>(stats.sums.data()), statsBytes);
+        out.write(reinterpret_cast<const char*>(stats.squares.data()), statsBytes);
+        ifstream pathsIn(filePath + ".paths", ios::binary);
+        if (header.pathTableSize > 0) out << pathsIn.rdbuf();
+    }
+    std::error_code ec;
+    std::filesystem::remove(filePath + ".norms", ec);
+    std::filesystem::remove(filePath + ".paths", ec);
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    bool ok = out.good();
+    out.close();
+    if (!ok) {
+        cerr << "[FeatureStore] Failed writing " << filePath << endl;
+        if (!targetPath.empty()) std::filesystem::remove(filePath, ec);
+        return false;
+    }
+    if (!targetPath.empty()) {
+        // Chỉ lúc này file gốc mới bị thay, bằng một file đã hoàn chỉnh và đã nằm trên đĩa
+        if (!FileSync::syncPath(filePath)) {
+            cerr << "[FeatureStore] Cannot sync " << filePath << endl;
+            std::filesystem::remove(filePath, ec);
+            return false;
+        }
+        const string dir = FileSync::parentDirectory(targetPath);
+        FileSync::syncDirectory(dir);
+        std::filesystem::rename(filePath, targetPath, ec);
+        if (ec) {
+            cerr << "[FeatureStore] Cannot move " << filePath << " to " << targetPath << ": " << ec.message() << endl;
+            std::filesystem::remove(filePath, ec);
+            return false;
+        }
+        FileSync::syncDirectory(dir);
+    }
+    return true;
+}
+
+bool FeatureStoreView::open(const string& path, vector<string>& paths, bool streaming) {
+    close();
+    ifstream in(path, ios::binary);
+    if (!in.is_open()) {
+        cerr << "Error opening file for reading: " << path << endl;
+        return false;
+    }
+    if (!FeatureStore::readHeader(in, header, configString)) {
+        close(); // không giữ lại header của một file bị từ chối
+        return false;
+    }
+
+    string table(header.pathTableSize, '\0');
+    in.seekg(header.pathTableOffset);
+    if (!table.empty() && !in.read(&table[0], table.size())) return false;
+    if (!FeatureStore::parsePathTable(table.data(), table.size(), header.rowCount, paths)) return false;
+    if (header.normsOffset != 0 && !(header.flags & FeatureStore::PACKED_ROWS)) {
+        rowNorms.resize(header.rowCount);
+        in.seekg(header.normsOffset);
+        if (!rowNorms.empty() && !in.read(reinterpret_cast<char*>(rowNorms.data()), rowNorms.size() * sizeof(float))) {
+            cerr << "[FeatureStore] Truncated norms in " << path << endl;
+            rowNorms.clear();
+            return false;
+        }
+    }
+    if (header.version >= 3 && !FeatureStore::readColumnStats(in, header, stats)) {
+        cerr << "[FeatureStore] Truncated column statistics in " << path << endl;
+        rowNorms.clear();
+        return false;
+    }
+    filePath = path;
+    if (!streaming && !map()) {
+        if (!isOpen()) return false;
+        cerr << "[FeatureStore] Mapping failed, falling back to streaming scans for " << path << endl;
+    }
+    return true;
+}
+
+bool FeatureStoreView::map() {
+    if (isMapped()) return true;
+    if (!isOpen() || !file.open(filePath)) return false;
+    uint64_t matrixBytes = header.rowCount * header.dimension * sizeof(float);
+    if (file.size() < header.matrixOffset + matrixBytes) {
+        cerr << "[FeatureStore] Truncated feature matrix in " << filePath << endl;
+        close();
+        return false;
+    }
+    file.advise(header.matrixOffset, matrixBytes, MappedFile::Sequential);
+    size_t ram = MappedFile::physicalMemory();
+    dropBehind = ram > 0 && matrixBytes > ram / 2;
+    return true;
+}
+
+void FeatureStoreView::unmap() {
+    file.close();
+    dropBehind = false;
+}
+
+void FeatureStoreView::close() {
+    file.close();
+    filePath.clear();
+    configString.clear();
+    header = FeatureStoreHeader{};
+    rowNorms.clear();
+    rowNorms.shrink_to_fit();
+    stats = ColumnStats{};
+    blockBuffer.clear();
+    blockBuffer.shrink_to_fit();
+}
+
+void FeatureStoreView::scanBlocks(const BlockFn& fn, size_t blockBytes) const {
+    const size_t rowBytes = header.dimension * sizeof(float);
+    if (header.rowCount == 0 || rowBytes == 0) return;
+    const size_t rowsPerBlock = max<size_t>(1, blockBytes / rowBytes);
+
+    if (isMapped()) {
+        for (size_t first = 0; first < header.rowCount; first += rowsPerBlock) {
+            size_t count = min<size_t>(rowsPerBlock, header.rowCount - first);
+            size_t offset = header.matrixOffset + first * rowBytes;
+            // Đọc trước khối kế tiếp trong khi xử lý khối hiện tại
+            file.advise(offset + count * rowBytes, rowsPerBlock * rowBytes, MappedFile::WillNeed);
+            fn(first, count, matrixData() + first * header.dimension);
+            if (dropBehind) file.advise(offset, count * rowBytes, MappedFile::DontNeed);
+        }
+        return;
+    }
+
+    // Streaming: đọc tuần tự vào một buffer dùng lại, không bao giờ giữ toàn bộ ma trận
+    ifstream in(filePath, ios::binary);
+    in.seekg(header.matrixOffset);
+    blockBuffer.resize(rowsPerBlock * header.dimension);
+    for (size_t first = 0; first < header.rowCount; first += rowsPerBlock) {
+        size_t count = min<size_t>(rowsPerBlock, header.rowCount - first);
+        if (!in.read(reinterpret_cast<char*>(blockBuffer.data()), count * rowBytes)) {
+            cerr << "[FeatureStore] Read error while scanning " << filePath << endl;
+            return;
+        }
+        fn(first, count, blockBuffer.data());
+    }
+}
@@ -0,0 +1,53 @@
+#include "FileSync.h"
+#include <filesystem>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+bool FileSync::syncFile(FILE* file) {
+    if (fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+bool FileSync::syncPath(const string& filePath) {
+#ifdef _WIN32
+    int fd = _open(filePath.c_str(), _O_RDWR | _O_BINARY);
+    if (fd < 0) return false;
+    bool ok = _commit(fd) == 0;
+    _close(fd);
+#else
+    int fd = ::open(filePath.c_str(), O_RDWR);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    ::close(fd);
+#endif
+    return ok;
+}
+
+void FileSync::syncDirectory(const string& dir) {
+#ifndef _WIN32
+    int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        ::close(fd);
+    }
+#else
+    (void)dir;
+#endif
+}
+
+string FileSync::parentDirectory(const string& filePath) {
+    string parent = std::filesystem::path(filePath).parent_path().string();
+    return parent.empty() ? "." : parent;
+}
@@ -0,0 +1,383 @@
+#include "HNSWIndex.h"
+#include "DistanceKernels.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+
+using namespace std;
+
+static const char HNSW_MAGIC[8] = {'C', 'B', 'I', 'R', 'H', 'N', 'S', 'W'};
+
+template <typename T>
+static bool readValue(ifstream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+template <typename T>
+static void writeValue(ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void HNSWIndex::VisitedList::reset(size_t nodes) {
+    if (marks.size() < nodes) {
+        marks.assign(nodes, 0);
+        epoch = 0;
+    }
+    if (++epoch == 0) {
+        fill(marks.begin(), marks.end(), uint16_t(0));
+        epoch = 1;
+    }
+}
+
+HNSWIndex::HNSWIndex() : locks(new std::mutex[LOCK_STRIPES]) {}
+
+void HNSWIndex::clear() {
+    dim = 0;
+    maxLinks0 = 0;
+    vectors = nullptr;
+    levels.clear();
+    links0.clear();
+    upperLinks.clear();
+    entryPoint = NO_NODE;
+    maxLevel = -1;
+    visited.clear();
+}
+
+float HNSWIndex::distance(const float* query, uint32_t node) const {
+    return DistanceKernels::squaredL2Kernel()(query, row(node), dim);
+}
+
+uint32_t* HNSWIndex::links(uint32_t node, int layer) {
+    if (layer == 0) return links0.data() + size_t(node) * (maxLinks0 + 1);
+    return upperLinks[node].data() + size_t(layer - 1) * (config.M + 1);
+}
+
+const uint32_t* HNSWIndex::links(uint32_t node, int layer) const {
+    return const_cast<HNSWIndex*>(this)->links(node, layer);
+}
+
+int HNSWIndex::randomLevel(uint32_t node) const {
+    // splitmix64 của id: tầng của mỗi node không phụ thuộc thứ tự chèn hay số luồng
+    uint64_t x = node + 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    double u = (static_cast<double>(x >> 11) + 1.0) / 9007199254740992.0; // (0, 1]
+    int level = static_cast<int>(-log(u) / log(static_cast<double>(max<size_t>(config.M, 2))));
+    return min(level, MAX_LEVEL);
+}
+
+void HNSWIndex::allocate(size_t first, size_t rows) {
+    levels.resize(rows);
+    links0.resize(rows * (maxLinks0 + 1), 0);
+    upperLinks.resize(rows);
+    for (size_t node = first; node < rows; ++node) {
+        levels[node] = static_cast<uint8_t>(randomLevel(static_cast<uint32_t>(node)));
+        upperLinks[node].assign(levels[node] * (config.M + 1), 0);
+    }
+}
+
+bool HNSWIndex::build(const float* data, size_t rows, size_t dimension, const Params& params) {
+    clear();
+    if (!data || rows == 0 || dimension == 0 || params.M < 2) return false;
+    config = params;
+    config.efConstruction = max(config.efConstruction, config.M);
+    dim = dimension;
+    maxLinks0 = 2 * config.M;
+    return extend(data, rows);
+}
+
+bool HNSWIndex::extend(const float* data, size_t rows) {
+    vectors = data;
+    const size_t first = levels.size();
+    if (rows <= first) return true;
+    if (dim == 0 || maxLinks0 == 0) return false;
+    allocate(first, rows);
+
+    if (entryPoint == NO_NODE) {
+        entryPoint = static_cast<uint32_t>(first);
+        maxLevel = levels[first];
+        insertRange(first + 1, rows);
+    } else {
+        insertRange(first, rows);
+    }
+    return true;
+}
+
+void HNSWIndex::insertRange(size_t first, size_t last) {
+    if (first >= last) return;
+    ThreadPool& pool = ThreadPool::shared();
+    visited.resize(max<size_t>(pool.size(), 1));
+    pool.parallelFor(first, last, [this](size_t node, size_t worker) {
+        insert(static_cast<uint32_t>(node), worker);
+    }, 16);
+}
+
+uint32_t HNSWIndex::greedyDescend(const float* query, uint32_t entry, int fromLayer, int toLayer, bool locked) const {
+    uint32_t current = entry;
+    float currentDistance = distance(query, current);
+    vector<uint32_t> neighbours;
+    for (int layer = fromLayer; layer > toLayer; --layer) {
+        for (bool changed = true; changed;) {
+            changed = false;
+            const uint32_t* list = links(current, layer);
+            if (locked) {
+                lock_guard<mutex> guard(nodeLock(current));
+                neighbours.assign(list + 1, list + 1 + list[0]);
+            } else {
+                neighbours.assign(list + 1, list + 1 + list[0]);
+            }
+            for (uint32_t node : neighbours) {
+                float d = distance(query, node);
+                if (d < currentDistance) {
+                    currentDistance = d;
+                    current = node;
+                    changed = true;
+                }
+            }
+        }
+    }
+    return current;
+}
+
+vector<HNSWIndex::Candidate> HNSWIndex::searchLayer(const float* query, uint32_t entry, size_t ef, int layer,
+                                                    size_t worker, bool locked, const uint8_t* dead) const {
+    VisitedList& seen = visited[worker];
+    seen.reset(levels.size());
+
+    // candidates: min-heap (gần nhất ở đầu), results: max-heap giữ ef node tốt nhất còn sống
+    vector<Candidate> candidates, results;
+    auto closer = greater<Candidate>();
+    float d = distance(query, entry);
+    seen.visit(entry);
+    candidates.emplace_back(d, entry);
+    if (!dead || !dead[entry]) results.emplace_back(d, entry);
+    float bound = results.empty() ? numeric_limits<float>::infinity() : d;
+
+    vector<uint32_t> neighbours;
+    while (!candidates.empty()) {
+        Candidate current = candidates.front();
+        if (current.first > bound && results.size() >= ef) break;
+        pop_heap(candidates.begin(), candidates.end(), closer);
+        candidates.pop_back();
+
+        const uint32_t* list = links(current.second, layer);
+        if (locked) {
+            lock_guard<mutex> guard(nodeLock(current.second));
+            neighbours.assign(list + 1, list + 1 + list[0]);
+        } else {
+            neighbours.assign(list + 1, list + 1 + list[0]);
+        }
+        for (uint32_t node : neighbours) {
+            if (!seen.visit(node)) continue;
+            float nd = distance(query, node);
+            if (results.size() >= ef && nd >= bound) continue;
+            candidates.emplace_back(nd, node);
+            push_heap(candidates.begin(), candidates.end(), closer);
+            if (dead && dead[node]) continue;
+            results.emplace_back(nd, node);
+            push_heap(results.begin(), results.end());
+            if (results.size() > ef) {
+                pop_heap(results.begin(), results.end());
+                results.pop_back();
+            }
+            bound = results.size() >= ef ? results.front().first : numeric_limits<float>::infinity();
+        }
+    }
+    return results;
+}
+
+void HNSWIndex::selectNeighbours(vector<Candidate>& sorted, size_t maxCount) const {
+    if (sorted.size() <= maxCount) return;
+    vector<Candidate> chosen;
+    chosen.reserve(maxCount);
+    for (const auto& candidate : sorted) {
+        if (chosen.size() >= maxCount) break;
+        bool diverse = true;
+        for (const auto& kept : chosen) {
+            if (distance(row(candidate.second), kept.second) < candidate.first) {
+                diverse = false;
+                break;
+            }
+        }
+        if (diverse) chosen.push_back(candidate);
+    }
+    sorted.swap(chosen);
+}
+
+void HNSWIndex::connect(uint32_t node, const vector<Candidate>& neighbours, int layer) {
+    const size_t capacity = layer == 0 ? maxLinks0 : config.M;
+    {
+        lock_guard<mutex> guard(nodeLock(node));
+        uint32_t* list = links(node, layer);
+        list[0] = static_cast<uint32_t>(neighbours.size());
+        for (size_t i = 0; i < neighbours.size(); ++i) list[1 + i] = neighbours[i].second;
+    }
+    // Cạnh ngược; danh sách đầy thì chọn lại bằng heuristic trên các cạnh cũ + node mới
+    vector<Candidate> pool;
+    for (const auto& neighbour : neighbours) {
+        lock_guard<mutex> guard(nodeLock(neighbour.second));
+        uint32_t* list = links(neighbour.second, layer);
+        if (list[0] < capacity) {
+            list[1 + list[0]] = node;
+            list[0]++;
+            continue;
+        }
+        pool.assign(1, Candidate(neighbour.first, node));
+        for (uint32_t i = 0; i < list[0]; ++i) {
+            pool.emplace_back(distance(row(neighbour.second), list[1 + i]), list[1 + i]);
+        }
+        sort(pool.begin(), pool.end());
+        selectNeighbours(pool, capacity);
+        list[0] = static_cast<uint32_t>(pool.size());
+        for (size_t i = 0; i < pool.size(); ++i) list[1 + i] = pool[i].second;
+    }
+}
+
+void HNSWIndex::insert(uint32_t node, size_t worker) {
+    const int level = levels[node];
+    // Node có thể trở thành entry point mới: giữ khóa suốt lần chèn (hiếm, xác suất M^-level)
+    unique_lock<mutex> entryGuard(entryLock);
+    const int top = maxLevel;
+    uint32_t entry = entryPoint;
+    if (level <= top) entryGuard.unlock();
+
+    const float* query = row(node);
+    entry = greedyDescend(query, entry, top, level, true);
+    for (int layer = min(level, top); layer >= 0; --layer) {
+        vector<Candidate> found = searchLayer(query, entry, config.efConstruction, layer, worker, true, nullptr);
+        sort(found.begin(), found.end());
+        found.erase(remove_if(found.begin(), found.end(), [node](const Candidate& c) { return c.second == node; }),
+                    found.end());
+        if (found.empty()) continue;
+        entry = found.front().second;
+        selectNeighbours(found, config.M);
+        connect(node, found, layer);
+    }
+    if (level > top) {
+        entryPoint = node;
+        maxLevel = level;
+    }
+}
+
+void HNSWIndex::search(const float* query, size_t k, const uint8_t* dead, TopK& best) const {
+    if (empty() || k == 0) return;
+    if (visited.empty()) visited.resize(1);
+    uint32_t entry = greedyDescend(query, entryPoint, maxLevel, 0, false);
+    vector<Candidate> found = searchLayer(query, entry, max(efSearch, k), 0, 0, false, dead);
+    for (const auto& candidate : found) {
+        best.push(std::sqrt(static_cast<double>(candidate.first)), candidate.second);
+    }
+}
+
+bool HNSWIndex::save(const string& filePath, uint64_t pathsHash) const {
+    string tmpPath = filePath + ".tmp";
+    {
+        ofstream out(tmpPath, ios::binary | ios::trunc);
+        if (!out.is_open()) {
+            cerr << "Error opening file for writing: " << tmpPath << endl;
+            return false;
+        }
+        out.write(HNSW_MAGIC, sizeof(HNSW_MAGIC));
+        writeValue(out, VERSION);
+        writeValue(out, static_cast<uint32_t>(dim));
+        writeValue(out, static_cast<uint64_t>(levels.size()));
+        writeValue(out, static_cast<uint32_t>(config.M));
+        writeValue(out, static_cast<uint32_t>(config.efConstruction));
+        writeValue(out, entryPoint);
+        writeValue(out, static_cast<int32_t>(maxLevel));
+        writeValue(out, pathsHash);
+        out.write(reinterpret_cast<const char*>(levels.data()), levels.size());
+        out.write(reinterpret_cast<const char*>(links0.data()), links0.size() * sizeof(uint32_t));
+        for (const auto& list : upperLinks) {
+            out.write(reinterpret_cast<const char*>(list.data()), list.size() * sizeof(uint32_t));
+        }
+        if (!out.good()) {
+            cerr << "[HNSWIndex] Failed writing " << tmpPath << endl;
+            return false;
+        }
+    }
+    error_code ec;
+    filesystem::rename(tmpPath, filePath, ec);
+    if (ec) {
+        cerr << "[HNSWIndex] Cannot move " << tmpPath << " to " << filePath << ": " << ec.message() << endl;
+        return false;
+    }
+    return true;
+}
+
+bool HNSWIndex::load(const string& filePath, size_t dimension, uint64_t& pathsHash) {
+    clear();
+    ifstream in(filePath, ios::binary);
+    if (!in.is_open()) return false;
+
+    char magic[8];
+    uint32_t version, fileDim, M, efConstruction, entry;
+    uint64_t rows;
+    int32_t top;
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, HNSW_MAGIC, sizeof(magic)) != 0 ||
+        !readValue(in, version) || version != VERSION || !readValue(in, fileDim) || !readValue(in, rows) ||
+        !readValue(in, M) || !readValue(in, efConstruction) || !readValue(in, entry) || !readValue(in, top) ||
+        !readValue(in, pathsHash)) {
+        cerr << "[HNSWIndex] Invalid index: " << filePath << endl;
+        return false;
+    }
+    if (fileDim != dimension || M < 2 || rows == 0 || entry >= rows || top < 0 || top > MAX_LEVEL) {
+        cerr << "[HNSWIndex] Index does not match the database: " << filePath << endl;
+        return false;
+    }
+
+    config.M = M;
+    config.efConstruction = efConstruction;
+    dim = fileDim;
+    maxLinks0 = 2 * size_t(M);
+    levels.resize(rows);
+    links0.resize(rows * (maxLinks0 + 1));
+    upperLinks.resize(rows);
+    bool ok = in.read(reinterpret_cast<char*>(levels.data()), levels.size()) &&
+              in.read(reinterpret_cast<char*>(links0.data()), links0.size() * sizeof(uint32_t));
+    for (size_t node = 0; ok && node < rows; ++node) {
+        if (levels[node] > MAX_LEVEL) {
+            ok = false;
+            break;
+        }
+        upperLinks[node].resize(levels[node] * (config.M + 1));
+        ok = !upperLinks[node].empty() ? static_cast<bool>(in.read(reinterpret_cast<char*>(upperLinks[node].data()),
+                                                                   upperLinks[node].size() * sizeof(uint32_t)))
+                                       : true;
+    }
+    if (!ok) {
+        cerr << "[HNSWIndex] Truncated index: " << filePath << endl;
+        clear();
+        return false;
+    }
+    // File cũ hoặc hỏng: số link và id láng giềng phải hợp lệ, nếu không search sẽ đọc ngoài mảng
+    ok = levels[entry] == top;
+    auto validLinks = [rows](const uint32_t* list, size_t maxLinks) {
+        if (list[0] > maxLinks) return false;
+        for (uint32_t i = 1; i <= list[0]; ++i) {
+            if (list[i] >= rows) return false;
+        }
+        return true;
+    };
+    for (size_t node = 0; ok && node < rows; ++node) {
+        ok = levels[node] <= top && validLinks(&links0[node * (maxLinks0 + 1)], maxLinks0);
+        for (size_t layer = 0; ok && layer < levels[node]; ++layer) {
+            ok = validLinks(&upperLinks[node][layer * (config.M + 1)], config.M);
+        }
+    }
+    if (!ok) {
+        cerr << "[HNSWIndex] Corrupt links in index: " << filePath << endl;
+        clear();
+        return false;
+    }
+    entryPoint = entry;
+    maxLevel = top;
+    return true;
+}
@@ -0,0 +1,174 @@
+#include "IVFIndex.h"
+#include "DistanceKernels.h"
+#include "ThreadPool.h"
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+using namespace std;
+using namespace cv;
+
+static const char IVF_MAGIC[8] = {'C', 'B', 'I', 'R', 'I', 'V', 'F', '\0'};
+
+template <typename T>
+static bool readValue(ifstream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+template <typename T>
+static void writeValue(ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+size_t IVFIndex::defaultListCount(size_t rows) {
+    return max<size_t>(1, static_cast<size_t>(std::sqrt(static_cast<double>(rows))));
+}
+
+void IVFIndex::clear() {
+    dim = 0;
+    listCount = 0;
+    centroids.clear();
+    offsets.clear();
+    rowIds.clear();
+}
+
+bool IVFIndex::build(const float* data, size_t rows, size_t dimension, size_t lists) {
+    clear();
+    if (rows == 0 || dimension == 0 || lists == 0) return false;
+    lists = min(lists, rows);
+
+    // Mẫu huấn luyện: các hàng cách đều nhau (xác định, không phụ thuộc seed)
+    const size_t trainRows = min(rows, lists * TRAIN_ROWS_PER_LIST);
+    Mat samples(static_cast<int>(trainRows), static_cast<int>(dimension), CV_32F);
+    for (size_t i = 0; i < trainRows; ++i) {
+        const float* row = data + (i * rows / trainRows) * dimension;
+        memcpy(samples.ptr<float>(static_cast<int>(i)), row, dimension * sizeof(float));
+    }
+    Mat labels, centers;
+    setRNGSeed(0x1F5);
+    kmeans(samples, static_cast<int>(lists), labels,
+           TermCriteria(TermCriteria::COUNT + TermCriteria::EPS, KMEANS_ITERATIONS, 1e-4),
+           1, KMEANS_PP_CENTERS, centers);
+    if (centers.rows != static_cast<int>(lists) || centers.cols != static_cast<int>(dimension)) {
+        cerr << "[IVFIndex] k-means failed" << endl;
+        return false;
+    }
+    dim = dimension;
+    listCount = lists;
+    centroids.resize(lists * dimension);
+    for (size_t c = 0; c < lists; ++c) {
+        memcpy(centroids.data() + c * dimension, centers.ptr<float>(static_cast<int>(c)), dimension * sizeof(float));
+    }
+
+    // Gán mọi hàng vào cell gần nhất
+    vector<uint32_t> assignment(rows);
+    const DistanceKernels::SquaredL2Fn kernel = DistanceKernels::squaredL2Kernel();
+    ThreadPool::shared().parallelFor(0, rows, [&](size_t r, size_t) {
+        const float* row = data + r * dimension;
+        float best = numeric_limits<float>::infinity();
+        uint32_t bestCell = 0;
+        for (size_t c = 0; c < lists; ++c) {
+            float d = kernel(row, centroids.data() + c * dimension, dimension);
+            if (d < best) {
+                best = d;
+                bestCell = static_cast<uint32_t>(c);
+            }
+        }
+        assignment[r] = bestCell;
+    }, 256);
+
+    // Danh sách dạng CSR, các hàng trong một cell theo thứ tự tăng dần
+    offsets.assign(lists + 1, 0);
+    for (uint32_t cell : assignment) offsets[cell + 1]++;
+    for (size_t c = 0; c < lists; ++c) offsets[c + 1] += offsets[c];
+    rowIds.resize(rows);
+    vector<uint64_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (size_t r = 0; r < rows; ++r) rowIds[cursor[assignment[r]]++] = static_cast<uint32_t>(r);
+    return true;
+}
+
+void IVFIndex::probe(const float* query, size_t nprobe, vector<uint32_t>& cells) const {
+    nprobe = min(nprobe, listCount);
+    const DistanceKernels::SquaredL2Fn kernel = DistanceKernels::squaredL2Kernel();
+    ranked.resize(listCount);
+    for (size_t c = 0; c < listCount; ++c) {
+        ranked[c] = {kernel(query, centroids.data() + c * dim, dim), static_cast<uint32_t>(c)};
+    }
+    partial_sort(ranked.begin(), ranked.begin() + nprobe, ranked.end());
+    cells.resize(nprobe);
+    for (size_t i = 0; i < nprobe; ++i) cells[i] = ranked[i].second;
+}
+
+bool IVFIndex::save(const string& filePath, uint64_t sourceSize, int64_t sourceMtime) const {
+    string tmpPath = filePath + ".tmp";
+    {
+        ofstream out(tmpPath, ios::binary | ios::trunc);
+        if (!out.is_open()) {
+            cerr << "Error opening file for writing: " << tmpPath << endl;
+            return false;
+        }
+        out.write(IVF_MAGIC, sizeof(IVF_MAGIC));
+        writeValue(out, VERSION);
+        writeValue(out, static_cast<uint32_t>(dim));
+        writeValue(out, static_cast<uint64_t>(rowIds.size()));
+        writeValue(out, static_cast<uint32_t>(listCount));
+        writeValue(out, uint32_t(0));
+        writeValue(out, sourceSize);
+        writeValue(out, sourceMtime);
+        out.write(reinterpret_cast<const char*>(centroids.data()), centroids.size() * sizeof(float));
+        out.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+        out.write(reinterpret_cast<const char*>(rowIds.data()), rowIds.size() * sizeof(uint32_t));
+        if (!out.good()) {
+            cerr << "[IVFIndex] Failed writing " << tmpPath << endl;
+            return false;
+        }
+    }
+    error_code ec;
+    filesystem::rename(tmpPath, filePath, ec);
+    if (ec) {
+        cerr << "[IVFIndex] Cannot move " << tmpPath << " to " << filePath << ": " << ec.message() << endl;
+        return false;
+    }
+    return true;
+}
+
+bool IVFIndex::load(const string& filePath, size_t rows, size_t dimension, uint64_t sourceSize, int64_t sourceMtime) {
+    clear();
+    ifstream in(filePath, ios::binary);
+    if (!in.is_open()) return false;
+
+    char magic[8];
+    uint32_t version, fileDim, lists, reserved;
+    uint64_t fileRows, fileSize;
+    int64_t fileMtime;
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, IVF_MAGIC, sizeof(magic)) != 0 ||
+        !readValue(in, version) || version != VERSION || !readValue(in, fileDim) || !readValue(in, fileRows) ||
+        !readValue(in, lists) || !readValue(in, reserved) || !readValue(in, fileSize) || !readValue(in, fileMtime)) {
+        cerr << "[IVFIndex] Invalid index: " << filePath << endl;
+        return false;
+    }
+    // Index của một phiên bản .fdb khác: bỏ qua, sẽ được build lại
+    if (fileDim != dimension || fileRows != rows || fileSize != sourceSize || fileMtime != sourceMtime || lists == 0) {
+        return false;
+    }
+
+    centroids.resize(size_t(lists) * fileDim);
+    offsets.resize(size_t(lists) + 1);
+    rowIds.resize(fileRows);
+    if (!in.read(reinterpret_cast<char*>(centroids.data()), centroids.size() * sizeof(float)) ||
+        !in.read(reinterpret_cast<char*>(offsets.data()), offsets.size() * sizeof(uint64_t)) ||
+        !in.read(reinterpret_cast<char*>(rowIds.data()), rowIds.size() * sizeof(uint32_t)) ||
+        offsets.back() != fileRows) {
+        cerr << "[IVFIndex] Truncated index: " << filePath << endl;
+        clear();
+        return false;
+    }
+    dim = fileDim;
+    listCount = lists;
+    return true;
+}
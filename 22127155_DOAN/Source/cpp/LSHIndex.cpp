@@ -0,0 +1,131 @@
+#include "LSHIndex.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+using namespace std;
+
+LSHIndex::LSHIndex() : hammingFn(DistanceKernels::hammingKernel()) {}
+
+bool LSHIndex::setup(size_t descriptorBytes, const Params& params) {
+    clear();
+    const size_t bits = descriptorBytes * 8;
+    if (descriptorBytes == 0 || bits > 65536 || params.tables == 0 || params.keyBits == 0 ||
+        params.keyBits > MAX_KEY_BITS || params.keyBits > bits) {
+        return false;
+    }
+    bytes = descriptorBytes;
+    tableCount = params.tables;
+    keyBits = params.keyBits;
+    maxDistance = params.maxDistance;
+
+    // Mỗi bảng lấy keyBits bit khác nhau, chọn ngẫu nhiên độc lập giữa các bảng
+    vector<uint16_t> all(bits);
+    iota(all.begin(), all.end(), uint16_t(0));
+    bitPositions.resize(tableCount * keyBits);
+    for (size_t t = 0; t < tableCount; ++t) {
+        mt19937 rng(params.seed + static_cast<uint32_t>(t));
+        shuffle(all.begin(), all.end(), rng);
+        copy(all.begin(), all.begin() + keyBits, bitPositions.begin() + t * keyBits);
+    }
+    clearImages();
+    return true;
+}
+
+void LSHIndex::clearImages() {
+    imageCount = 0;
+    owners.clear();
+    entries.clear();
+    bucketOffsets.assign(tableCount * ((size_t(1) << keyBits) + 1), 0);
+}
+
+void LSHIndex::clear() {
+    bytes = 0;
+    tableCount = 0;
+    keyBits = 0;
+    bitPositions.clear();
+    clearImages();
+}
+
+uint32_t LSHIndex::hashKey(const uint8_t* descriptor, size_t table) const {
+    const uint16_t* positions = bitPositions.data() + table * keyBits;
+    uint32_t key = 0;
+    for (size_t b = 0; b < keyBits; ++b) {
+        key |= uint32_t((descriptor[positions[b] >> 3] >> (positions[b] & 7)) & 1u) << b;
+    }
+    return key;
+}
+
+void LSHIndex::append(const DescriptorStore& store) {
+    if (empty() || store.descriptorBytes() != bytes || store.images() <= imageCount) return;
+    const size_t total = store.size();
+    if (store.offset(imageCount) != owners.size()) return; // store không phải store đã được index
+
+    owners.resize(total);
+    for (size_t i = imageCount; i < store.images(); ++i) {
+        fill(owners.begin() + store.offset(i), owners.begin() + store.offset(i) + store.count(i), static_cast<uint32_t>(i));
+    }
+    imageCount = store.images();
+    rebuildBuckets(store);
+}
+
+void LSHIndex::rebuildBuckets(const DescriptorStore& store) {
+    const size_t buckets = size_t(1) << keyBits, n = owners.size();
+    entries.resize(tableCount * n);
+    // Sắp xếp đếm theo key, mỗi bảng độc lập; trong một bucket các descriptor theo thứ tự tăng dần.
+    // Key được băm lại ở cả hai lượt (vài chục phép bit) thay vì giữ descriptor x tables key.
+    ThreadPool::shared().parallelFor(0, tableCount, [&](size_t t, size_t) {
+        uint32_t* offsets = bucketOffsets.data() + t * (buckets + 1);
+        fill(offsets, offsets + buckets + 1, 0u);
+        for (size_t d = 0; d < n; ++d) offsets[hashKey(store.descriptor(d), t) + 1]++;
+        for (size_t b = 0; b < buckets; ++b) offsets[b + 1] += offsets[b];
+        vector<uint32_t> cursor(offsets, offsets + buckets);
+        uint32_t* table = entries.data() + t * n;
+        for (size_t d = 0; d < n; ++d) table[cursor[hashKey(store.descriptor(d), t)]++] = static_cast<uint32_t>(d);
+    });
+}
+
+void LSHIndex::search(const uint8_t* descriptors, size_t count, const DescriptorStore& store, const uint8_t* dead,
+                      TopK& best) const {
+    if (empty() || imageCount == 0 || count == 0) return;
+    const size_t buckets = size_t(1) << keyBits, n = owners.size();
+    if (seenStamp.size() != n) seenStamp.assign(n, 0);
+    if (voteStamp.size() != imageCount) voteStamp.assign(imageCount, 0);
+    votes.resize(imageCount, 0);
+    touched.clear();
+
+    for (size_t q = 0; q < count; ++q) {
+        const uint8_t* query = descriptors + q * bytes;
+        // Đánh dấu theo descriptor query: một descriptor trùng ở nhiều bảng chỉ được xét một lần,
+        // một ảnh chỉ nhận một phiếu của mỗi descriptor query
+        if (++stamp == 0) {
+            fill(seenStamp.begin(), seenStamp.end(), 0u);
+            fill(voteStamp.begin(), voteStamp.end(), 0u);
+            stamp = 1;
+        }
+        for (size_t t = 0; t < tableCount; ++t) {
+            const uint32_t* offsets = bucketOffsets.data() + t * (buckets + 1);
+            const uint32_t key = hashKey(query, t);
+            const uint32_t* table = entries.data() + t * n;
+            for (uint32_t e = offsets[key]; e < offsets[key + 1]; ++e) {
+                const uint32_t d = table[e];
+                if (seenStamp[d] == stamp) continue;
+                seenStamp[d] = stamp;
+                const uint32_t image = owners[d];
+                if (voteStamp[image] == stamp) continue;
+                uint32_t distance;
+                hammingFn(query, store.descriptor(d), 1, bytes, &distance);
+                if (distance > maxDistance) continue;
+                voteStamp[image] = stamp;
+                if (votes[image]++ == 0) touched.push_back(image);
+            }
+        }
+    }
+    for (uint32_t image : touched) {
+        const uint32_t imageVotes = votes[image];
+        votes[image] = 0;
+        if (dead && dead[image]) continue;
+        best.push(1.0 - double(imageVotes) / double(count), image);
+    }
+}
@@ -1,5 +1,7 @@
 #include "LocalFeature.h"
 #include <opencv2/features2d.hpp>
+#include <algorithm>
+#include <cstring>
 
 using namespace cv;
 using namespace std;
@@ -36,4 +38,57 @@ Mat LocalFeature::computeDescriptors(const Mat& image) {
     }
     
     return descriptors;
-}
\ No newline at end of file
+}
+
+double LocalFeature::compare(const vector<float>& feat1, const vector<float>& feat2) const {
+    if (feat1.empty() || feat2.empty()) return 9999.0;
+    return compareRaw(feat1.data(), feat2.data(), min(feat1.size(), feat2.size()));
+}
+
+double LocalFeature::compareRaw(const float* feat1, const float* feat2, size_t dim) const {
+    const size_t bytes = descriptorBytes();
+    return matchDescriptors(packedDescriptors(feat1), packedCount(feat1, dim, bytes),
+                            packedDescriptors(feat2), packedCount(feat2, dim, bytes));
+}
+
+vector<float> LocalFeature::packDescriptors(const Mat& descriptors, size_t maxDescriptors, size_t descriptorBytes) {
+    vector<float> row(packedDimension(maxDescriptors, descriptorBytes), 0.0f);
+    if (descriptors.empty()) return row;
+    if (descriptors.type() != CV_8U || static_cast<size_t>(descriptors.cols) != descriptorBytes) {
+        throw runtime_error("Packed descriptors must be CV_8U with " + to_string(descriptorBytes) + " bytes per row");
+    }
+    const size_t count = min(static_cast<size_t>(descriptors.rows), maxDescriptors);
+    row[0] = static_cast<float>(count);
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(row.data() + 1);
+    for (size_t i = 0; i < count; ++i) {
+        memcpy(bytes + i * descriptorBytes, descriptors.ptr<uint8_t>(static_cast<int>(i)), descriptorBytes);
+    }
+    return row;
+}
+
+size_t LocalFeature::packedCount(const float* row, size_t dim, size_t descriptorBytes) {
+    if (dim == 0 || !(row[0] > 0.0f)) return 0;
+    const size_t capacity = (dim - 1) * sizeof(float) / descriptorBytes;
+    if (row[0] >= static_cast<float>(capacity)) return capacity;
+    return static_cast<size_t>(row[0]);
+}
+
+namespace {
+class DirectQuery : public LocalFeature::PreparedQuery {
+public:
+    DirectQuery(const LocalFeature& feature, const uint8_t* descriptors, size_t count)
+        : feature(feature), descriptors(descriptors), count(count) {}
+    double match(const uint8_t* desc2, size_t n2) const override {
+        return feature.matchDescriptors(descriptors, count, desc2, n2);
+    }
+
+private:
+    const LocalFeature& feature;
+    const uint8_t* descriptors;
+    size_t count;
+};
+}
+
+unique_ptr<LocalFeature::PreparedQuery> LocalFeature::prepareQuery(const uint8_t* descriptors, size_t count) const {
+    return make_unique<DirectQuery>(*this, descriptors, count);
+}
@@ -0,0 +1,130 @@
+#include "Manifest.h"
+#include "Hash.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+static const char MANIFEST_MAGIC[8] = {'C', 'B', 'I', 'R', 'M', 'A', 'N', '\0'};
+
+template <typename T>
+static bool readValue(ifstream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+template <typename T>
+static void writeValue(ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+bool Manifest::load(const string& filePath) {
+    items.clear();
+    rows = 0;
+    ifstream in(filePath, ios::binary);
+    if (!in.is_open()) return false;
+
+    char magic[8];
+    uint32_t version, reserved;
+    uint64_t entryCount;
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, MANIFEST_MAGIC, sizeof(magic)) != 0 ||
+        !readValue(in, version) || version != VERSION || !readValue(in, reserved) ||
+        !readValue(in, rows) || !readValue(in, entryCount)) {
+        cerr << "[Manifest] Invalid manifest: " << filePath << endl;
+        rows = 0;
+        return false;
+    }
+
+    items.resize(entryCount);
+    for (auto& entry : items) {
+        uint32_t len;
+        if (!readValue(in, len)) break;
+        entry.path.resize(len);
+        if ((len > 0 && !in.read(&entry.path[0], len)) || !readValue(in, entry.size) ||
+            !readValue(in, entry.mtime) || !readValue(in, entry.contentHash) || !readValue(in, entry.row)) {
+            break;
+        }
+    }
+    if (!in) {
+        cerr << "[Manifest] Truncated manifest: " << filePath << endl;
+        items.clear();
+        rows = 0;
+        return false;
+    }
+    return true;
+}
+
+bool Manifest::save(const string& filePath) const {
+    string tmpPath = filePath + ".tmp";
+    {
+        ofstream out(tmpPath, ios::binary | ios::trunc);
+        if (!out.is_open()) {
+            cerr << "Error opening file for writing: " << tmpPath << endl;
+            return false;
+        }
+        uint32_t reserved = 0;
+        uint64_t entryCount = items.size();
+        out.write(MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC));
+        writeValue(out, VERSION);
+        writeValue(out, reserved);
+        writeValue(out, rows);
+        writeValue(out, entryCount);
+        for (const auto& entry : items) {
+            uint32_t len = static_cast<uint32_t>(entry.path.size());
+            writeValue(out, len);
+            out.write(entry.path.data(), len);
+            writeValue(out, entry.size);
+            writeValue(out, entry.mtime);
+            writeValue(out, entry.contentHash);
+            writeValue(out, entry.row);
+        }
+        if (!out.good()) return false;
+    }
+    error_code ec;
+    filesystem::rename(tmpPath, filePath, ec);
+    if (ec) {
+        cerr << "[Manifest] Cannot move " << tmpPath << " to " << filePath << ": " << ec.message() << endl;
+        return false;
+    }
+    return true;
+}
+
+void Manifest::assign(vector<ManifestEntry>&& list) {
+    items = std::move(list);
+    sort(items.begin(), items.end(),
+         [](const ManifestEntry& a, const ManifestEntry& b) { return a.path < b.path; });
+}
+
+const ManifestEntry* Manifest::find(const string& path) const {
+    auto it = lower_bound(items.begin(), items.end(), path,
+                          [](const ManifestEntry& entry, const string& key) { return entry.path < key; });
+    return it != items.end() && it->path == path ? &*it : nullptr;
+}
+
+size_t Manifest::liveRows() const {
+    return count_if(items.begin(), items.end(), [](const ManifestEntry& entry) { return entry.row != NO_ROW; });
+}
+
+bool Manifest::statFile(const string& path, uint64_t& size, int64_t& mtime) {
+    error_code ec;
+    size = filesystem::file_size(path, ec);
+    if (ec) return false;
+    auto time = filesystem::last_write_time(path, ec);
+    if (ec) return false;
+    mtime = static_cast<int64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+bool Manifest::hashFile(const string& path, uint64_t& hash) {
+    ifstream in(path, ios::binary);
+    if (!in.is_open()) return false;
+    hash = fnv1a64(nullptr, 0);
+    vector<char> buffer(1 << 20);
+    while (in) {
+        in.read(buffer.data(), buffer.size());
+        hash = fnv1a64(buffer.data(), static_cast<size_t>(in.gcount()), hash);
+    }
+    return in.eof();
+}
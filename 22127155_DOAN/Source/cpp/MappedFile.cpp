@@ -0,0 +1,141 @@
+#include "MappedFile.h"
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const string& filePath) {
+    close();
+    HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        cerr << "[MappedFile] Cannot open " << filePath << endl;
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        cerr << "[MappedFile] CreateFileMapping failed for " << filePath << endl;
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        cerr << "[MappedFile] MapViewOfFile failed for " << filePath << endl;
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    base = view;
+    length = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::close() {
+    if (base) UnmapViewOfFile(base);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+    base = nullptr;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+    length = 0;
+}
+
+void MappedFile::advise(size_t offset, size_t bytes, Advice advice) const {
+#if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+    if (!base || offset >= length || advice != WillNeed) return;
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = const_cast<char*>(data()) + offset;
+    range.NumberOfBytes = min(bytes, length - offset);
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+    (void)offset; (void)bytes; (void)advice;
+#endif
+}
+
+size_t MappedFile::physicalMemory() {
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (!GlobalMemoryStatusEx(&status)) return 0;
+    return static_cast<size_t>(status.ullTotalPhys);
+}
+
+#else
+
+bool MappedFile::open(const string& filePath) {
+    close();
+    int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cerr << "[MappedFile] Cannot open " << filePath << endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // mapping giữ tham chiếu tới file
+    if (view == MAP_FAILED) {
+        cerr << "[MappedFile] mmap failed for " << filePath << endl;
+        return false;
+    }
+    base = view;
+    length = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void MappedFile::close() {
+    if (base) munmap(base, length);
+    base = nullptr;
+    length = 0;
+}
+
+void MappedFile::advise(size_t offset, size_t bytes, Advice advice) const {
+    if (!base || offset >= length) return;
+    // madvise yêu cầu địa chỉ căn theo trang
+    static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t begin = offset & ~(pageSize - 1);
+    size_t end = min(length, offset + bytes);
+    int flag = MADV_NORMAL;
+    switch (advice) {
+        case Normal: flag = MADV_NORMAL; break;
+        case Sequential: flag = MADV_SEQUENTIAL; break;
+        case Random: flag = MADV_RANDOM; break;
+        case WillNeed: flag = MADV_WILLNEED; break;
+        case DontNeed: flag = MADV_DONTNEED; break;
+    }
+    madvise(static_cast<char*>(base) + begin, end - begin, flag);
+}
+
+size_t MappedFile::physicalMemory() {
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGESIZE);
+    if (pages <= 0 || pageSize <= 0) return 0;
+    return static_cast<size_t>(pages) * static_cast<size_t>(pageSize);
+}
+
+#endif
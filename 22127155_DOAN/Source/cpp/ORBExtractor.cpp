@@ -2,6 +2,9 @@
 #include <stdexcept>  // For runtime_error
 #include <opencv2/features2d.hpp>
 #include <opencv2/core.hpp>  // For cv::Mat and other core types
+#include "DistanceKernels.h"
+#include <algorithm>
+#include <cstdint>
 
 using namespace cv;
 using std::vector;  // For vector type
@@ -16,27 +19,9 @@ ORBExtractor::ORBExtractor(int nFeatures) : nFeatures(nFeatures) {
     }
 }
 
-// Returns the name of the method used for feature extraction.
+// Packs the binary descriptors of the image (see LocalFeature::packDescriptors)
 std::vector<float> ORBExtractor::extract(const cv::Mat& image) {
-    cv::Mat descriptors = computeDescriptors(image);
-
-    // Nếu không có descriptor, trả về vector 0 đúng số chiều
-    if (descriptors.empty() || descriptors.rows == 0) {
-        return std::vector<float>(getFeatureDimension(), 0.0f);
-    }
-
-    // Chuyển descriptor thành vector<float>
-    std::vector<float> features;
-    descriptors.convertTo(descriptors, CV_32F);
-    features.assign((float*)descriptors.datastart, (float*)descriptors.dataend);
-
-    // Nếu số chiều nhỏ hơn getFeatureDimension(), bổ sung 0 cho đủ
-    if (features.size() < getFeatureDimension()) {
-        features.resize(getFeatureDimension(), 0.0f);
-    } else if (features.size() > getFeatureDimension()) {
-        features.resize(getFeatureDimension());
-    }
-    return features;
+    return packDescriptors(computeDescriptors(image), nFeatures, DESCRIPTOR_BYTES);
 }
 
 // Computes the ORB descriptors for the given image.
@@ -55,41 +40,54 @@ Mat ORBExtractor::computeDescriptors(const Mat& image) {
 
     detector->detectAndCompute(gray, noArray(), keypoints, descriptors);
 
-    if (descriptors.empty()) {
-        return Mat::zeros(1, 32, CV_8U); // ORB descriptor size is 32 bytes
-    }
-
-    return descriptors; // Do NOT convert to CV_32F
+    // Không có keypoint: hàng đóng gói có 0 descriptor
+    return descriptors; // CV_8U, 32 byte mỗi hàng
 }
 
-double ORBExtractor::compare(const std::vector<float>& feat1, const std::vector<float>& feat2) {
-    // Kiểm tra kích thước của đặc trưng
-    int dim = 32;
-    if (feat1.empty() || feat2.empty()) return 9999.0;
-    if (feat1.size() % dim != 0 || feat2.size() % dim != 0) return 9999.0;
-
-    int n1 = feat1.size() / dim;
-    int n2 = feat2.size() / dim;
-
-    // Chuyển đổi vector<float> thành cv::Mat
-    cv::Mat desc1(n1, dim, CV_32F, const_cast<float*>(feat1.data()));
-    cv::Mat desc2(n2, dim, CV_32F, const_cast<float*>(feat2.data()));
-
-    cv::Mat desc1_8u, desc2_8u;
-    desc1.convertTo(desc1_8u, CV_8U);
-    desc2.convertTo(desc2_8u, CV_8U);
-
-    // Sử dụng BFMatcher với crossCheck = true
-    cv::BFMatcher matcher(cv::NORM_HAMMING, true); // crossCheck = true
-    std::vector<cv::DMatch> matches;
-    matcher.match(desc1_8u, desc2_8u, matches);
+double ORBExtractor::matchDescriptors(const uint8_t* desc1, size_t n1, const uint8_t* desc2, size_t n2) const {
+    if (n1 == 0 || n2 == 0) return 9999.0;
+
+    // Bộ đệm riêng của mỗi luồng: compareRaw() được gọi song song khi quét database
+    thread_local vector<uint32_t> distances;
+    thread_local vector<uint32_t> bestOf1;                   // với mỗi i: j gần nhất
+    thread_local vector<std::pair<uint32_t, uint32_t>> bestOf2; // với mỗi j: (khoảng cách, i) gần nhất
+    distances.resize(n2);
+    bestOf1.resize(n1);
+    bestOf2.assign(n2, {UINT32_MAX, 0});
+
+    // Một lượt qua ma trận khoảng cách n1 x n2 cho cả hai chiều của crossCheck
+    const DistanceKernels::HammingFn hamming = DistanceKernels::hammingKernel();
+    for (size_t i = 0; i < n1; ++i) {
+        hamming(desc1 + i * DESCRIPTOR_BYTES, desc2, n2, DESCRIPTOR_BYTES, distances.data());
+        uint32_t best = UINT32_MAX, bestJ = 0;
+        for (size_t j = 0; j < n2; ++j) {
+            const uint32_t d = distances[j];
+            if (d < best) {
+                best = d;
+                bestJ = static_cast<uint32_t>(j);
+            }
+            if (d < bestOf2[j].first) bestOf2[j] = {d, static_cast<uint32_t>(i)};
+        }
+        bestOf1[i] = bestJ;
+    }
 
-    // Nếu không có matches, trả về khoảng cách lớn
+    // Chỉ giữ cặp (i, j) mà i cũng là descriptor gần j nhất (như BFMatcher với crossCheck = true)
     double sum = 0.0;
-    for (const auto& m : matches) sum += m.distance;
-    return matches.empty() ? 9999.0 : sum / (matches.size() * 32.0);
+    size_t matches = 0;
+    for (size_t i = 0; i < n1; ++i) {
+        const auto& back = bestOf2[bestOf1[i]];
+        if (back.second != i) continue;
+        sum += back.first;
+        ++matches;
+    }
+    return matches == 0 ? 9999.0 : sum / (matches * 32.0);
 }
 
 string ORBExtractor::getMethodName() const {
     return "ORB";
+}
+
+string ORBExtractor::getConfig() const {
+    // "packed": hàng là descriptor nhị phân đóng gói, khác với database float cũ
+    return getMethodName() + "(n=" + std::to_string(nFeatures) + ",packed)";
 }
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include "ProductQuantizer.h"
+#include "DistanceKernels.h"
+#include "ThreadPool.h"
+#include "CvThreadScope.h"
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+using namespace std;
+using namespace cv;
+
+static const char PQ_MAGIC[8] = {'C', 'B', 'I', 'R', 'P', 'Q', '\0', '\0'};
+
+template <typename T>
+static bool readValue(ifstream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+template <typename T>
+static void writeValue(ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void ProductQuantizer::clear() {
+    dim = 0;
+    subspaceCount = 0;
+    codebooks.clear();
+    codes.clear();
+}
+
+bool ProductQuantizer::train(const float* samples, size_t sampleRows, size_t dimension, size_t subspaces) {
+    clear();
+    if (!samples || dimension == 0 || subspaces == 0) return false;
+    if (sampleRows < CENTROIDS) {
+        cerr << "[ProductQuantizer] Need at least " << CENTROIDS << " rows to train, got " << sampleRows << endl;
+        return false;
+    }
+    dim = dimension;
+    subspaceCount = min(subspaces, dimension);
+    codebooks.assign(CENTROIDS * dim, 0.0f);
+
+    // Mỗi subspace một k-means độc lập; OpenCV chạy đơn luồng bên trong mỗi task
+    ThreadPool& pool = ThreadPool::shared();
+    vector<uint8_t> ok(subspaceCount, 0);
+    CvThreadScope cvThreads(pool.size() > 1);
+    pool.parallelFor(0, subspaceCount, [&](size_t j, size_t) {
+        const size_t begin = subspaceBegin(j), width = subspaceBegin(j + 1) - begin;
+        Mat sub(static_cast<int>(sampleRows), static_cast<int>(width), CV_32F);
+        for (size_t r = 0; r < sampleRows; ++r) {
+            memcpy(sub.ptr<float>(static_cast<int>(r)), samples + r * dimension + begin, width * sizeof(float));
+        }
+        Mat labels, centers;
+        setRNGSeed(static_cast<int>(0x5A17 + j));
+        kmeans(sub, static_cast<int>(CENTROIDS), labels,
+               TermCriteria(TermCriteria::COUNT + TermCriteria::EPS, KMEANS_ITERATIONS, 1e-5),
+               1, KMEANS_PP_CENTERS, centers);
+        if (centers.rows != static_cast<int>(CENTROIDS) || centers.cols != static_cast<int>(width)) return;
+        float* out = codebooks.data() + CENTROIDS * begin;
+        for (size_t c = 0; c < CENTROIDS; ++c) {
+            memcpy(out + c * width, centers.ptr<float>(static_cast<int>(c)), width * sizeof(float));
+        }
+        ok[j] = 1;
+    });
+
+    if (find(ok.begin(), ok.end(), uint8_t(0)) != ok.end()) {
+        cerr << "[ProductQuantizer] k-means failed" << endl;
+        clear();
+        return false;
+    }
+    return true;
+}
+
+void ProductQuantizer::encode(const float* row, uint8_t* out) const {
+    const DistanceKernels::SquaredL2Fn kernel = DistanceKernels::squaredL2Kernel();
+    for (size_t j = 0; j < subspaceCount; ++j) {
+        const size_t begin = subspaceBegin(j), width = subspaceBegin(j + 1) - begin;
+        float best = numeric_limits<float>::infinity();
+        size_t bestCentroid = 0;
+        for (size_t c = 0; c < CENTROIDS; ++c) {
+            float d = kernel(row + begin, centroid(j, c), width);
+            if (d < best) {
+                best = d;
+                bestCentroid = c;
+            }
+        }
+        out[j] = static_cast<uint8_t>(bestCentroid);
+    }
+}
+
+void ProductQuantizer::append(const float* rows, size_t count) {
+    if (empty() || count == 0) return;
+    const size_t first = codes.size();
+    codes.resize(first + count * subspaceCount);
+    ThreadPool::shared().parallelFor(0, count, [&](size_t r, size_t) {
+        encode(rows + r * dim, codes.data() + first + r * subspaceCount);
+    }, 64);
+}
+
+void ProductQuantizer::computeTable(const float* query, vector<float>& table) const {
+    const DistanceKernels::SquaredL2Fn kernel = DistanceKernels::squaredL2Kernel();
+    table.resize(subspaceCount * CENTROIDS);
+    for (size_t j = 0; j < subspaceCount; ++j) {
+        const size_t begin = subspaceBegin(j), width = subspaceBegin(j + 1) - begin;
+        for (size_t c = 0; c < CENTROIDS; ++c) {
+            table[j * CENTROIDS + c] = kernel(query + begin, centroid(j, c), width);
+        }
+    }
+}
+
+bool ProductQuantizer::save(const string& filePath, uint64_t pathsHash) const {
+    string tmpPath = filePath + ".tmp";
+    {
+        ofstream out(tmpPath, ios::binary | ios::trunc);
+        if (!out.is_open()) {
+            cerr << "Error opening file for writing: " << tmpPath << endl;
+            return false;
+        }
+        out.write(PQ_MAGIC, sizeof(PQ_MAGIC));
+        writeValue(out, VERSION);
+        writeValue(out, static_cast<uint32_t>(dim));
+        writeValue(out, static_cast<uint32_t>(subspaceCount));
+        writeValue(out, uint32_t(0));
+        writeValue(out, static_cast<uint64_t>(rows()));
+        writeValue(out, pathsHash);
+        out.write(reinterpret_cast<const char*>(codebooks.data()), codebooks.size() * sizeof(float));
+        out.write(reinterpret_cast<const char*>(codes.data()), codes.size());
+        if (!out.good()) {
+            cerr << "[ProductQuantizer] Failed writing " << tmpPath << endl;
+            return false;
+        }
+    }
+    error_code ec;
+    filesystem::rename(tmpPath, filePath, ec);
+    if (ec) {
+        cerr << "[ProductQuantizer] Cannot move " << tmpPath << " to " << filePath << ": " << ec.message() << endl;
+        return false;
+    }
+    return true;
+}
+
+bool ProductQuantizer::load(const string& filePath, size_t dimension, uint64_t& pathsHash) {
+    clear();
+    ifstream in(filePath, ios::binary);
+    if (!in.is_open()) return false;
+
+    char magic[8];
+    uint32_t version, fileDim, fileSubspaces, reserved;
+    uint64_t rowCount;
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, PQ_MAGIC, sizeof(magic)) != 0 ||
+        !readValue(in, version) || version != VERSION || !readValue(in, fileDim) ||
+        !readValue(in, fileSubspaces) || !readValue(in, reserved) || !readValue(in, rowCount) ||
+        !readValue(in, pathsHash)) {
+        cerr << "[ProductQuantizer] Invalid codes: " << filePath << endl;
+        return false;
+    }
+    if (fileDim != dimension || fileSubspaces == 0 || fileSubspaces > fileDim) {
+        cerr << "[ProductQuantizer] Codes do not match the database: " << filePath << endl;
+        return false;
+    }
+    codebooks.resize(CENTROIDS * fileDim);
+    codes.resize(rowCount * fileSubspaces);
+    if (!in.read(reinterpret_cast<char*>(codebooks.data()), codebooks.size() * sizeof(float)) ||
+        (!codes.empty() && !in.read(reinterpret_cast<char*>(codes.data()), codes.size()))) {
+        cerr << "[ProductQuantizer] Truncated codes: " << filePath << endl;
+        clear();
+        return false;
+    }
+    dim = fileDim;
+    subspaceCount = fileSubspaces;
+    return true;
+}
@@ -1,5 +1,6 @@
 #include "SIFTExtractor.h"
 #include <opencv2/imgproc.hpp>
+#include <sstream>
 
 // Constructor for SIFTExtractor, initializes the SIFT detector with the specified parameters.
 SIFTExtractor::SIFTExtractor(int nFeatures, int nOctaveLayers, 
@@ -17,54 +18,44 @@ std::string SIFTExtractor::getMethodName() const {
     return "SIFT";
 }
 
+std::string SIFTExtractor::getConfig() const {
+    std::ostringstream oss;
+    oss << getMethodName() << "(n=" << nFeatures << ",layers=" << nOctaveLayers
+        << ",contrast=" << contrastThreshold << ",edge=" << edgeThreshold << ",sigma=" << sigma << ",u8)";
+    return oss.str();
+}
+
 std::vector<float> SIFTExtractor::extract(const cv::Mat& image) {
     cv::Mat descriptors = computeDescriptors(image);
 
-    // Nếu không có descriptor, trả về vector 0 đúng số chiều
-    if (descriptors.empty() || descriptors.rows == 0) {
-        return std::vector<float>(getFeatureDimension(), 0.0f);
-    }
-
-    // Chuyển descriptor thành vector<float>
-    std::vector<float> features;
-    descriptors.convertTo(descriptors, CV_32F);
-    features.assign((float*)descriptors.datastart, (float*)descriptors.dataend);
-
-    // Nếu số chiều nhỏ hơn getFeatureDimension(), bổ sung 0 cho đủ
-    if (features.size() < getFeatureDimension()) {
-        features.resize(getFeatureDimension(), 0.0f);
-    } else if (features.size() > getFeatureDimension()) {
-        features.resize(getFeatureDimension());
-    }
-    return features;
+    // Giá trị descriptor SIFT là số nguyên trong 0..255 (OpenCV nhân 512 rồi bão hòa về uchar):
+    // lưu 1 byte mỗi chiều, không mất thông tin
+    cv::Mat bytes;
+    if (!descriptors.empty()) descriptors.convertTo(bytes, CV_8U);
+    return packDescriptors(bytes, nFeatures, DESCRIPTOR_BYTES);
 }
 
-// Extract features from the image using SIFT
-double SIFTExtractor::compare(const std::vector<float>& feat1, const std::vector<float>& feat2) {
-    int dim = 128; // SIFT descriptor size
-    if (feat1.empty() || feat2.empty()) {
-        std::cerr << "One or both feature vectors are empty." << std::endl;
-        return 0.0;
-    }
-    if (feat1.size() % dim != 0 || feat2.size() % dim != 0) {
-        std::cerr << "Feature vector size is not a multiple of 128." << std::endl;
-        return 0.0;
-    }
-
-    int n1 = feat1.size() / dim;
-    int n2 = feat2.size() / dim;
-    cv::Mat desc1(n1, dim, CV_32F, const_cast<float*>(feat1.data()));
-    cv::Mat desc2(n2, dim, CV_32F, const_cast<float*>(feat2.data()));
+namespace {
+class SIFTQuery : public LocalFeature::PreparedQuery {
+public:
+    SIFTQuery(const uint8_t* descriptors, size_t count) { matcher.setQuery(descriptors, count); }
+    double match(const uint8_t* desc2, size_t n2) const override { return matcher.match(desc2, n2); }
 
-    cv::BFMatcher matcher(cv::NORM_L2);
-    std::vector<cv::DMatch> matches;
-    matcher.match(desc1, desc2, matches);
+private:
+    SIFTMatcher matcher;
+};
+}
 
-    double sum = 0.0;
-    for (const auto& m : matches) sum += m.distance;
-    double avg = matches.empty() ? 0.0 : sum / matches.size();
+double SIFTExtractor::matchDescriptors(const uint8_t* desc1, size_t n1, const uint8_t* desc2, size_t n2) const {
+    if (n1 == 0 || n2 == 0) return 9999.0;
+    // Bộ đệm query riêng của mỗi luồng, không cấp phát lại giữa các lần so sánh
+    thread_local SIFTMatcher matcher;
+    matcher.setQuery(desc1, n1);
+    return matcher.match(desc2, n2);
+}
 
-    return avg / 512.0;
+std::unique_ptr<LocalFeature::PreparedQuery> SIFTExtractor::prepareQuery(const uint8_t* descriptors, size_t count) const {
+    return std::make_unique<SIFTQuery>(descriptors, count);
 }
 
 // Convert SIFT descriptors to string for CSV storage
@@ -0,0 +1,87 @@
+#include "SIFTMatcher.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+using namespace cv;
+
+// Đổi count descriptor uint8 sang hàng float32 của out và tính bình phương norm (số nguyên, chính xác)
+static void toFloatRows(const uint8_t* descriptors, size_t count, Mat& out, vector<float>& norms) {
+    out.create(static_cast<int>(count), static_cast<int>(SIFTMatcher::DESCRIPTOR_BYTES), CV_32F);
+    norms.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t* src = descriptors + i * SIFTMatcher::DESCRIPTOR_BYTES;
+        float* dst = out.ptr<float>(static_cast<int>(i));
+        uint32_t norm = 0;
+        for (size_t j = 0; j < SIFTMatcher::DESCRIPTOR_BYTES; ++j) {
+            dst[j] = src[j];
+            norm += uint32_t(src[j]) * src[j];
+        }
+        norms[i] = static_cast<float>(norm);
+    }
+}
+
+void SIFTMatcher::setQuery(const uint8_t* descriptors, size_t count) {
+    if (count == 0) {
+        query.release();
+        queryNorms.clear();
+        return;
+    }
+    toFloatRows(descriptors, count, query, queryNorms);
+}
+
+double SIFTMatcher::match(const uint8_t* descriptors, size_t count) const {
+    const size_t n1 = queryCount();
+    if (n1 == 0 || count == 0) return 9999.0;
+
+    // Bộ đệm riêng của mỗi luồng, dùng lại giữa các ảnh
+    thread_local Mat train, dots;
+    thread_local vector<float> trainNorms;
+    thread_local vector<float> best1, best2;                // bình phương khoảng cách gần nhất, gần nhì
+    thread_local vector<uint32_t> bestIndex;                // với mỗi descriptor query: descriptor ảnh gần nhất
+    thread_local vector<pair<float, uint32_t>> trainBest;   // với mỗi descriptor ảnh: (khoảng cách, query) gần nhất
+    toFloatRows(descriptors, count, train, trainNorms);
+    best1.assign(n1, numeric_limits<float>::infinity());
+    best2.assign(n1, numeric_limits<float>::infinity());
+    bestIndex.assign(n1, 0);
+    trainBest.assign(count, {numeric_limits<float>::infinity(), 0});
+
+    for (size_t q0 = 0; q0 < n1; q0 += QUERY_TILE) {
+        const size_t q1 = min(n1, q0 + QUERY_TILE);
+        // dots(i, j) = query(q0 + i) · train(j)
+        gemm(query.rowRange(static_cast<int>(q0), static_cast<int>(q1)), train, 1.0, noArray(), 0.0, dots, GEMM_2_T);
+        for (size_t q = q0; q < q1; ++q) {
+            const float* dotRow = dots.ptr<float>(static_cast<int>(q - q0));
+            const float queryNorm = queryNorms[q];
+            float d1 = best1[q], d2 = best2[q];
+            uint32_t index = bestIndex[q];
+            for (size_t j = 0; j < count; ++j) {
+                const float d = queryNorm + trainNorms[j] - 2.0f * dotRow[j];
+                if (d < d2) {
+                    if (d < d1) {
+                        d2 = d1;
+                        d1 = d;
+                        index = static_cast<uint32_t>(j);
+                    } else {
+                        d2 = d;
+                    }
+                }
+                if (d < trainBest[j].first) trainBest[j] = {d, static_cast<uint32_t>(q)};
+            }
+            best1[q] = d1;
+            best2[q] = d2;
+            bestIndex[q] = index;
+        }
+    }
+
+    // Ratio test trên bình phương khoảng cách (ảnh chỉ có một descriptor: không có láng giềng gần nhì)
+    const float ratio2 = ratio * ratio;
+    double sum = 0.0;
+    for (size_t q = 0; q < n1; ++q) {
+        const bool distinctive = best1[q] < ratio2 * best2[q];
+        const bool mutual = trainBest[bestIndex[q]].second == q;
+        sum += distinctive && mutual ? std::sqrt(max(0.0, double(best1[q]))) : REJECT_DISTANCE;
+    }
+    return sum / (n1 * 512.0);
+}
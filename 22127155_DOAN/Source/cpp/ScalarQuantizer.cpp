@@ -0,0 +1,166 @@
+#include "ScalarQuantizer.h"
+#include "Half.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+static const char SQ_MAGIC[8] = {'C', 'B', 'I', 'R', 'S', 'Q', '\0', '\0'};
+
+template <typename T>
+static bool readValue(ifstream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+template <typename T>
+static void writeValue(ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+ScalarQuantizer::ScalarQuantizer()
+    : halfKernel(DistanceKernels::squaredL2HalfKernel()), byteKernel(DistanceKernels::squaredL2ByteKernel()) {}
+
+void ScalarQuantizer::clear() {
+    dim = 0;
+    scale.clear();
+    offset.clear();
+    halves.clear();
+    bytes.clear();
+}
+
+bool ScalarQuantizer::train(const float* samples, size_t sampleRows, size_t dimension, Type type) {
+    clear();
+    if (dimension == 0 || (type != Float16 && type != Int8)) return false;
+    kind = type;
+    if (kind == Float16) {
+        dim = dimension;
+        return true;
+    }
+    if (!samples || sampleRows == 0) {
+        cerr << "[ScalarQuantizer] Int8 codes need sample rows to find the value ranges" << endl;
+        return false;
+    }
+    // Khoảng [min, max] của từng chiều được chia đều thành 256 mức
+    vector<float> low(samples, samples + dimension), high(low);
+    for (size_t r = 1; r < sampleRows; ++r) {
+        const float* row = samples + r * dimension;
+        for (size_t j = 0; j < dimension; ++j) {
+            low[j] = min(low[j], row[j]);
+            high[j] = max(high[j], row[j]);
+        }
+    }
+    offset = low;
+    scale.resize(dimension);
+    for (size_t j = 0; j < dimension; ++j) scale[j] = (high[j] - low[j]) / 255.0f;
+    dim = dimension;
+    return true;
+}
+
+void ScalarQuantizer::append(const float* rows, size_t count) {
+    if (empty() || count == 0) return;
+    const size_t first = this->rows();
+    if (kind == Float16) {
+        halves.resize((first + count) * dim);
+        ThreadPool::shared().parallelFor(0, count, [&](size_t r, size_t) {
+            const float* row = rows + r * dim;
+            uint16_t* out = halves.data() + (first + r) * dim;
+            for (size_t j = 0; j < dim; ++j) out[j] = floatToHalf(row[j]);
+        }, 256);
+        return;
+    }
+    bytes.resize((first + count) * dim);
+    ThreadPool::shared().parallelFor(0, count, [&](size_t r, size_t) {
+        const float* row = rows + r * dim;
+        uint8_t* out = bytes.data() + (first + r) * dim;
+        for (size_t j = 0; j < dim; ++j) {
+            // Chiều hằng số (scale = 0) luôn giải mã về offset
+            float level = scale[j] > 0.0f ? (row[j] - offset[j]) / scale[j] : 0.0f;
+            out[j] = static_cast<uint8_t>(std::lround(min(255.0f, max(0.0f, level))));
+        }
+    }, 256);
+}
+
+bool ScalarQuantizer::save(const string& filePath, uint64_t pathsHash) const {
+    string tmpPath = filePath + ".tmp";
+    {
+        ofstream out(tmpPath, ios::binary | ios::trunc);
+        if (!out.is_open()) {
+            cerr << "Error opening file for writing: " << tmpPath << endl;
+            return false;
+        }
+        // Float16 không dùng scale/offset nhưng vẫn ghi (scale 1, offset 0) để bố cục cố định
+        vector<float> fileScale = kind == Int8 ? scale : vector<float>(dim, 1.0f);
+        vector<float> fileOffset = kind == Int8 ? offset : vector<float>(dim, 0.0f);
+        out.write(SQ_MAGIC, sizeof(SQ_MAGIC));
+        writeValue(out, VERSION);
+        writeValue(out, static_cast<uint32_t>(dim));
+        writeValue(out, static_cast<uint32_t>(kind));
+        writeValue(out, uint32_t(0));
+        writeValue(out, static_cast<uint64_t>(rows()));
+        writeValue(out, pathsHash);
+        out.write(reinterpret_cast<const char*>(fileScale.data()), fileScale.size() * sizeof(float));
+        out.write(reinterpret_cast<const char*>(fileOffset.data()), fileOffset.size() * sizeof(float));
+        if (kind == Float16) out.write(reinterpret_cast<const char*>(halves.data()), halves.size() * sizeof(uint16_t));
+        else out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        if (!out.good()) {
+            cerr << "[ScalarQuantizer] Failed writing " << tmpPath << endl;
+            return false;
+        }
+    }
+    error_code ec;
+    filesystem::rename(tmpPath, filePath, ec);
+    if (ec) {
+        cerr << "[ScalarQuantizer] Cannot move " << tmpPath << " to " << filePath << ": " << ec.message() << endl;
+        return false;
+    }
+    return true;
+}
+
+bool ScalarQuantizer::load(const string& filePath, size_t dimension, uint64_t& pathsHash) {
+    clear();
+    ifstream in(filePath, ios::binary);
+    if (!in.is_open()) return false;
+
+    char magic[8];
+    uint32_t version, fileDim, fileType, reserved;
+    uint64_t rowCount;
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, SQ_MAGIC, sizeof(magic)) != 0 ||
+        !readValue(in, version) || version != VERSION || !readValue(in, fileDim) || !readValue(in, fileType) ||
+        !readValue(in, reserved) || !readValue(in, rowCount) || !readValue(in, pathsHash) ||
+        (fileType != Float16 && fileType != Int8)) {
+        cerr << "[ScalarQuantizer] Invalid codes: " << filePath << endl;
+        return false;
+    }
+    if (fileDim != dimension) {
+        cerr << "[ScalarQuantizer] Codes do not match the database: " << filePath << endl;
+        return false;
+    }
+    kind = static_cast<Type>(fileType);
+    scale.resize(fileDim);
+    offset.resize(fileDim);
+    bool ok = in.read(reinterpret_cast<char*>(scale.data()), scale.size() * sizeof(float)) &&
+              in.read(reinterpret_cast<char*>(offset.data()), offset.size() * sizeof(float));
+    if (ok && kind == Float16) {
+        halves.resize(rowCount * fileDim);
+        ok = halves.empty() || in.read(reinterpret_cast<char*>(halves.data()), halves.size() * sizeof(uint16_t));
+    } else if (ok) {
+        bytes.resize(rowCount * fileDim);
+        ok = bytes.empty() || in.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+    }
+    if (!ok) {
+        cerr << "[ScalarQuantizer] Truncated codes: " << filePath << endl;
+        clear();
+        return false;
+    }
+    if (kind == Float16) {
+        scale.clear();
+        offset.clear();
+    }
+    dim = fileDim;
+    return true;
+}
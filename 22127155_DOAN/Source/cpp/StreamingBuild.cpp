@@ -0,0 +1,241 @@
+#include "StreamingBuild.h"
+#include "FeatureStore.h"
+#include "FileSync.h"
+#include "Hash.h"
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static const char CHECKPOINT_MAGIC[8] = {'C', 'B', 'I', 'R', 'C', 'K', 'P', '\0'};
+static const uint32_t CHECKPOINT_VERSION = 1;
+
+struct CheckpointData {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t configHash;
+    uint64_t listHash;
+    uint64_t committedImages;
+    uint64_t segmentIndex;
+    uint64_t segmentBytes;
+};
+
+// Bản ghi trong segment: uint32 độ dài path, path, uint32 số float (0 = ảnh lỗi), các float
+static bool readRecord(FILE* file, string& path, vector<float>& features) {
+    uint32_t len, count;
+    if (fread(&len, sizeof(len), 1, file) != 1) return false;
+    path.resize(len);
+    if (len > 0 && fread(&path[0], 1, len, file) != len) return false;
+    if (fread(&count, sizeof(count), 1, file) != 1) return false;
+    features.resize(count);
+    return count == 0 || fread(features.data(), sizeof(float), count, file) == count;
+}
+
+StreamingBuild::StreamingBuild(const string& dbPath, const string& config, uint32_t flags)
+    : dbPath(dbPath), buildDir(dbPath + ".build"), config(config), storeFlags(flags) {}
+
+StreamingBuild::~StreamingBuild() {
+    if (segment) {
+        // Thoát giữa chừng (exception...): giữ lại tiến độ cho lần chạy sau
+        checkpoint();
+        fclose(segment);
+    }
+}
+
+string StreamingBuild::segmentPath(uint64_t index) const {
+    char name[32];
+    snprintf(name, sizeof(name), "segment_%05llu.seg", static_cast<unsigned long long>(index));
+    return (fs::path(buildDir) / name).string();
+}
+
+bool StreamingBuild::openSegment(uint64_t index, bool append) {
+    if (segment) fclose(segment);
+    segment = fopen(segmentPath(index).c_str(), append ? "ab" : "wb");
+    if (!segment) {
+        cerr << "[StreamingBuild] Cannot open " << segmentPath(index) << endl;
+        return false;
+    }
+    segmentIndex = index;
+    segmentBytes = 0;
+    return true;
+}
+
+bool StreamingBuild::readCheckpoint(uint64_t& images, uint64_t& segmentNo, uint64_t& bytes) const {
+    FILE* file = fopen((fs::path(buildDir) / "checkpoint").string().c_str(), "rb");
+    if (!file) return false;
+    CheckpointData data;
+    bool ok = fread(&data, sizeof(data), 1, file) == 1;
+    fclose(file);
+    if (!ok || memcmp(data.magic, CHECKPOINT_MAGIC, sizeof(data.magic)) != 0 ||
+        data.version != CHECKPOINT_VERSION) {
+        return false;
+    }
+    // Chỉ resume khi cùng extractor và cùng danh sách ảnh
+    if (data.configHash != fnv1a64(config) || data.listHash != listHash) return false;
+    images = data.committedImages;
+    segmentNo = data.segmentIndex;
+    bytes = data.segmentBytes;
+    return true;
+}
+
+size_t StreamingBuild::begin(const vector<string>& paths) {
+    listHash = fnv1a64(nullptr, 0);
+    for (const auto& path : paths) {
+        listHash = fnv1a64(path, listHash);
+        listHash = fnv1a64("\n", 1, listHash);
+    }
+    lastCheckpointTime = chrono::steady_clock::now();
+
+    uint64_t images, segmentNo, bytes;
+    error_code ec;
+    if (readCheckpoint(images, segmentNo, bytes) && images <= paths.size()) {
+        // Cắt bỏ phần ghi sau checkpoint cuối cùng và các segment mới hơn
+        fs::resize_file(segmentPath(segmentNo), bytes, ec);
+        if (!ec) {
+            for (uint64_t i = segmentNo + 1; fs::exists(segmentPath(i)); ++i) {
+                fs::remove(segmentPath(i), ec);
+            }
+            if (openSegment(segmentNo, true)) {
+                segmentBytes = bytes;
+                committedImages = lastCheckpoint = static_cast<size_t>(images);
+                return committedImages;
+            }
+        }
+    }
+
+    // Bắt đầu lại từ đầu
+    fs::remove_all(buildDir, ec);
+    fs::create_directories(buildDir);
+    committedImages = lastCheckpoint = 0;
+    if (!openSegment(0, false)) return 0;
+    checkpoint();
+    return 0;
+}
+
+bool StreamingBuild::append(const string& path, const vector<float>& features) {
+    if (!segment) return false;
+    if (segmentBytes >= SEGMENT_BYTES) {
+        if (!checkpoint() || !openSegment(segmentIndex + 1, false)) return false;
+    }
+
+    uint32_t len = static_cast<uint32_t>(path.size());
+    uint32_t count = static_cast<uint32_t>(features.size());
+    bool ok = fwrite(&len, sizeof(len), 1, segment) == 1 &&
+              fwrite(path.data(), 1, len, segment) == len &&
+              fwrite(&count, sizeof(count), 1, segment) == 1 &&
+              (count == 0 || fwrite(features.data(), sizeof(float), count, segment) == count);
+    if (!ok) {
+        cerr << "[StreamingBuild] Write failed on " << segmentPath(segmentIndex) << endl;
+        return false;
+    }
+    segmentBytes += sizeof(len) + len + sizeof(count) + uint64_t(count) * sizeof(float);
+    ++committedImages;
+
+    if (committedImages - lastCheckpoint >= CHECKPOINT_EVERY ||
+        chrono::steady_clock::now() - lastCheckpointTime >= chrono::seconds(CHECKPOINT_SECONDS)) {
+        return checkpoint();
+    }
+    return true;
+}
+
+bool StreamingBuild::checkpoint() {
+    if (!segment || !FileSync::syncFile(segment)) return false;
+
+    CheckpointData data{};
+    memcpy(data.magic, CHECKPOINT_MAGIC, sizeof(data.magic));
+    data.version = CHECKPOINT_VERSION;
+    data.configHash = fnv1a64(config);
+    data.listHash = listHash;
+    data.committedImages = committedImages;
+    data.segmentIndex = segmentIndex;
+    data.segmentBytes = segmentBytes;
+
+    string finalPath = (fs::path(buildDir) / "checkpoint").string();
+    string tmpPath = finalPath + ".tmp";
+    FILE* file = fopen(tmpPath.c_str(), "wb");
+    if (!file) return false;
+    bool ok = fwrite(&data, sizeof(data), 1, file) == 1 && FileSync::syncFile(file);
+    fclose(file);
+    if (!ok) return false;
+
+    // rename thay thế nguyên tử: checkpoint luôn là bản cũ hoặc bản mới, không bao giờ ghi dở
+    error_code ec;
+    fs::rename(tmpPath, finalPath, ec);
+    if (ec) return false;
+    FileSync::syncDirectory(buildDir);
+
+    lastCheckpoint = committedImages;
+    lastCheckpointTime = chrono::steady_clock::now();
+    return true;
+}
+
+bool StreamingBuild::finish() {
+    if (!segment || !checkpoint()) return false;
+    fclose(segment);
+    segment = nullptr;
+
+    string path;
+    vector<float> features;
+
+    // Lần 1: số chiều lấy từ ảnh hợp lệ đầu tiên
+    size_t dimension = 0;
+    for (uint64_t i = 0; i <= segmentIndex && dimension == 0; ++i) {
+        FILE* file = fopen(segmentPath(i).c_str(), "rb");
+        if (!file) return false;
+        while (readRecord(file, path, features)) {
+            if (!features.empty()) {
+                dimension = features.size();
+                break;
+            }
+        }
+        fclose(file);
+    }
+    if (dimension == 0) {
+        cerr << "[StreamingBuild] No image produced features, database not written" << endl;
+        return false;
+    }
+
+    // Lần 2: ghi từng hàng vào file .fdb tạm, rồi đổi tên
+    string tmpPath = dbPath + ".tmp";
+    FeatureStoreWriter writer;
+    if (!writer.open(tmpPath, config, dimension, storeFlags)) return false;
+    for (uint64_t i = 0; i <= segmentIndex; ++i) {
+        FILE* file = fopen(segmentPath(i).c_str(), "rb");
+        if (!file) return false;
+        while (readRecord(file, path, features)) {
+            if (features.empty()) continue;
+            if (features.size() != dimension) {
+                cerr << "[StreamingBuild] Skipping " << path << ": dimension "
+                     << features.size() << " != " << dimension << endl;
+                continue;
+            }
+            if (!writer.append(path, features.data())) {
+                cerr << "[StreamingBuild] Write failed on " << tmpPath << endl;
+                fclose(file);
+                return false;
+            }
+        }
+        fclose(file);
+    }
+    if (!writer.close()) return false;
+
+    // Database phải nằm trên đĩa (nội dung rồi rename) trước khi xóa các segment dựng nên nó
+    const string dbDir = FileSync::parentDirectory(dbPath);
+    if (!FileSync::syncPath(tmpPath)) {
+        cerr << "[StreamingBuild] Cannot sync " << tmpPath << endl;
+        return false;
+    }
+    FileSync::syncDirectory(dbDir);
+    error_code ec;
+    fs::rename(tmpPath, dbPath, ec);
+    if (ec) {
+        cerr << "[StreamingBuild] Cannot move " << tmpPath << " to " << dbPath << ": " << ec.message() << endl;
+        return false;
+    }
+    FileSync::syncDirectory(dbDir);
+    fs::remove_all(buildDir, ec);
+    return true;
+}
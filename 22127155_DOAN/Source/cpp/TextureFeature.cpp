@@ -1,4 +1,5 @@
 #include "TextureFeature.h"
+#include "DistanceKernels.h"
 #include <opencv2/imgproc.hpp>
 
 using namespace cv;
@@ -66,14 +67,18 @@ Mat TextureFeature::computeLBP(const Mat& src) {
 }
 
 // Compare two feature vectors using Euclidean distance
-double TextureFeature::compare(const vector<float>& feat1, const vector<float>& feat2) {
-    // Sử dụng khoảng cách Euclidean
-    double sum = 0.0;
-    for (size_t i = 0; i < feat1.size(); ++i) {
-        double diff = feat1[i] - feat2[i];
-        sum += diff * diff;
-    }
-    return sqrt(sum);
+double TextureFeature::compare(const vector<float>& feat1, const vector<float>& feat2) const {
+    return compareRaw(feat1.data(), feat2.data(), feat1.size());
+}
+
+double TextureFeature::compareRaw(const float* feat1, const float* feat2, size_t dim) const {
+    // Khoảng cách Euclidean (kernel SIMD chọn theo CPU)
+    return DistanceKernels::l2(feat1, feat2, dim);
+}
+
+double TextureFeature::compareBounded(const float* feat1, const float* feat2, size_t dim, double bound) const {
+    // Dừng sớm khi tổng riêng phần vượt ngưỡng
+    return DistanceKernels::l2Bounded(feat1, feat2, dim, bound);
 }
 
 // Get the name of the method used for feature extraction
@@ -0,0 +1,130 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <exception>
+
+using namespace std;
+
+// Pool và chỉ số worker của luồng hiện tại (nullptr nếu không phải worker)
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local size_t currentWorker = 0;
+
+struct ThreadPool::Batch {
+    const IndexFn* fn;
+    size_t remaining = 0; // được bảo vệ bởi doneMutex
+    mutex doneMutex;
+    condition_variable done;
+    exception_ptr error;
+};
+
+ThreadPool::ThreadPool(size_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = max(1u, thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < threadCount; ++i) {
+        queues.push_back(make_unique<WorkerQueue>());
+    }
+    for (size_t i = 0; i < threadCount; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, const IndexFn& fn, size_t grain) {
+    if (begin >= end) return;
+    grain = max<size_t>(1, grain);
+
+    // Gọi lồng từ một worker của chính pool này: chạy tại chỗ để tránh deadlock
+    if (currentPool == this) {
+        for (size_t i = begin; i < end; ++i) fn(i, currentWorker);
+        return;
+    }
+
+    Batch batch;
+    batch.fn = &fn;
+    size_t taskCount = (end - begin + grain - 1) / grain;
+    batch.remaining = taskCount;
+
+    // Chia đều các task cho hàng đợi của từng worker (round-robin)
+    for (size_t t = 0; t < taskCount; ++t) {
+        Task task{begin + t * grain, min(end, begin + (t + 1) * grain), &batch};
+        WorkerQueue& queue = *queues[t % queues.size()];
+        lock_guard<mutex> lock(queue.mutex);
+        queue.tasks.push_back(task);
+    }
+    {
+        lock_guard<mutex> lock(sleepMutex);
+        pending += taskCount;
+    }
+    wake.notify_all();
+
+    unique_lock<mutex> lock(batch.doneMutex);
+    batch.done.wait(lock, [&] { return batch.remaining == 0; });
+    if (batch.error) rethrow_exception(batch.error);
+}
+
+bool ThreadPool::popTask(size_t id, Task& task) {
+    // Lấy task của mình từ cuối hàng đợi
+    {
+        WorkerQueue& own = *queues[id];
+        lock_guard<mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            --pending;
+            return true;
+        }
+    }
+    // Lấy trộm từ đầu hàng đợi của worker khác
+    for (size_t k = 1; k < queues.size(); ++k) {
+        WorkerQueue& victim = *queues[(id + k) % queues.size()];
+        lock_guard<mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            --pending;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::runTask(const Task& task, size_t worker) {
+    Batch& batch = *task.batch;
+    try {
+        for (size_t i = task.begin; i < task.end; ++i) (*batch.fn)(i, worker);
+    } catch (...) {
+        lock_guard<mutex> lock(batch.doneMutex);
+        if (!batch.error) batch.error = current_exception();
+    }
+    // Giảm bộ đếm khi đang giữ khóa: luồng gọi chưa thể hủy batch cho tới khi khóa được nhả
+    lock_guard<mutex> lock(batch.doneMutex);
+    if (--batch.remaining == 0) batch.done.notify_all();
+}
+
+void ThreadPool::workerLoop(size_t id) {
+    currentPool = this;
+    currentWorker = id;
+    while (true) {
+        Task task;
+        if (popTask(id, task)) {
+            runTask(task, id);
+            continue;
+        }
+        unique_lock<mutex> lock(sleepMutex);
+        wake.wait(lock, [&] { return stopping || pending.load() > 0; });
+        if (stopping && pending.load() == 0) return;
+    }
+}
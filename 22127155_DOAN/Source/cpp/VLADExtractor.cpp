@@ -0,0 +1,231 @@
+#include "VLADExtractor.h"
+#include "DistanceKernels.h"
+#include "Hash.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+using namespace cv;
+
+static const char VLAD_MAGIC[8] = {'C', 'B', 'I', 'R', 'V', 'L', 'A', 'D'};
+
+template <typename T>
+static bool readValue(ifstream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+template <typename T>
+static void writeValue(ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+VLADExtractor::VLADExtractor(unique_ptr<LocalFeature> base, size_t centres)
+    : base(std::move(base)), centreCount(max<size_t>(1, centres)) {
+    if (!this->base) throw runtime_error("VLAD needs a local feature extractor");
+    descriptorDim = this->base->binaryDescriptors() ? this->base->descriptorBytes() * 8 : this->base->descriptorBytes();
+}
+
+unique_ptr<FeatureExtractor> VLADExtractor::clone() const {
+    unique_ptr<LocalFeature> baseCopy(static_cast<LocalFeature*>(base->clone().release()));
+    auto copy = make_unique<VLADExtractor>(std::move(baseCopy), centreCount);
+    copy->codebook = codebook;
+    copy->codebookHash = codebookHash;
+    return copy;
+}
+
+void VLADExtractor::unpackDescriptor(const uint8_t* descriptor, float* out) const {
+    if (base->binaryDescriptors()) {
+        for (size_t b = 0; b < descriptorDim; ++b) out[b] = static_cast<float>((descriptor[b >> 3] >> (b & 7)) & 1u);
+    } else {
+        for (size_t j = 0; j < descriptorDim; ++j) out[j] = descriptor[j];
+    }
+}
+
+bool VLADExtractor::train(const vector<string>& imagePaths) {
+    if (imagePaths.empty()) return false;
+    const size_t images = min(imagePaths.size(), MAX_TRAIN_IMAGES);
+    const size_t perImage = max<size_t>(1, MAX_TRAIN_DESCRIPTORS / images);
+    const size_t bytes = base->descriptorBytes();
+
+    // Trích xuất song song trên các ảnh cách đều nhau, mỗi luồng một bản sao extractor cơ sở
+    ThreadPool& pool = ThreadPool::shared();
+    vector<unique_ptr<FeatureExtractor>> extractors(pool.size());
+    vector<vector<float>> sampled(images);
+    pool.parallelFor(0, images, [&](size_t i, size_t worker) {
+        Mat image = imread(imagePaths[i * imagePaths.size() / images], IMREAD_COLOR);
+        if (image.empty()) return;
+        if (!extractors[worker]) extractors[worker] = base->clone();
+        vector<float> row = extractors[worker]->extract(image);
+        const size_t count = LocalFeature::packedCount(row.data(), row.size(), bytes);
+        const uint8_t* descriptors = LocalFeature::packedDescriptors(row.data());
+        const size_t take = min(count, perImage);
+        sampled[i].resize(take * descriptorDim);
+        for (size_t s = 0; s < take; ++s) {
+            unpackDescriptor(descriptors + (s * count / take) * bytes, sampled[i].data() + s * descriptorDim);
+        }
+    });
+
+    size_t rows = 0;
+    for (const auto& s : sampled) rows += s.size() / descriptorDim;
+    if (rows < centreCount) {
+        cerr << "[VLADExtractor] Need at least " << centreCount << " descriptors to train, got " << rows << endl;
+        return false;
+    }
+    Mat samples(static_cast<int>(rows), static_cast<int>(descriptorDim), CV_32F);
+    size_t at = 0;
+    for (const auto& s : sampled) {
+        if (s.empty()) continue;
+        memcpy(samples.ptr<float>(static_cast<int>(at)), s.data(), s.size() * sizeof(float));
+        at += s.size() / descriptorDim;
+    }
+
+    cout << "Training VLAD codebook (" << centreCount << " centres) on " << rows << " descriptors" << endl;
+    Mat labels, centers;
+    setRNGSeed(0x71AD);
+    kmeans(samples, static_cast<int>(centreCount), labels,
+           TermCriteria(TermCriteria::COUNT + TermCriteria::EPS, KMEANS_ITERATIONS, 1e-3),
+           1, KMEANS_PP_CENTERS, centers);
+    if (centers.rows != static_cast<int>(centreCount) || centers.cols != static_cast<int>(descriptorDim)) {
+        cerr << "[VLADExtractor] k-means failed" << endl;
+        return false;
+    }
+    codebook.resize(centreCount * descriptorDim);
+    for (size_t c = 0; c < centreCount; ++c) {
+        memcpy(codebook.data() + c * descriptorDim, centers.ptr<float>(static_cast<int>(c)), descriptorDim * sizeof(float));
+    }
+    codebookHash = fnv1a64(codebook.data(), codebook.size() * sizeof(float));
+    return true;
+}
+
+bool VLADExtractor::saveCodebook(const string& filePath) const {
+    if (!trained()) return false;
+    string tmpPath = filePath + ".tmp";
+    {
+        ofstream out(tmpPath, ios::binary | ios::trunc);
+        if (!out.is_open()) {
+            cerr << "Error opening file for writing: " << tmpPath << endl;
+            return false;
+        }
+        const string baseConfig = base->getConfig();
+        out.write(VLAD_MAGIC, sizeof(VLAD_MAGIC));
+        writeValue(out, VERSION);
+        writeValue(out, static_cast<uint32_t>(centreCount));
+        writeValue(out, static_cast<uint32_t>(descriptorDim));
+        writeValue(out, static_cast<uint32_t>(baseConfig.size()));
+        out.write(baseConfig.data(), baseConfig.size());
+        out.write(reinterpret_cast<const char*>(codebook.data()), codebook.size() * sizeof(float));
+        if (!out.good()) {
+            cerr << "[VLADExtractor] Failed writing " << tmpPath << endl;
+            return false;
+        }
+    }
+    error_code ec;
+    filesystem::rename(tmpPath, filePath, ec);
+    if (ec) {
+        cerr << "[VLADExtractor] Cannot move " << tmpPath << " to " << filePath << ": " << ec.message() << endl;
+        return false;
+    }
+    return true;
+}
+
+bool VLADExtractor::loadCodebook(const string& filePath) {
+    ifstream in(filePath, ios::binary);
+    if (!in.is_open()) return false;
+
+    char magic[8];
+    uint32_t version, centres, dim, configLength;
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, VLAD_MAGIC, sizeof(magic)) != 0 ||
+        !readValue(in, version) || version != VERSION || !readValue(in, centres) || !readValue(in, dim) ||
+        !readValue(in, configLength) || configLength > 4096) {
+        cerr << "[VLADExtractor] Invalid codebook: " << filePath << endl;
+        return false;
+    }
+    string baseConfig(configLength, '\0');
+    if (!in.read(&baseConfig[0], configLength)) {
+        cerr << "[VLADExtractor] Truncated codebook: " << filePath << endl;
+        return false;
+    }
+    // Codebook của một cấu hình khác: bỏ qua, sẽ được huấn luyện lại
+    if (centres != centreCount || dim != descriptorDim || baseConfig != base->getConfig()) return false;
+
+    vector<float> centresData(size_t(centres) * dim);
+    if (!in.read(reinterpret_cast<char*>(centresData.data()), centresData.size() * sizeof(float))) {
+        cerr << "[VLADExtractor] Truncated codebook: " << filePath << endl;
+        return false;
+    }
+    codebook = std::move(centresData);
+    codebookHash = fnv1a64(codebook.data(), codebook.size() * sizeof(float));
+    return true;
+}
+
+vector<float> VLADExtractor::extract(const Mat& image) {
+    if (!trained()) throw runtime_error("VLAD codebook is not trained");
+    vector<float> row = base->extract(image);
+    const size_t bytes = base->descriptorBytes();
+    const size_t count = LocalFeature::packedCount(row.data(), row.size(), bytes);
+    const uint8_t* descriptors = LocalFeature::packedDescriptors(row.data());
+
+    // Cộng phần dư x - c vào khối của tâm c gần nhất
+    vector<float> vlad(getFeatureDimension(), 0.0f);
+    vector<float> x(descriptorDim);
+    const DistanceKernels::SquaredL2Fn kernel = DistanceKernels::squaredL2Kernel();
+    for (size_t i = 0; i < count; ++i) {
+        unpackDescriptor(descriptors + i * bytes, x.data());
+        float best = numeric_limits<float>::infinity();
+        size_t bestCentre = 0;
+        for (size_t c = 0; c < centreCount; ++c) {
+            float d = kernel(x.data(), codebook.data() + c * descriptorDim, descriptorDim);
+            if (d < best) {
+                best = d;
+                bestCentre = c;
+            }
+        }
+        float* block = vlad.data() + bestCentre * descriptorDim;
+        const float* centre = codebook.data() + bestCentre * descriptorDim;
+        for (size_t j = 0; j < descriptorDim; ++j) block[j] += x[j] - centre[j];
+    }
+
+    // Chuẩn hóa lũy thừa (căn bậc hai có dấu) rồi chuẩn hóa L2; ảnh không có descriptor: vector 0
+    double norm = 0.0;
+    for (float& v : vlad) {
+        v = v < 0.0f ? -std::sqrt(-v) : std::sqrt(v);
+        norm += double(v) * v;
+    }
+    if (norm > 0.0) {
+        const float scale = static_cast<float>(1.0 / std::sqrt(norm));
+        for (float& v : vlad) v *= scale;
+    }
+    return vlad;
+}
+
+double VLADExtractor::compare(const vector<float>& feat1, const vector<float>& feat2) const {
+    return compareRaw(feat1.data(), feat2.data(), min(feat1.size(), feat2.size()));
+}
+
+double VLADExtractor::compareRaw(const float* feat1, const float* feat2, size_t dim) const {
+    return DistanceKernels::l2(feat1, feat2, dim);
+}
+
+double VLADExtractor::compareBounded(const float* feat1, const float* feat2, size_t dim, double bound) const {
+    return DistanceKernels::l2Bounded(feat1, feat2, dim, bound);
+}
+
+string VLADExtractor::getMethodName() const {
+    return "VLAD_" + base->getMethodName();
+}
+
+string VLADExtractor::getConfig() const {
+    ostringstream oss;
+    oss << "VLAD(k=" << centreCount << ",codebook=" << hex << setw(16) << setfill('0') << codebookHash << ","
+        << base->getConfig() << ")";
+    return oss.str();
+}
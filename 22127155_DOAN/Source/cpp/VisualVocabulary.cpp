@@ -0,0 +1,269 @@
+#include "VisualVocabulary.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+
+using namespace std;
+
+template <typename T>
+static bool readValue(ifstream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+template <typename T>
+static void writeValue(ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+VisualVocabulary::VisualVocabulary()
+    : hammingFn(DistanceKernels::hammingKernel()), l2Fn(DistanceKernels::squaredL2U8Kernel()) {}
+
+void VisualVocabulary::clear() {
+    bytes = 0;
+    branch = 0;
+    levels = 0;
+    wordCount = 0;
+    nodes.clear();
+    centres.clear();
+}
+
+void VisualVocabulary::kmeans(const uint8_t* descriptors, const vector<uint32_t>& members, size_t k, uint32_t seed,
+                              vector<uint8_t>& centreOut, vector<uint32_t>& labels) const {
+    const size_t n = members.size();
+    auto descriptor = [&](size_t i) { return descriptors + size_t(members[i]) * bytes; };
+    centreOut.assign(k * bytes, 0);
+    labels.assign(n, 0);
+
+    // Khởi tạo k-means++: tâm tiếp theo được chọn với xác suất tỉ lệ với d² tới tâm gần nhất
+    mt19937 rng(seed);
+    vector<double> nearest(n, numeric_limits<double>::infinity());
+    vector<uint32_t> d(1);
+    size_t chosen = rng() % n;
+    for (size_t c = 0; c < k; ++c) {
+        memcpy(centreOut.data() + c * bytes, descriptor(chosen), bytes);
+        double total = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            distances(descriptor(i), centreOut.data() + c * bytes, 1, d.data());
+            const double weight = hamming ? double(d[0]) * d[0] : double(d[0]);
+            nearest[i] = min(nearest[i], weight);
+            total += nearest[i];
+        }
+        if (total <= 0.0) {
+            chosen = rng() % n; // mọi điểm đã trùng một tâm
+            continue;
+        }
+        double target = uniform_real_distribution<double>(0.0, total)(rng);
+        chosen = n - 1;
+        for (size_t i = 0; i < n; ++i) {
+            target -= nearest[i];
+            if (target < 0.0) {
+                chosen = i;
+                break;
+            }
+        }
+    }
+
+    // Gán song song (tuần tự nếu đang ở trong một task của pool); trả về số điểm đổi cụm
+    ThreadPool& pool = ThreadPool::shared();
+    auto assign = [&]() {
+        const size_t chunk = 1024;
+        vector<size_t> moved((n + chunk - 1) / chunk, 0);
+        pool.parallelFor(0, moved.size(), [&](size_t block, size_t) {
+            vector<uint32_t> dist(k);
+            for (size_t i = block * chunk; i < min(n, (block + 1) * chunk); ++i) {
+                distances(descriptor(i), centreOut.data(), k, dist.data());
+                uint32_t best = static_cast<uint32_t>(min_element(dist.begin(), dist.end()) - dist.begin());
+                if (best != labels[i]) ++moved[block];
+                labels[i] = best;
+            }
+        });
+        size_t total = 0;
+        for (size_t m : moved) total += m;
+        return total;
+    };
+
+    assign();
+    vector<uint64_t> sums;
+    vector<uint32_t> counts;
+    for (int it = 0; it < KMEANS_ITERATIONS; ++it) {
+        // Tâm mới: trung bình làm tròn (L2) hoặc bit chiếm đa số (Hamming); cụm rỗng giữ tâm cũ
+        const size_t width = hamming ? bytes * 8 : bytes;
+        sums.assign(k * width, 0);
+        counts.assign(k, 0);
+        for (size_t i = 0; i < n; ++i) {
+            const uint8_t* x = descriptor(i);
+            uint64_t* sum = sums.data() + labels[i] * width;
+            ++counts[labels[i]];
+            if (hamming) {
+                for (size_t b = 0; b < width; ++b) sum[b] += (x[b >> 3] >> (b & 7)) & 1u;
+            } else {
+                for (size_t b = 0; b < width; ++b) sum[b] += x[b];
+            }
+        }
+        for (size_t c = 0; c < k; ++c) {
+            if (counts[c] == 0) continue;
+            uint8_t* centre = centreOut.data() + c * bytes;
+            const uint64_t* sum = sums.data() + c * width;
+            if (hamming) {
+                memset(centre, 0, bytes);
+                for (size_t b = 0; b < width; ++b) {
+                    if (2 * sum[b] > counts[c]) centre[b >> 3] |= static_cast<uint8_t>(1u << (b & 7));
+                }
+            } else {
+                for (size_t b = 0; b < width; ++b) centre[b] = static_cast<uint8_t>((sum[b] + counts[c] / 2) / counts[c]);
+            }
+        }
+        if (assign() == 0) break;
+    }
+}
+
+bool VisualVocabulary::train(const uint8_t* descriptors, size_t count, size_t descriptorBytes, bool binary,
+                             size_t branching, size_t depth) {
+    clear();
+    if (!descriptors || count == 0 || descriptorBytes == 0 || branching < 2 || branching > 256 || depth == 0) {
+        return false;
+    }
+    if (binary && descriptorBytes % 8 != 0) {
+        cerr << "[VisualVocabulary] Binary descriptors must be a multiple of 8 bytes" << endl;
+        return false;
+    }
+    bytes = descriptorBytes;
+    hamming = binary;
+    branch = branching;
+    levels = depth;
+
+    // Chia từng tầng: mọi nút của một tầng độc lập với nhau
+    struct Item {
+        uint32_t node;
+        vector<uint32_t> members;
+    };
+    nodes.emplace_back();
+    centres.assign(bytes, 0);
+    vector<Item> items(1);
+    items[0].node = 0;
+    items[0].members.resize(count);
+    for (size_t i = 0; i < count; ++i) items[0].members[i] = static_cast<uint32_t>(i);
+
+    ThreadPool& pool = ThreadPool::shared();
+    for (size_t level = 0; level < depth && !items.empty(); ++level) {
+        vector<vector<uint8_t>> itemCentres(items.size());
+        vector<vector<uint32_t>> itemLabels(items.size());
+        auto split = [&](size_t i, size_t) {
+            if (items[i].members.size() <= branching) return; // quá ít descriptor: thành lá
+            kmeans(descriptors, items[i].members, branching, static_cast<uint32_t>(0xB0C + items[i].node),
+                   itemCentres[i], itemLabels[i]);
+        };
+        // Ít nút (các tầng trên): chia lần lượt, phép gán bên trong k-means chạy song song
+        if (items.size() >= pool.size()) {
+            pool.parallelFor(0, items.size(), split);
+        } else {
+            for (size_t i = 0; i < items.size(); ++i) split(i, 0);
+        }
+
+        vector<Item> next;
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (itemLabels[i].empty()) continue;
+            Node& parent = nodes[items[i].node];
+            parent.firstChild = static_cast<uint32_t>(nodes.size());
+            parent.childCount = static_cast<uint32_t>(branching);
+            const size_t first = next.size();
+            for (size_t c = 0; c < branching; ++c) {
+                next.push_back(Item{static_cast<uint32_t>(nodes.size()), {}});
+                nodes.emplace_back();
+            }
+            centres.insert(centres.end(), itemCentres[i].begin(), itemCentres[i].end());
+            for (size_t m = 0; m < itemLabels[i].size(); ++m) {
+                next[first + itemLabels[i][m]].members.push_back(items[i].members[m]);
+            }
+        }
+        items = std::move(next);
+    }
+
+    for (auto& node : nodes) {
+        if (node.childCount == 0) node.word = static_cast<uint32_t>(wordCount++);
+    }
+    return true;
+}
+
+uint32_t VisualVocabulary::quantize(const uint8_t* descriptor) const {
+    uint32_t dist[256];
+    size_t node = 0;
+    while (nodes[node].childCount > 0) {
+        const Node& current = nodes[node];
+        distances(descriptor, centres.data() + size_t(current.firstChild) * bytes, current.childCount, dist);
+        node = current.firstChild + (min_element(dist, dist + current.childCount) - dist);
+    }
+    return nodes[node].word;
+}
+
+uint32_t VisualVocabulary::descend(const uint8_t* descriptor, uint32_t node, vector<Branch>& pending) const {
+    uint32_t dist[256];
+    while (nodes[node].childCount > 0) {
+        const Node& current = nodes[node];
+        distances(descriptor, centres.data() + size_t(current.firstChild) * bytes, current.childCount, dist);
+        const size_t nearest = min_element(dist, dist + current.childCount) - dist;
+        for (size_t c = 0; c < current.childCount; ++c) {
+            if (c == nearest) continue;
+            pending.emplace_back(dist[c], static_cast<uint32_t>(current.firstChild + c));
+            push_heap(pending.begin(), pending.end(), greater<Branch>());
+        }
+        node = static_cast<uint32_t>(current.firstChild + nearest);
+    }
+    return nodes[node].word;
+}
+
+void VisualVocabulary::write(ofstream& out) const {
+    writeValue(out, static_cast<uint32_t>(bytes));
+    writeValue(out, static_cast<uint32_t>(hamming));
+    writeValue(out, static_cast<uint32_t>(branch));
+    writeValue(out, static_cast<uint32_t>(levels));
+    writeValue(out, static_cast<uint32_t>(nodes.size()));
+    writeValue(out, static_cast<uint32_t>(wordCount));
+    for (const auto& node : nodes) {
+        writeValue(out, node.firstChild);
+        writeValue(out, node.childCount);
+        writeValue(out, node.word);
+    }
+    out.write(reinterpret_cast<const char*>(centres.data()), centres.size());
+}
+
+bool VisualVocabulary::read(ifstream& in) {
+    clear();
+    uint32_t fileBytes, fileHamming, fileBranch, fileDepth, nodeCount, words;
+    if (!readValue(in, fileBytes) || !readValue(in, fileHamming) || !readValue(in, fileBranch) ||
+        !readValue(in, fileDepth) || !readValue(in, nodeCount) || !readValue(in, words) || fileBytes == 0 ||
+        nodeCount == 0 || fileBranch > 256 || (fileHamming && fileBytes % 8 != 0)) {
+        return false;
+    }
+    nodes.resize(nodeCount);
+    for (auto& node : nodes) {
+        if (!readValue(in, node.firstChild) || !readValue(in, node.childCount) || !readValue(in, node.word)) {
+            clear();
+            return false;
+        }
+        // Con phải nằm sau cha (không có chu trình) và trong mảng
+        const size_t self = &node - nodes.data();
+        if ((node.childCount > 0 && (node.childCount > fileBranch || node.firstChild <= self ||
+                                     size_t(node.firstChild) + node.childCount > nodeCount)) ||
+            (node.childCount == 0 && node.word >= words)) {
+            clear();
+            return false;
+        }
+    }
+    centres.resize(size_t(nodeCount) * fileBytes);
+    if (!in.read(reinterpret_cast<char*>(centres.data()), centres.size())) {
+        clear();
+        return false;
+    }
+    bytes = fileBytes;
+    hamming = fileHamming != 0;
+    branch = fileBranch;
+    levels = fileDepth;
+    wordCount = words;
+    return true;
+}
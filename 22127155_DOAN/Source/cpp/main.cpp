@@ -15,6 +15,7 @@
 #include "TextureFeature.h"
 #include "EdgeFeatureExtractor.h"
 #include "CombinedFeature.h"
+#include "VLADExtractor.h"
 
 namespace fs = std::filesystem;
 using namespace cv;
@@ -56,7 +57,7 @@ int main(int argc, char** argv) {
 
     // Create UI elements
     int methodSelection = 0;
-    createTrackbar("Method", "Image Retrieval System", &methodSelection, 7, onTrackbar);
+    createTrackbar("Method", "Image Retrieval System", &methodSelection, 9, onTrackbar);
 
     // Main loop
     while (true) {
@@ -158,6 +159,8 @@ void onTrackbar(int val, void*) {
         case 5: method = "Combined_ColorHist+SIFT"; break;
         case 6: method = "Combined_SIFT+Edge"; break;
         case 7: method = "Combined_ColorHist+SIFT+Edge"; break;
+        case 8: method = "VLAD_SIFT"; break;
+        case 9: method = "VLAD_ORB"; break;
     }
 }
 
@@ -177,6 +180,12 @@ void createDatabase() {
         else if (method == "ORB") {
             extractor = new ORBExtractor(1000); // 500 features
         }
+        else if (method == "VLAD_SIFT") {
+            extractor = new VLADExtractor(make_unique<SIFTExtractor>(500, 3)); // 64 tâm x 128 chiều
+        }
+        else if (method == "VLAD_ORB") {
+            extractor = new VLADExtractor(make_unique<ORBExtractor>(1000)); // 64 tâm x 256 bit
+        }
         else if (method == "Texture_LBP") {
             extractor = new TextureFeature(); // Default constructor
         }
@@ -223,64 +232,44 @@ void createDatabase() {
         // Database file path
         string dbPath = DatabaseManager::getDatabasePath(method, galleryPath);
         
-        // Check if database exists
-        if (fs::exists(dbPath)) {
-            cout << "Loading existing database for method: " << method << endl;
-            if (dbManager) {
-                delete dbManager;
-            }
-            dbManager = new DatabaseManager(extractor);
-            dbManager->loadDatabase(dbPath);
-            cout << "Database loaded successfully with " 
-                 << dbManager->getDatabaseSize() << " entries." << endl;
-        } 
-        else {
-            cout << "Creating new database for method: " << method << endl;
-            
-            // Get all valid image paths from gallery
-            vector<string> imagePaths;
-            int skipped = 0;
-            for (const auto& entry : fs::directory_iterator(galleryPath)) {
-                string path = entry.path().string();
-                
-                // Check if the file is an image
-                string ext = entry.path().extension().string();
-                transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-                
-                if (ext == ".jpg" || ext == ".png" || ext == ".jpeg") {
-                    // Verify the image can be loaded
-                    Mat testImage = imread(path);
-                    if (testImage.empty()) {
-                        cerr << "Warning: Could not read image " << path << " - skipping" << endl;
-                        skipped++;
-                        continue;
-                    }
-                    imagePaths.push_back(path);
-                }
+        if (dbManager) {
+            delete dbManager;
+        }
+        dbManager = new DatabaseManager(extractor);
+
+        // Luôn đối chiếu gallery với manifest của database: chỉ ảnh mới/thay đổi được
+        // trích xuất lại, ảnh đã xóa bị loại khỏi kết quả
+        vector<string> imagePaths;
+        for (const auto& entry : fs::directory_iterator(galleryPath)) {
+            // Check if the file is an image (ảnh không giải mã được sẽ bị pipeline bỏ qua)
+            string ext = entry.path().extension().string();
+            transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+            if (ext == ".jpg" || ext == ".png" || ext == ".jpeg") {
+                imagePaths.push_back(entry.path().string());
             }
+        }
 
-            if (imagePaths.empty()) {
-                throw runtime_error("No valid images found in gallery path: " + galleryPath);
+        if (imagePaths.empty()) {
+            throw runtime_error("No valid images found in gallery path: " + galleryPath);
+        }
+        cout << "Found " << imagePaths.size() << " images in gallery" << endl;
+
+        // VLAD cần codebook trước khi trích xuất: dùng lại codebook cạnh database nếu có
+        if (auto* vlad = dynamic_cast<VLADExtractor*>(extractor)) {
+            string codebookPath = VLADExtractor::codebookPathFor(dbPath);
+            if (!vlad->loadCodebook(codebookPath)) {
+                if (!vlad->train(imagePaths)) {
+                    throw runtime_error("Failed to train VLAD codebook");
+                }
+                vlad->saveCodebook(codebookPath);
             }
+        }
 
-            cout << "Found " << imagePaths.size() << " valid images (" 
-                 << skipped << " files skipped)" << endl;
-
-            // Create and save database
-            if (dbManager) {
-                delete dbManager;
-            }
-            dbManager = new DatabaseManager(extractor);
-            
-            cout << "Building database..." << endl;
-            dbManager->buildDatabase(imagePaths);
-            
-            cout << "Saving database to " << dbPath << endl;
-            dbManager->saveDatabase(dbPath);
-            
-            cout << "Database created successfully with " 
-                 << dbManager->getDatabaseSize() << " entries." << endl;
+        if (!dbManager->updateDatabase(imagePaths, dbPath)) {
+            throw runtime_error("Failed to build database: " + dbPath);
         }
+        cout << "Database ready with " 
+             << dbManager->getDatabaseSize() << " entries." << endl;
     } 
     catch (const exception& e) {
         cerr << "Error in createDatabase(): " << e.what() << endl;
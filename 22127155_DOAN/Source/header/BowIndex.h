@@ -0,0 +1,78 @@
+#ifndef BOW_INDEX_H
+#define BOW_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "DescriptorStore.h"
+#include "TopK.h"
+#include "VisualVocabulary.h"
+
+// Bag-of-visual-words index for local-feature databases (SIFT, ORB).
+// Every image is quantised with a VisualVocabulary into a sparse histogram of words; its tf-idf
+// vector (count x idf, idf = ln(images / images containing the word)) is L2-normalised. An
+// inverted file lists, for every word, the images containing it, so a query only touches the
+// posting lists of its own words and its cost does not grow with the number of images that
+// share none of them. Distance = ||q - x|| between the normalised tf-idf vectors
+// (= sqrt(2 - 2 cos)), in [0, sqrt(2)].
+//
+// File <db>.bow (pathsHash identifies the indexed rows like <db>.pq; only the per-image
+// histograms are stored, the inverted file is rebuilt in memory on load):
+//   [magic "CBIRBOW\0", uint32 version, uint32 reserved, uint64 imageCount, uint64 pathsHash]
+//   [vocabulary (VisualVocabulary::write)]
+//   [image offsets: (imageCount + 1) x uint64][entries: offsets.back() x (uint32 word, uint32 count)]
+class BowIndex {
+public:
+    typedef std::pair<uint32_t, uint32_t> WordCount; // (từ, số lần xuất hiện)
+
+    static constexpr uint32_t VERSION = 1;
+
+    static std::string pathFor(const std::string& dbPath) { return dbPath + ".bow"; }
+
+    // Đặt vocabulary mới và xóa các ảnh đã index
+    void setVocabulary(VisualVocabulary&& trained);
+    const VisualVocabulary& vocabulary() const { return vocab; }
+    // Lượng tử hóa các ảnh [images(), store.images()) của store (song song) rồi dựng lại inverted file
+    void append(const DescriptorStore& store);
+    // Xóa các ảnh, giữ vocabulary (index lại từ đầu sau khi .fdb được ghi lại)
+    void clearImages();
+    void clear();
+
+    bool save(const std::string& filePath, uint64_t pathsHash) const;
+    bool load(const std::string& filePath, uint64_t& pathsHash);
+
+    bool empty() const { return vocab.empty(); }
+    size_t images() const { return imageOffsets.size() - 1; }
+
+    // Histogram thưa (sắp theo từ) của count descriptor nằm liên tiếp
+    void quantize(const uint8_t* descriptors, size_t count, std::vector<WordCount>& histogram) const;
+    // Đẩy các ảnh có chung ít nhất một từ với query vào best. Ảnh có dead[image] != 0 bị bỏ qua.
+    // Không gọi đồng thời từ nhiều luồng.
+    void search(const uint8_t* descriptors, size_t count, const uint8_t* dead, TopK& best) const;
+
+private:
+    struct Posting {
+        uint32_t image;
+        uint32_t count;
+    };
+
+    // idf, norm của các ảnh và danh sách ngược, tính lại từ các histogram
+    void rebuildInvertedFile();
+
+    VisualVocabulary vocab;
+    std::vector<uint64_t> imageOffsets{0}; // ảnh i: entries[imageOffsets[i], imageOffsets[i + 1])
+    std::vector<WordCount> entries;
+    std::vector<float> idf;                // theo từ
+    std::vector<float> inverseNorms;       // 1 / ||tf-idf|| theo ảnh (0: ảnh không có từ nào)
+    std::vector<uint64_t> postingOffsets;  // từ w: postings[postingOffsets[w], postingOffsets[w + 1])
+    std::vector<Posting> postings;
+
+    // Bộ đệm của search()
+    mutable std::vector<WordCount> queryWords;
+    mutable std::vector<float> scores;
+    mutable std::vector<uint32_t> touched;
+};
+
+#endif
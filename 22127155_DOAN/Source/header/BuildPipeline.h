@@ -0,0 +1,70 @@
+#ifndef BUILD_PIPELINE_H
+#define BUILD_PIPELINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include "FeatureExtractor.h"
+#include "FeatureCache.h"
+
+// Multi-stage database build: read -> decode -> extract -> write.
+// The stages run on their own threads and are connected by lock-free bounded queues,
+// so disk I/O and CPU-heavy extraction overlap. A full queue blocks its producer
+// (backpressure) and the reader never runs more than maxInFlight images ahead of the
+// writer, so peak memory is bounded by the queue depth, not by the gallery size.
+class BuildPipeline {
+public:
+    struct Options {
+        size_t decodeThreads = 0;  // 0: tự chọn theo số luồng phần cứng
+        size_t extractThreads = 0; // 0: tự chọn theo số luồng phần cứng
+        size_t queueDepth = 16;
+        FeatureCache* cache = nullptr; // ảnh có trong cache bỏ qua decode và extract
+    };
+
+    // Một ảnh đi qua pipeline
+    struct Item {
+        size_t index = 0;                 // vị trí trong danh sách đường dẫn
+        const std::string* path = nullptr;
+        std::vector<uchar> bytes;         // nội dung file (stage read)
+        uint64_t bytesRead = 0;           // kích thước file
+        uint64_t contentHash = 0;         // FNV-1a của nội dung file (stage read)
+        cv::Mat image;                    // ảnh đã giải mã (stage decode)
+        std::vector<float> features;      // đặc trưng (stage extract)
+        bool cached = false;              // đặc trưng lấy từ FeatureCache
+        std::string error;                // khác rỗng nếu một stage thất bại
+    };
+
+    // Được gọi trên luồng ghi, đúng thứ tự chỉ số của danh sách đường dẫn
+    typedef std::function<void(Item& item)> Sink;
+
+    enum Stage { Read, Decode, Extract, Write, StageCount };
+
+    struct StageStats {
+        std::atomic<uint64_t> items{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> busyNanos{0};    // thời gian làm việc thực sự
+        std::atomic<uint64_t> blockedNanos{0}; // thời gian chờ vì hàng đợi phía sau đầy
+        size_t threads = 1;
+    };
+
+    explicit BuildPipeline(const FeatureExtractor& prototype);
+    BuildPipeline(const FeatureExtractor& prototype, const Options& options);
+
+    void run(const std::vector<std::string>& paths, const Sink& sink);
+
+    const StageStats& stats(Stage stage) const { return stageStats[stage]; }
+    // In thông lượng từng stage và chỉ ra stage nghẽn cổ chai
+    void printStats(std::ostream& out) const;
+
+private:
+    const FeatureExtractor& prototype;
+    Options options;
+    StageStats stageStats[StageCount];
+    double wallSeconds = 0.0;
+};
+
+#endif
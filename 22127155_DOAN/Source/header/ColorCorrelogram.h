@@ -12,11 +12,22 @@ private:
     
 public:
     ColorCorrelogram(int bins = 8, const std::vector<int>& dists = {1, 3, 5}, bool hsv = true);
+    std::unique_ptr<FeatureExtractor> clone() const override {
+        return std::make_unique<ColorCorrelogram>(colorBins, distances, useHSV);
+    }
     
     std::vector<float> extract(const cv::Mat& image) override;
-    double compare(const std::vector<float>& feat1, const std::vector<float>& feat2) override;
+    double compare(const std::vector<float>& feat1, const std::vector<float>& feat2) const override;
+    double compareRaw(const float* feat1, const float* feat2, size_t dim) const override;
+    double compareBounded(const float* feat1, const float* feat2, size_t dim, double bound) const override;
+    bool usesL2Distance() const override { return true; }
     std::string getMethodName() const override { return "ColorCorrelogram"; }
-    size_t getFeatureDimension() const override { return colorBins*3; }
+    std::string getConfig() const override;
+    size_t getFeatureDimension() const override {
+        // Số màu sau lượng tử hóa x số khoảng cách (xem computeAutoCorrelogram)
+        size_t numColors = useHSV ? colorBins * 4 * 4 : colorBins * colorBins * colorBins;
+        return numColors * distances.size();
+    }
 private:
     cv::Mat quantizeImage(const cv::Mat& image);
     void computeAutoCorrelogram(const cv::Mat& quantized, cv::Mat& correlogram);
@@ -10,11 +10,18 @@ private:
     
 public:
     ColorHistogram(int bins = 8, bool hsv = true);
+    std::unique_ptr<FeatureExtractor> clone() const override {
+        return std::make_unique<ColorHistogram>(binsPerChannel, useHSV);
+    }
     
     std::vector<float> extract(const cv::Mat& image) override;
-    double compare(const std::vector<float>& feat1, const std::vector<float>& feat2) override;
+    double compare(const std::vector<float>& feat1, const std::vector<float>& feat2) const override;
+    double compareRaw(const float* feat1, const float* feat2, size_t dim) const override;
+    double compareBounded(const float* feat1, const float* feat2, size_t dim, double bound) const override;
+    bool usesL2Distance() const override { return true; }
     std::string getMethodName() const override { return "ColorHistogram"; }
-    size_t getFeatureDimension() const override { return binsPerChannel * 3; }
+    std::string getConfig() const override;
+    size_t getFeatureDimension() const override { return binsPerChannel * binsPerChannel * binsPerChannel; } // histogram 3D
 private:
     cv::Mat computeHistogram(const cv::Mat& image);
     void normalizeHistogram(cv::Mat& hist);
@@ -9,10 +9,14 @@ class CombinedFeature : public FeatureExtractor {
 public:
     CombinedFeature(std::vector<std::unique_ptr<FeatureExtractor>>&& extractors, 
                    const std::vector<double>& weights);
+    std::unique_ptr<FeatureExtractor> clone() const override;
     
     std::vector<float> extract(const cv::Mat& image) override;
-    double compare(const std::vector<float>& feat1, const std::vector<float>& feat2) override;
+    double compare(const std::vector<float>& feat1, const std::vector<float>& feat2) const override;
+    double compareRaw(const float* feat1, const float* feat2, size_t dim) const override;
+    double compareBounded(const float* feat1, const float* feat2, size_t dim, double bound) const override;
     std::string getMethodName() const override;
+    std::string getConfig() const override;
     size_t getFeatureDimension() const override {
         size_t totalDim = 0;
         for (const auto& dim : featureDims) {
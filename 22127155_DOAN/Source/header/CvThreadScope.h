@@ -0,0 +1,26 @@
+#ifndef CV_THREAD_SCOPE_H
+#define CV_THREAD_SCOPE_H
+
+#include <opencv2/core.hpp>
+
+// Chạy OpenCV đơn luồng trong một phạm vi: các task của ThreadPool đã dùng hết CPU, nên gemm,
+// kmeans, BFMatcher... bên trong mỗi task không được tự chia luồng nữa. Số luồng cũ được khôi
+// phục khi ra khỏi phạm vi, kể cả khi parallelFor ném lại exception của một worker.
+class CvThreadScope {
+public:
+    // enabled = false: không đổi gì (ví dụ khi pool chỉ có một luồng)
+    explicit CvThreadScope(bool enabled = true) : previous(cv::getNumThreads()), active(enabled) {
+        if (active) cv::setNumThreads(1);
+    }
+    ~CvThreadScope() {
+        if (active) cv::setNumThreads(previous);
+    }
+    CvThreadScope(const CvThreadScope&) = delete;
+    CvThreadScope& operator=(const CvThreadScope&) = delete;
+
+private:
+    int previous;
+    bool active;
+};
+
+#endif
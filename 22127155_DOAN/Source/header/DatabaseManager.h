@@ -1,26 +1,272 @@
 #ifndef DATABASE_MANAGER_H
 #define DATABASE_MANAGER_H
 
-#include <map>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <numeric>
 #include "FeatureExtractor.h"
+#include "FeatureMatrix.h"
+#include "FeatureStore.h"
+#include "Manifest.h"
+#include "FeatureCache.h"
+#include "BuildPipeline.h"
+#include "TopK.h"
+#include "IVFIndex.h"
+#include "HNSWIndex.h"
+#include "ProductQuantizer.h"
+#include "ScalarQuantizer.h"
+#include "DistanceKernels.h"
+#include "LocalFeature.h"
+#include "DescriptorStore.h"
+#include "BowIndex.h"
+#include "LSHIndex.h"
+#include "DescriptorIndex.h"
 
 class DatabaseManager {
 private:
-    std::map<std::string, std::vector<float>> featuresDB;
+    FeatureMatrix featuresDB;         // mỗi ảnh một hàng, sở hữu bộ nhớ hoặc view trên mappedDB
+    std::vector<uint32_t> rowPathIds; // hàng i -> id đường dẫn trong pathCatalog
+    PathCatalog pathCatalog;
+    FeatureStoreView mappedDB;        // database mở bằng openDatabase(), không copy vào featuresDB
+    std::string databasePath;         // file .fdb của mappedDB (rỗng: database chỉ trong bộ nhớ)
+    std::vector<uint8_t> deadRows;    // tombstone theo manifest (rỗng: không có hàng chết)
+    size_t deadCount = 0;
+    FeatureCache featureCache;        // cache đặc trưng theo nội dung ảnh, dùng chung giữa các database
+    TopK queryHeap;                   // dùng lại giữa các truy vấn (không cấp phát khi đã ổn định)
+    std::vector<TopK> workerHeaps;    // top-k riêng của từng luồng khi quét song song
+    std::vector<QueryHit> hitBuffer;
+    std::vector<std::vector<TopK>> batchHeaps; // [luồng][query] khi truy vấn theo lô
+    std::vector<float> rowNorms;      // bình phương norm của các hàng, tính khi file không có sẵn
+    ColumnStats columnStats;          // thống kê cột của featuresDB (cộng dồn trong addEntry, hoặc từ file)
+    std::vector<uint32_t> blockOrder; // thứ tự khối chiều theo phương sai giảm dần (quét có ngưỡng)
+    size_t blockOrderRows = 0;        // số hàng lúc tính blockOrder
+    bool varianceOrdering = true;
+    IVFIndex ivfIndex;                // index xấp xỉ (<db>.ivf), rỗng: quét toàn bộ
+    std::vector<uint32_t> probeCells;
+    size_t searchProbes = IVF_DEFAULT_PROBES;
+    HNSWIndex graphIndex;             // đồ thị HNSW (<db>.hnsw), ưu tiên hơn IVF khi có
+    ProductQuantizer pqCodes;         // code PQ của các hàng (<db>.pq), quét thay cho vector đầy đủ
+    std::vector<float> pqTable;       // bảng ADC của query hiện tại
+    ScalarQuantizer sqCodes;          // code float16/int8 của các hàng (<db>.sq), dùng khi không có PQ
+    TopK candidateHeap;               // ứng viên theo khoảng cách trên code nén, trước khi xếp lại
+    std::vector<QueryHit> candidates;
+    bool rerankExact = true;
+    bool indexEnabled = true;
+    bool matrixReleased = false;      // vùng map của ma trận đã được bỏ (xem releaseMatrix)
     FeatureExtractor* extractor;
+    const LocalFeature* localFeature; // extractor nếu là đặc trưng cục bộ (SIFT, ORB), ngược lại nullptr
+    DescriptorStore localDescriptors; // descriptor thật của các hàng (không có phần đệm), tạo khi cần;
+                                      // map từ <db>.dsc khi database là file
+    BowIndex bowIndex;                // từ thị giác + inverted file tf-idf (<db>.bow) cho SIFT/ORB
+    DescriptorIndex descriptorIndex;  // cây k-means trên mọi descriptor, bầu phiếu theo ảnh (<db>.kmt)
+    std::string pendingDescriptorIndex; // <db>.kmt đã nạp, chưa đối chiếu với các hàng (syncDescriptorIndex)
+    uint64_t pendingDescriptorHash = 0;
+    LSHIndex lshIndex;                // bảng băm LSH trên descriptor ORB (trong bộ nhớ, không cần huấn luyện)
+
+    // Tỉ lệ hàng chết tối đa trước khi updateDatabase() nén lại file .fdb
+    static constexpr double COMPACT_DEAD_RATIO = 0.25;
+    // Database nhỏ hơn mức này được quét tuần tự (chi phí chia việc lớn hơn lợi ích)
+    static constexpr size_t PARALLEL_MIN_ROWS = 256;
+    // Kích thước ô khi truy vấn theo lô: một ô hàng (<= 1 MB với 512 chiều) được giữ trong
+    // cache trong khi nhân với từng ô query
+    static constexpr size_t BATCH_ROW_TILE = 512;
+    static constexpr size_t BATCH_QUERY_TILE = 256;
+    static constexpr size_t IVF_DEFAULT_PROBES = 8;
+    // Số ứng viên từ code nén (PQ, SQ) được xếp lại bằng vector đầy đủ, tính theo bội số của k
+    static constexpr size_t RERANK_FACTOR = 4;
+
+    void clearDatabase();
+    bool addEntry(const std::string& path, const std::vector<float>& features);
+    const std::string& rowPath(size_t row) const { return pathCatalog.path(rowPathIds[row]); }
+    size_t databaseDimension() const;
+    // Cờ của file .fdb cho extractor hiện tại (SIFT/ORB: hàng đóng gói)
+    uint32_t storeFlags() const { return localFeature ? FeatureStore::PACKED_ROWS : 0; }
+    // Cấu hình pipeline build, mở cache của extractor hiện tại nếu được
+    BuildPipeline::Options buildOptions();
+    bool isDead(size_t row) const { return !deadRows.empty() && deadRows[row]; }
+    // Truy vấn k kết quả được phép dùng index (bật và k nhỏ hơn số ảnh còn sống)
+    bool indexAllowed(size_t k) const;
+    // queryRows() sẽ thử một index xấp xỉ cho k kết quả
+    bool hasActiveIndex(size_t k) const;
+
+    // Nạp <db>.ivf nếu có (đã build bằng buildIndex()); build lại nếu file .fdb đã đổi
+    void loadIndex(const std::string& filePath);
+    // Nạp <db>.hnsw nếu có: chèn thêm các hàng mới, build lại nếu file .fdb đã được ghi lại
+    void loadGraphIndex(const std::string& filePath);
+    // Nạp <db>.pq nếu có: mã hóa thêm các hàng mới, huấn luyện lại nếu file .fdb đã được ghi lại
+    void loadProductQuantizer(const std::string& filePath);
+    // Nạp <db>.sq nếu có, giống loadProductQuantizer() (giữ nguyên kiểu float16/int8 của file)
+    void loadScalarQuantizer(const std::string& filePath);
+    // Nạp <db>.bow nếu có: lượng tử hóa thêm các ảnh mới, index lại bằng cùng vocabulary nếu file
+    // .fdb đã được ghi lại
+    void loadVocabulary(const std::string& filePath);
+    // Ứng viên theo tf-idf, xếp lại bằng so khớp descriptor nếu rerankExact; false nếu không đủ k ảnh
+    bool searchVocabulary(const float* queryFeatures, size_t dim, size_t k);
+    // Nạp <db>.kmt nếu có. Việc đối chiếu với các hàng cần descriptor của mọi ảnh nên được hoãn tới
+    // truy vấn đặc trưng cục bộ đầu tiên (syncDescriptorIndex)
+    void loadDescriptorIndex(const std::string& filePath);
+    // Chuẩn bị descriptor và xếp thêm các ảnh mới vào cây; với index vừa nạp: index lại bằng cùng cây
+    // nếu file .fdb đã được ghi lại (giống loadVocabulary()), rồi lưu <db>.kmt
+    void syncDescriptorIndex();
+    // Ứng viên theo phiếu của cây descriptor, xếp lại như searchVocabulary()
+    bool searchDescriptorIndex(const float* queryFeatures, size_t dim, size_t k);
+    // Phần chung của các index đặc trưng cục bộ: search(descriptors, count, dead, best) đưa ứng viên
+    // vào best; xếp lại bằng so khớp descriptor nếu rerankExact
+    template <typename Search>
+    bool searchLocalCandidates(const float* queryFeatures, size_t dim, size_t k, const Search& search);
+    // Tối đa maxSamples descriptor cách đều nhau của các ảnh còn sống, nối liền nhau trong samples
+    void sampleDescriptors(size_t maxSamples, std::vector<uint8_t>& samples) const;
+    // Ứng viên theo số phiếu LSH (băm thêm các ảnh mới trước), xếp lại như searchVocabulary()
+    bool searchHashTables(const float* queryFeatures, size_t dim, size_t k);
+    // Mã hóa các hàng chưa có code PQ/SQ (duyệt theo khối, chạy được cả ở chế độ streaming)
+    void appendQuantized();
+    // Truy vấn không đọc ma trận float khi: đặc trưng cục bộ đã có <db>.dsc cho mọi hàng, hoặc code
+    // PQ/SQ phủ mọi hàng, không xếp lại và không có HNSW/IVF. Khi đó bỏ vùng map của ma trận (quét
+    // toàn bộ, nếu cần, đọc tuần tự từ file)
+    void releaseMatrix();
+    // Map lại ma trận đã bỏ bởi releaseMatrix() (xếp lại, build HNSW/IVF cần truy cập ngẫu nhiên)
+    void remapMatrix();
+    // Tối đa maxRows hàng còn sống cách đều nhau của database, nối liền nhau trong samples
+    void sampleRows(size_t maxRows, std::vector<float>& samples) const;
+    // Chọn ứng viên bằng khoảng cách trên code PQ, hoặc SQ nếu không có PQ (trên các cell IVF
+    // nếu có) rồi đưa k kết quả vào queryHeap; false nếu không đủ k ứng viên
+    bool searchQuantized(const float* queryFeatures, size_t dim, size_t k);
+    // Phần chung của searchQuantized(): approx(row) là bình phương khoảng cách xấp xỉ
+    template <typename Approx>
+    bool searchCandidates(const float* queryFeatures, size_t dim, size_t k, const Approx& approx);
+    // FNV-1a của đường dẫn các hàng [0, rows), nhận diện các hàng mà đồ thị đã index
+    uint64_t rowPathsHash(size_t rows) const;
+    // Tìm k ứng viên trong nprobe cell gần nhất; false nếu không đủ k hàng (khi đó quét toàn bộ)
+    bool searchIndex(const float* queryFeatures, size_t dim);
+
+    // Đánh dấu các hàng không có entry nào trong manifest của filePath là đã xóa
+    void loadTombstones(const std::string& filePath);
+    // Ghi lại file .fdb chỉ với các hàng còn sống và đánh số lại hàng trong manifest
+    bool compactDatabase(const std::string& filePath, Manifest& manifest);
+
+    // Duyệt tuần tự các hàng theo khối liên tiếp (bộ nhớ, mmap hoặc streaming)
+    void scanBlocks(const FeatureStoreView::BlockFn& fn) const;
+    // Chép descriptor thật của các hàng chưa có trong localDescriptors (lần đầu: mọi hàng). Database
+    // mở từ file: map <db>.dsc, ghi thêm vào file các hàng mới rồi map lại
+    void prepareDescriptors();
+    // Phần của prepareDescriptors() cho database là file; false nếu không ghi được <db>.dsc
+    bool mapDescriptors();
+    // So khớp query với các ảnh của localDescriptors (mọi ảnh, hoặc chỉ các hàng của subset),
+    // k kết quả vào queryHeap
+    void scanDescriptors(const float* queryFeatures, size_t dim, size_t k, const std::vector<QueryHit>* subset = nullptr);
+    // Bình phương norm L2 của mọi hàng: lấy từ file .fdb (version 2) hoặc tính một lần
+    const std::vector<float>& databaseNorms();
+    // Tính lại blockOrder khi cần (chỉ cho extractor L2 có nhiều hơn một khối) từ thống kê cột đã
+    // lưu lúc build / append; chỉ file .fdb cũ (version 1-2) mới phải quét lại một lần
+    void prepareBlockOrder();
+    // Khoảng cách tới một hàng, +inf nếu chắc chắn lớn hơn bound (dừng sớm)
+    double rowDistance(const float* query, const float* row, size_t dim, double bound) const {
+        if (!blockOrder.empty()) return DistanceKernels::l2Bounded(query, row, dim, bound, blockOrder.data());
+        return extractor->compareBounded(query, row, dim, bound);
+    }
+
+    // Tính khoảng cách từ query tới mọi ảnh trong database, chỉ giữ k ảnh gần nhất
+    // (heap giới hạn, O(N log k)); kết quả sắp xếp theo khoảng cách tăng dần
+    void scanDatabase(const std::vector<float>& queryFeatures, size_t k,
+                      std::vector<std::pair<std::string, double>>& results);
+    int countRelevant(const std::string& queryClass, int datasetType) const;
 public:
     DatabaseManager(FeatureExtractor* extractor);
     ~DatabaseManager();
     
     static std::string getDatabasePath(const std::string& method, const std::string& datasetPath);
     void buildDatabase(const std::vector<std::string>& imagePaths);
+    // Build thẳng ra file: các hàng được ghi dần vào segment có checkpoint, bộ nhớ không tăng
+    // theo số ảnh, và một lần build bị ngắt sẽ tiếp tục từ ảnh đã commit cuối cùng
+    bool buildDatabase(const std::vector<std::string>& imagePaths, const std::string& filePath);
+    // Cập nhật database theo manifest: chỉ trích xuất ảnh mới hoặc đã thay đổi, ảnh đã xóa
+    // thành tombstone và file được nén lại khi quá nhiều hàng chết. Build lại toàn bộ nếu
+    // chưa có database hoặc manifest không khớp.
+    bool updateDatabase(const std::vector<std::string>& imagePaths, const std::string& filePath);
     void saveDatabase(const std::string& filePath);
     bool loadDatabase(const std::string& filePath);
+
+    // Mở database nhị phân chỉ đọc bằng mmap (zero-copy). streaming = true: quét từng khối
+    // từ file thay vì map (database lớn hơn RAM). File CSV cũ được chuyển sang loadDatabase().
+    bool openDatabase(const std::string& filePath, bool streaming = false);
+
+    // Định dạng CSV cũ (chậm), vẫn giữ để đọc database đã tạo trước đây
+    void saveDatabaseCSV(const std::string& filePath);
+    bool loadDatabaseCSV(const std::string& filePath);
     
     std::vector<std::pair<std::string, double>> query(const cv::Mat& queryImage, int topK = 5);
+
+    // Truy vấn theo vector đặc trưng, trả về (hàng, khoảng cách) của k ảnh gần nhất vào hits.
+    // hits và bộ đệm nội bộ được dùng lại, nên ở trạng thái ổn định không có cấp phát heap
+    // (trừ vài task nhỏ cho mỗi khối khi quét song song trên ThreadPool::shared()).
+    // Nếu database có đồ thị HNSW hoặc index IVF thì dùng chúng thay vì quét toàn bộ (kết quả xấp xỉ).
+    // Không gọi đồng thời từ nhiều luồng trên cùng một DatabaseManager.
+    void queryRows(const float* queryFeatures, size_t dimension, size_t k, std::vector<QueryHit>& hits);
+    // Truy vấn theo lô: mỗi khối của database chỉ được đọc một lần cho cả lô thay vì một lần
+    // mỗi query. Với extractor dùng khoảng cách Euclidean (usesL2Distance), khoảng cách được
+    // tính bằng ||q||² + ||x||² - 2q·x với q·x từ cv::gemm trên từng ô hàng x ô query và norm
+    // của database đã tính sẵn lúc build. hits[i] nhận k kết quả của hàng i trong queries.
+    // Khi queryRows() sẽ dùng một index (HNSW, PQ/SQ, IVF, .bow, .kmt, LSH), mỗi query được trả lời
+    // bằng queryRows() để kết quả giống hệt truy vấn đơn; lô chỉ quét gộp khi kết quả là chính xác.
+    void queryBatch(const FeatureMatrix& queries, size_t k, std::vector<std::vector<QueryHit>>& hits);
+    // Trích xuất đặc trưng song song cho các ảnh rồi gọi queryBatch(); ảnh lỗi cho kết quả rỗng
+    std::vector<std::vector<std::pair<std::string, double>>> queryBatch(const std::vector<cv::Mat>& queryImages, int topK = 5);
+    // Build index IVF (k-means ~sqrt(N) cell) cho database đang mở và lưu vào <filePath>.ivf.
+    // Từ đó query()/queryRows() chỉ duyệt searchProbes cell (xấp xỉ); không có .ivf thì quét
+    // toàn bộ (chính xác). .ivf cũ được build lại khi mở nếu file .fdb đã đổi.
+    bool buildIndex(const std::string& filePath);
+    bool hasIndex() const { return !ivfIndex.empty(); }
+    // Build đồ thị HNSW (song song) cho database đang mở và lưu vào <filePath>.hnsw. Từ đó
+    // query()/queryRows() đi qua đồ thị; ảnh mới từ updateDatabase() được chèn thêm khi mở lại.
+    bool buildGraphIndex(const std::string& filePath, const HNSWIndex::Params& params = HNSWIndex::Params());
+    bool hasGraphIndex() const { return !graphIndex.empty(); }
+    // Số ứng viên giữ lại khi tìm trên đồ thị (>= k): lớn hơn thì recall cao hơn và chậm hơn
+    void setSearchEf(size_t ef) { graphIndex.setEfSearch(ef); }
+    // Huấn luyện product quantizer (subspaces byte mỗi ảnh) trên một mẫu của database đang mở,
+    // mã hóa mọi hàng và lưu vào <filePath>.pq. Từ đó truy vấn quét code thay cho vector đầy đủ,
+    // kể cả khi database được mở ở chế độ streaming.
+    bool buildProductQuantizer(const std::string& filePath, size_t subspaces = ProductQuantizer::DEFAULT_SUBSPACES);
+    bool hasProductQuantizer() const { return !pqCodes.empty(); }
+    // Lưu thêm một bản float16 (2 byte/chiều) hoặc int8 (1 byte/chiều, scale/offset theo chiều)
+    // của mọi hàng vào <filePath>.sq. Truy vấn quét bản này bằng kernel SIMD trên dữ liệu nén
+    // (ít hơn 2-4 lần băng thông bộ nhớ) khi database không có code PQ.
+    bool buildScalarQuantizer(const std::string& filePath, ScalarQuantizer::Type type);
+    bool hasScalarQuantizer() const { return !sqCodes.empty(); }
+    // Huấn luyện vocabulary tree (k-means phân cấp, branching^depth từ) trên một mẫu descriptor
+    // SIFT/ORB của database, lượng tử hóa mọi ảnh thành histogram tf-idf và lưu vào <filePath>.bow.
+    // Từ đó truy vấn chỉ duyệt danh sách ngược của các từ trong query thay vì so khớp với mọi ảnh.
+    bool buildVocabulary(const std::string& filePath, size_t branching = VisualVocabulary::DEFAULT_BRANCHING,
+                         size_t depth = VisualVocabulary::DEFAULT_DEPTH);
+    bool hasVocabulary() const { return !bowIndex.empty(); }
+    // Xây cây k-means phân cấp (lá ~DescriptorIndex::LEAF_SIZE descriptor) trên mọi descriptor
+    // SIFT/ORB của database (song song) và lưu vào <filePath>.kmt. Mỗi descriptor query chỉ được so
+    // với các descriptor trong lá của nó; láng giềng gần nhất bầu cho ảnh của nó.
+    bool buildDescriptorIndex(const std::string& filePath, size_t branching = DescriptorIndex::DEFAULT_BRANCHING);
+    bool hasDescriptorIndex() const { return !descriptorIndex.empty(); }
+    // Băm mọi descriptor ORB của database đang mở vào các bảng LSH (không lưu file: dựng lại chỉ
+    // là một lượt băm). Từ đó truy vấn chỉ so khớp đầy đủ các ảnh được nhiều descriptor va chạm bầu
+    // nhất (kết quả xấp xỉ); ảnh mới được băm thêm khi truy vấn. Dùng khi chưa có vocabulary (.bow).
+    bool buildHashIndex(const LSHIndex::Params& params = LSHIndex::Params());
+    bool hasHashIndex() const { return !lshIndex.empty(); }
+    // Xếp lại RERANK_FACTOR * k ứng viên tốt nhất theo code PQ/SQ bằng vector đầy đủ (cần database
+    // được map hoặc nạp vào bộ nhớ), hoặc theo tf-idf/phiếu LSH bằng so khớp descriptor; tắt đi thì khoảng
+    // cách trả về là khoảng cách xấp xỉ
+    void setRerank(bool enabled);
+    // Số cell được duyệt mỗi truy vấn: lớn hơn thì recall cao hơn và chậm hơn
+    void setSearchProbes(size_t nprobe) { searchProbes = std::max<size_t>(1, nprobe); }
+    // Số descriptor gallery được so với mỗi descriptor query trong cây descriptor (<db>.kmt).
+    // Mặc định DescriptorIndex::DEFAULT_CHECKS (4096); thời gian truy vấn tăng gần tuyến tính theo
+    // checks, recall tăng chậm dần (1024: ~3 lần nhanh hơn, bầu đúng ít hơn khoảng 40%)
+    void setDescriptorChecks(size_t checks) { descriptorIndex.setChecks(checks); }
+    // Tắt index để luôn quét toàn bộ (kết quả chính xác)
+    void setIndexEnabled(bool enabled) { indexEnabled = enabled; }
+
+    // Quét có ngưỡng duyệt các khối chiều có phương sai lớn trước (chỉ với khoảng cách L2,
+    // thứ tự không đổi kết quả). Mặc định bật; thứ tự được tính lại khi số hàng thay đổi.
+    void setVarianceOrdering(bool enabled) { varianceOrdering = enabled; blockOrderRows = 0; }
+    // Đường dẫn ảnh của một hàng (chỉ cần tra cho các kết quả cuối cùng)
+    const std::string& getPath(uint32_t row) const { return rowPath(row); }
     
     // Add these new methods
     std::string getExtractorName() const;
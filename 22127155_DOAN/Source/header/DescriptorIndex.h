@@ -0,0 +1,106 @@
+#ifndef DESCRIPTOR_INDEX_H
+#define DESCRIPTOR_INDEX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "DescriptorStore.h"
+#include "TopK.h"
+#include "VisualVocabulary.h"
+
+// Approximate nearest-neighbour index over every local descriptor of a database (SIFT, ORB).
+// A hierarchical k-means tree (VisualVocabulary) is grown until its leaves hold about LEAF_SIZE
+// descriptors, or as deep as its training sample supports; every gallery descriptor is stored in
+// the leaf it quantises to, tagged with its image through the DescriptorStore offsets. A query
+// descriptor walks down to its leaf (branching x depth distances) and is compared exactly with the
+// descriptors there; like FLANN's k-means tree, the branches not taken on the way are kept in a
+// priority queue by distance to their centre and the closest ones are descended next until
+// `checks` gallery descriptors have been compared. A query costs ~ query descriptors x (branching
+// x depth x leaves visited + checks) instead of one full match per gallery image, and a neighbour
+// lying just across a cluster boundary is still found. Its NEIGHBOURS nearest neighbours that are
+// not much farther than the nearest one (d <= d1 / RATIO) vote once for each of their images; the
+// same object seen in several gallery images gets a vote in each of them. Images are ranked by
+// 1 - votes / query descriptors, in [0, 1].
+//
+// File <db>.kmt (pathsHash identifies the indexed rows like <db>.bow; the leaf lists are
+// rebuilt in memory on load):
+//   [magic "CBIRKMT\0", uint32 version, uint32 reserved, uint64 imageCount, uint64 descriptorCount,
+//    uint64 pathsHash][tree (VisualVocabulary::write)]
+//   [image offsets: (imageCount + 1) x uint64][leaves: descriptorCount x uint32]
+class DescriptorIndex {
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t DEFAULT_BRANCHING = 16;
+    // Số descriptor trung bình mỗi lá mà độ sâu của cây hướng tới
+    static constexpr size_t LEAF_SIZE = 128;
+    static constexpr size_t MAX_DEPTH = 6;
+    // Mẫu huấn luyện cây (lớn hơn vocabulary BoW: cây có nhiều lá hơn) và số mẫu trung bình tối thiểu
+    // mỗi lá (k-means của tầng cuối có ít nhất branching x MIN_SAMPLES_PER_LEAF mẫu)
+    static constexpr size_t MAX_TRAIN_DESCRIPTORS = 1000000;
+    static constexpr size_t MIN_SAMPLES_PER_LEAF = 8;
+    // Số láng giềng gần nhất được bầu cho mỗi descriptor query, và chỉ những láng giềng có
+    // d <= d1 / RATIO (d1: láng giềng gần nhất)
+    static constexpr size_t NEIGHBOURS = 5;
+    static constexpr double RATIO = 0.8;
+    // Số descriptor gallery tối thiểu được so với mỗi descriptor query (lá gần nhất được duyệt
+    // trọn, rồi các lá kế tiếp theo hàng đợi ưu tiên cho tới khi đủ). Trên dữ liệu SIFT tổng hợp
+    // khó, ảnh của láng giềng gần nhất thật được bầu ở 100/300 query với 256 checks, 144/300 với
+    // 1024 và 238/300 với 4096 (0.025 / 0.074 / 0.22 ms mỗi descriptor query)
+    static constexpr size_t DEFAULT_CHECKS = 32 * LEAF_SIZE;
+
+    static std::string pathFor(const std::string& dbPath) { return dbPath + ".kmt"; }
+    // Độ sâu để branching^depth lá chứa khoảng LEAF_SIZE descriptor mỗi lá, nhưng không nhiều lá hơn
+    // số mà samples mẫu huấn luyện được (MIN_SAMPLES_PER_LEAF mẫu mỗi lá)
+    static size_t depthFor(size_t descriptors, size_t samples, size_t branching);
+
+    // Đặt cây mới và xóa các descriptor đã index
+    void setTree(VisualVocabulary&& trained);
+    const VisualVocabulary& tree() const { return vocab; }
+    // Xếp các descriptor của ảnh [images(), store.images()) vào lá (song song) rồi dựng lại
+    // danh sách của các lá
+    void append(const DescriptorStore& store);
+    // Xóa các descriptor, giữ cây
+    void clearImages();
+    void clear();
+
+    bool save(const std::string& filePath, uint64_t pathsHash) const;
+    bool load(const std::string& filePath, uint64_t& pathsHash);
+
+    // checks lớn hơn: recall cao hơn và chậm hơn (xem DEFAULT_CHECKS); <= LEAF_SIZE gần như chỉ
+    // duyệt một lá
+    void setChecks(size_t value) { checks = std::max<size_t>(1, value); }
+    size_t searchChecks() const { return checks; }
+
+    bool empty() const { return vocab.empty(); }
+    size_t images() const { return imageOffsets.size() - 1; }
+    size_t size() const { return leafOf.size(); }
+
+    // Bầu phiếu của count descriptor query liên tiếp vào best; store là store đã được index (phải
+    // có cùng các descriptor). Ảnh có dead[image] != 0 bị bỏ qua. Không gọi đồng thời từ nhiều luồng.
+    void search(const uint8_t* descriptors, size_t count, const DescriptorStore& store, const uint8_t* dead,
+                TopK& best) const;
+
+private:
+    // Danh sách descriptor của từng lá (CSR), tính lại từ leafOf
+    void rebuildLeaves();
+
+    VisualVocabulary vocab;
+    std::vector<uint64_t> imageOffsets{0}; // ảnh i: descriptor [imageOffsets[i], imageOffsets[i + 1])
+    std::vector<uint32_t> leafOf;          // lá của từng descriptor
+    std::vector<uint32_t> owners;          // ảnh của từng descriptor
+    std::vector<uint64_t> leafOffsets;     // lá w: members[leafOffsets[w], leafOffsets[w + 1])
+    std::vector<uint32_t> members;
+    DistanceKernels::HammingFn hammingFn = DistanceKernels::hammingKernel();
+    DistanceKernels::SquaredL2U8Fn l2Fn = DistanceKernels::squaredL2U8Kernel();
+    size_t checks = DEFAULT_CHECKS;
+
+    // Bộ đệm của search()
+    mutable std::vector<uint32_t> votes;
+    mutable std::vector<uint32_t> voteStamp; // theo ảnh: descriptor query cuối cùng đã bầu (+1)
+    mutable std::vector<uint32_t> touched;
+    mutable std::vector<VisualVocabulary::Branch> pending; // hàng đợi ưu tiên các nhánh chưa duyệt
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef DESCRIPTOR_STORE_H
+#define DESCRIPTOR_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+// Ragged store of the local descriptors (SIFT, ORB) of every image in a database.
+// Database rows are packed (LocalFeature::packDescriptors) and reserve room for nFeatures
+// descriptors; this store keeps only the real ones, back to back as uint8: image i owns
+// descriptors [offset(i), offset(i) + count(i)). Matching a query against the store never
+// touches the padding of the rows, and every descriptor has a global index (with its owning
+// image) for structures built over all gallery descriptors.
+//
+// The store lives either in memory (appendRow) or in a mapped file <db>.dsc written by
+// DescriptorStoreWriter, so a mapped database does not keep a heap copy of its descriptors
+// (pathsHash identifies the stored rows like <db>.bow):
+//   [magic "CBIRDSC\0", uint32 version, uint32 descriptorBytes, uint64 imageCount,
+//    uint64 descriptorCount, uint64 pathsHash, zero padding up to 64 bytes]
+//   [descriptors: descriptorCount x descriptorBytes]
+//   [zero padding up to a multiple of 8][image offsets: (imageCount + 1) x uint64]
+class DescriptorStore {
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t HEADER_SIZE = 64;
+
+    static std::string pathFor(const std::string& dbPath) { return dbPath + ".dsc"; }
+
+    DescriptorStore() { clear(); }
+    DescriptorStore(const DescriptorStore&) = delete;
+    DescriptorStore& operator=(const DescriptorStore&) = delete;
+
+    // Xóa dữ liệu (bỏ map nếu có) và đặt số byte của một descriptor
+    void reset(size_t descriptorBytes);
+    void clear() { reset(0); }
+    void reserve(size_t images, size_t descriptors);
+    // Nối các descriptor thật của một hàng đóng gói dim phần tử thành ảnh tiếp theo
+    // (store đang map được chép vào bộ nhớ trước)
+    void appendRow(const float* row, size_t dim);
+    // Map file <db>.dsc thay cho dữ liệu trong bộ nhớ; false (store rỗng) nếu file không hợp lệ
+    // hoặc có descriptor khác descriptorBytes
+    bool map(const std::string& filePath, size_t descriptorBytes, uint64_t& pathsHash);
+    bool isMapped() const { return file.isOpen(); }
+
+    size_t descriptorBytes() const { return bytes; }
+    size_t images() const { return imageCount; }
+    size_t size() const { return static_cast<size_t>(offsetData[imageCount]); } // tổng số descriptor
+    bool empty() const { return images() == 0; }
+    size_t offset(size_t image) const { return static_cast<size_t>(offsetData[image]); }
+    size_t count(size_t image) const { return static_cast<size_t>(offsetData[image + 1] - offsetData[image]); }
+    const uint8_t* descriptors(size_t image) const { return descriptorData + offset(image) * bytes; }
+    const uint8_t* descriptor(size_t index) const { return descriptorData + index * bytes; }
+    // Ảnh sở hữu descriptor thứ index (tìm nhị phân trên offsets)
+    uint32_t imageOf(size_t index) const;
+    // Bộ nhớ heap (store đang map: chỉ page cache, không tính)
+    size_t memoryBytes() const { return data.size() + offsets.size() * sizeof(uint64_t); }
+
+private:
+    // Trỏ offsetData/descriptorData vào các vector trong bộ nhớ
+    void syncPointers();
+
+    size_t bytes = 0;
+    std::vector<uint64_t> offsets; // images + 1 phần tử, offsets[0] = 0
+    std::vector<uint8_t> data;     // size() x bytes
+    MappedFile file;
+    // Dữ liệu đang dùng: các vector ở trên, hoặc vùng map của file
+    const uint64_t* offsetData = nullptr;
+    const uint8_t* descriptorData = nullptr;
+    size_t imageCount = 0;
+};
+
+// Streaming writer of <db>.dsc: descriptors are written straight to <filePath>.tmp, only the
+// image offsets are kept in memory; close() appends them, rewrites the header and renames the
+// file over filePath. A writer destroyed before close() removes the .tmp file.
+class DescriptorStoreWriter {
+public:
+    DescriptorStoreWriter() = default;
+    ~DescriptorStoreWriter();
+
+    bool open(const std::string& filePath, size_t descriptorBytes);
+    // Chép mọi ảnh của store (ví dụ file .dsc cũ đang map) thành các ảnh tiếp theo
+    bool append(const DescriptorStore& store);
+    bool appendRow(const float* row, size_t dim);
+    bool close(uint64_t pathsHash);
+
+    size_t images() const { return offsets.size() - 1; }
+
+private:
+    std::ofstream out;
+    std::string filePath;
+    size_t bytes = 0;
+    std::vector<uint64_t> offsets{0};
+};
+
+#endif
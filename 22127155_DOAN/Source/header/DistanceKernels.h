@@ -0,0 +1,79 @@
+#ifndef DISTANCE_KERNELS_H
+#define DISTANCE_KERNELS_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Vectorised distance kernels for fixed-length (global) descriptors.
+// The best instruction set supported by the CPU and OS (AVX-512, AVX2+FMA+F16C, SSE4.2 or
+// plain scalar code) is detected once at first use; the CBIR_SIMD environment variable
+// (scalar, sse4.2, avx2, avx512) can force a lower level for testing. Every level has
+// fully unrolled versions for the dimensions our extractors produce (8, 384, 512) and for
+// the 64-float blocks of the early-abandoning kernel.
+class DistanceKernels {
+public:
+    enum Isa { Scalar, SSE42, AVX2, AVX512 };
+
+    typedef float (*SquaredL2Fn)(const float* a, const float* b, size_t dim);
+
+    // Mức ISA đang dùng
+    static Isa isa();
+    static const char* isaName(Isa isa);
+
+    // Hàm kernel đã chọn, dùng trực tiếp trong vòng lặp nóng để tránh tra cứu mỗi lần gọi
+    static SquaredL2Fn squaredL2Kernel();
+
+    // Tổng bình phương hiệu, tích lũy float32 trên nhiều thanh ghi
+    static float squaredL2(const float* a, const float* b, size_t dim) { return squaredL2Kernel()(a, b, dim); }
+
+    // Khoảng cách Euclidean
+    static double l2(const float* a, const float* b, size_t dim) { return std::sqrt(static_cast<double>(squaredL2(a, b, dim))); }
+
+    // Số phần tử của một khối trong squaredL2Bounded (4 cache line); ngưỡng được kiểm tra sau mỗi khối
+    static constexpr size_t BOUND_BLOCK = 64;
+
+    // Như squaredL2 nhưng dừng ngay khi tổng riêng phần vượt boundSquared và trả về +inf
+    // (khoảng cách thật khi đó chắc chắn lớn hơn ngưỡng). blockOrder, nếu có, là thứ tự duyệt
+    // các khối BOUND_BLOCK phần tử, ví dụ theo phương sai giảm dần để dừng sớm hơn.
+    static float squaredL2Bounded(const float* a, const float* b, size_t dim, float boundSquared,
+                                  const uint32_t* blockOrder = nullptr);
+
+    // Khoảng cách Euclidean có ngưỡng: +inf nếu chắc chắn lớn hơn bound
+    static double l2Bounded(const float* a, const float* b, size_t dim, double bound,
+                            const uint32_t* blockOrder = nullptr) {
+        return std::sqrt(static_cast<double>(squaredL2Bounded(a, b, dim, static_cast<float>(bound * bound), blockOrder)));
+    }
+
+    // Bình phương norm L2, tích lũy double (dùng cho ||a||² + ||b||² - 2a·b, nơi sai số bị khuếch đại)
+    static float squaredNorm(const float* a, size_t dim);
+
+    // Hàng đã lượng tử hóa vô hướng (ScalarQuantizer), query vẫn là float32. Hàng float16 được
+    // đổi bằng F16C, hàng byte được giải mã x = offset + scale * code theo từng chiều ngay trong
+    // thanh ghi, nên chỉ 2 hoặc 1 byte mỗi chiều được đọc từ bộ nhớ.
+    typedef float (*SquaredL2HalfFn)(const float* query, const uint16_t* row, size_t dim);
+    typedef float (*SquaredL2ByteFn)(const float* query, const uint8_t* row, const float* scale,
+                                     const float* offset, size_t dim);
+    static SquaredL2HalfFn squaredL2HalfKernel();
+    static SquaredL2ByteFn squaredL2ByteKernel();
+
+    // Khoảng cách Hamming từ descriptor nhị phân query tới count descriptor nằm liên tiếp trong
+    // rows (mỗi cái bytes byte, bytes là bội số của 8): out[i] = số bit khác nhau. Dùng VPOPCNTDQ
+    // nếu CPU có (AVX-512), bảng nibble vpshufb (AVX2) hoặc lệnh popcnt.
+    typedef void (*HammingFn)(const uint8_t* query, const uint8_t* rows, size_t count, size_t bytes, uint32_t* out);
+    static HammingFn hammingKernel();
+
+    // Bình phương khoảng cách Euclidean từ descriptor uint8 query (SIFT) tới count descriptor nằm
+    // liên tiếp trong rows, tính bằng số nguyên (chính xác): out[i] = sum (query - row_i)²
+    typedef void (*SquaredL2U8Fn)(const uint8_t* query, const uint8_t* rows, size_t count, size_t bytes, uint32_t* out);
+    static SquaredL2U8Fn squaredL2U8Kernel();
+
+    // Kernel của một mức cụ thể (nullptr nếu không được biên dịch cho nền tảng này)
+    static SquaredL2Fn squaredL2Kernel(Isa isa);
+    static SquaredL2HalfFn squaredL2HalfKernel(Isa isa);
+    static SquaredL2ByteFn squaredL2ByteKernel(Isa isa);
+    static HammingFn hammingKernel(Isa isa);
+    static SquaredL2U8Fn squaredL2U8Kernel(Isa isa);
+};
+
+#endif
@@ -10,10 +10,17 @@ class EdgeFeatureExtractor : public FeatureExtractor {
 public:
     EdgeFeatureExtractor(double threshold1 = 100, double threshold2 = 200)
         : thresh1(threshold1), thresh2(threshold2) {}
+    std::unique_ptr<FeatureExtractor> clone() const override {
+        return std::make_unique<EdgeFeatureExtractor>(thresh1, thresh2);
+    }
 
     std::vector<float> extract(const cv::Mat& image) override;
-    double compare(const std::vector<float>& feat1, const std::vector<float>& feat2) override;
+    double compare(const std::vector<float>& feat1, const std::vector<float>& feat2) const override;
+    double compareRaw(const float* feat1, const float* feat2, size_t dim) const override;
+    double compareBounded(const float* feat1, const float* feat2, size_t dim, double bound) const override;
+    bool usesL2Distance() const override { return true; }
     std::string getMethodName() const override { return "Edge_Canny"; }
+    std::string getConfig() const override;
     size_t getFeatureDimension() const override { return 8; } // 2 bins: non-edge, edge
 
 private:
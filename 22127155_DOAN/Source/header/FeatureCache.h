@@ -0,0 +1,66 @@
+#ifndef FEATURE_CACHE_H
+#define FEATURE_CACHE_H
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Content-addressed feature cache shared by every database built on this machine.
+// Features are keyed by (content hash, byte size) of the image file, so moving a gallery
+// or building an overlapping one never extracts the same bytes twice. Each extractor
+// config has its own append-only pack file:
+//
+//   build/cache/<config fingerprint>/features.pack
+//   [magic "CBIRFCA\0", uint32 version, uint32 configLength, config]
+//   [records: uint64 hash, uint64 size, uint32 count, count x float32]
+//
+// A record cut short by a crash is dropped when the pack is opened. Thread-safe.
+class FeatureCache {
+public:
+    static constexpr uint32_t VERSION = 1;
+
+    static std::string defaultDirectory() { return "build/cache"; }
+
+    FeatureCache() = default;
+    FeatureCache(const FeatureCache&) = delete;
+    FeatureCache& operator=(const FeatureCache&) = delete;
+
+    // Mở (hoặc tạo) pack của config trong thư mục cache và nạp chỉ mục vào bộ nhớ
+    bool open(const std::string& directory, const std::string& config);
+    void close();
+    bool isOpen() const { return pack.is_open(); }
+
+    bool lookup(uint64_t contentHash, uint64_t size, std::vector<float>& features);
+    void insert(uint64_t contentHash, uint64_t size, const std::vector<float>& features);
+
+    size_t entries() const { return index.size(); }
+    size_t hits() const { return hitCount; }
+
+private:
+    struct Key {
+        uint64_t hash;
+        uint64_t size;
+        bool operator==(const Key& other) const { return hash == other.hash && size == other.size; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const { return static_cast<size_t>(key.hash ^ (key.size * 0x9E3779B97F4A7C15ULL)); }
+    };
+    struct Location {
+        uint64_t offset; // vị trí của các float
+        uint32_t count;
+    };
+
+    bool loadIndex(uint64_t fileSize);
+
+    std::mutex cacheMutex;
+    std::fstream pack;
+    std::string packPath;
+    uint64_t packSize = 0;
+    std::unordered_map<Key, Location, KeyHash> index;
+    size_t hitCount = 0;
+};
+
+#endif
@@ -2,21 +2,44 @@
 #define FEATURE_EXTRACTOR_H
 
 #include <opencv2/opencv.hpp>
+#include <memory>
 #include <vector>
 #include <string>
 
 class FeatureExtractor {
 public:
     virtual ~FeatureExtractor() = default;
+
+    // Tạo một bản sao độc lập (cùng cấu hình) để mỗi luồng dùng riêng, vì extract() có trạng thái
+    virtual std::unique_ptr<FeatureExtractor> clone() const = 0;
     
     // Phương thức trừu tượng để trích xuất đặc trưng
     virtual std::vector<float> extract(const cv::Mat& image) = 0;
     
-    // Phương thức tính toán khoảng cách giữa 2 đặc trưng
-    virtual double compare(const std::vector<float>& feat1, const std::vector<float>& feat2) = 0;
+    // Phương thức tính toán khoảng cách giữa 2 đặc trưng.
+    // compare/compareRaw là const và không có trạng thái: được gọi đồng thời từ nhiều luồng khi quét database
+    virtual double compare(const std::vector<float>& feat1, const std::vector<float>& feat2) const = 0;
+
+    // So sánh trực tiếp trên hai hàng dim phần tử (không copy vào vector), dùng khi quét database.
+    // Mặc định copy vào vector rồi gọi compare(); các extractor nên override.
+    virtual double compareRaw(const float* feat1, const float* feat2, size_t dim) const;
+
+    // Như compareRaw() nhưng được phép dừng sớm và trả về +inf khi khoảng cách chắc chắn lớn
+    // hơn bound (ví dụ khoảng cách của ứng viên thứ k hiện tại). Kết quả nhỏ hơn hoặc bằng
+    // bound luôn là khoảng cách đầy đủ. Mặc định không dừng sớm.
+    virtual double compareBounded(const float* feat1, const float* feat2, size_t dim, double /*bound*/) const {
+        return compareRaw(feat1, feat2, dim);
+    }
+
+    // true nếu compareRaw() là khoảng cách Euclidean thuần trên toàn vector: khi đó truy vấn
+    // theo lô có thể tính ||a||² + ||b||² - 2a·b bằng phép nhân ma trận (xem queryBatch)
+    virtual bool usesL2Distance() const { return false; }
     
     // Lấy tên phương pháp trích xuất (dùng cho header CSV)
     virtual std::string getMethodName() const = 0;
+
+    // Chuỗi mô tả cấu hình extractor (tên + tham số), lưu trong header của database nhị phân
+    virtual std::string getConfig() const { return getMethodName(); }
     
     // Chuyển đặc trưng thành string để lưu vào CSV
     virtual std::string featuresToString(const std::vector<float>& features);
@@ -0,0 +1,72 @@
+#ifndef FEATURE_MATRIX_H
+#define FEATURE_MATRIX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Row-major float matrix with a fixed stride, stored in one 64-byte-aligned buffer.
+// The matrix either owns its buffer or is a view over external memory (e.g. a mapped file).
+class FeatureMatrix {
+public:
+    static const size_t ALIGNMENT = 64;
+
+    FeatureMatrix() = default;
+    ~FeatureMatrix();
+    FeatureMatrix(const FeatureMatrix&) = delete;
+    FeatureMatrix& operator=(const FeatureMatrix&) = delete;
+    FeatureMatrix(FeatureMatrix&& other) noexcept;
+    FeatureMatrix& operator=(FeatureMatrix&& other) noexcept;
+
+    // Xóa dữ liệu và đặt lại số chiều của mỗi hàng
+    void reset(size_t dimension);
+    void clear() { reset(0); }
+    void reserve(size_t rows);
+    // Đổi số hàng; các hàng mới chưa được khởi tạo (dùng trước khi đọc bulk vào data())
+    void resize(size_t rows);
+    size_t append(const float* features);
+
+    // Bọc vùng nhớ ngoài, không copy; vùng nhớ phải sống lâu hơn matrix
+    void setView(const float* data, size_t rows, size_t dimension);
+    bool isView() const { return view != nullptr; }
+
+    size_t rows() const { return rowCount; }
+    size_t dimension() const { return stride; }
+    bool empty() const { return rowCount == 0; }
+    const float* data() const { return view ? view : buffer; }
+    float* mutableData() { return buffer; }
+    const float* row(size_t i) const { return data() + i * stride; }
+    float* mutableRow(size_t i) { return buffer + i * stride; }
+
+private:
+    void release();
+
+    float* buffer = nullptr;
+    const float* view = nullptr;
+    size_t stride = 0;
+    size_t rowCount = 0;
+    size_t capacity = 0;
+};
+
+// Interned image paths: each path is stored once and has a dense uint32 id.
+class PathCatalog {
+public:
+    uint32_t intern(const std::string& path);
+    bool find(const std::string& path, uint32_t& id) const;
+    const std::string& path(uint32_t id) const { return paths[id]; }
+    size_t size() const { return paths.size(); }
+    void clear();
+
+    // Thay toàn bộ catalog bằng danh sách có sẵn (id = vị trí trong danh sách)
+    void assign(std::vector<std::string>&& list);
+
+private:
+    std::deque<std::string> paths; // deque: địa chỉ các string không đổi khi thêm phần tử
+    std::unordered_map<std::string_view, uint32_t> ids;
+};
+
+#endif
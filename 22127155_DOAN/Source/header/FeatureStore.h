@@ -0,0 +1,176 @@
+#ifndef FEATURE_STORE_H
+#define FEATURE_STORE_H
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+#include "FeatureMatrix.h"
+#include "MappedFile.h"
+
+// Binary feature database (.fdb)
+//
+//   [FeatureStoreHeader, 64 bytes]
+//   [extractor config string, configLength bytes]
+//   [padding up to a 64-byte boundary]
+//   [feature matrix: rowCount x dimension float32, row-major]
+//   [row norms: rowCount x float32 squared L2 norm]          (version 2+)
+//   [column statistics: dimension x float64 sums, then dimension x float64 sums of squares]
+//                                                           (version 3+, right after the norms)
+//   [path table: rowCount x (uint32 length + UTF-8 bytes)]
+//
+// The norms, column statistics and path table are kept at the end so rows can be appended
+// without moving the matrix. Version 1 files have no norms block (normsOffset == 0) and
+// version 1-2 files no column statistics; both are still readable.
+// Files with the PACKED_ROWS flag hold packed local descriptors (LocalFeature::packDescriptors):
+// their floats are raw bytes, so the norms and column statistics are written as zeros and
+// never read back.
+// All integers are stored little-endian (native on every platform we build for).
+struct FeatureStoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t dimension;
+    uint64_t rowCount;
+    uint64_t matrixOffset;
+    uint64_t pathTableOffset;
+    uint64_t pathTableSize;
+    uint32_t configLength;
+    uint32_t flags;                // FeatureStore::PACKED_ROWS (0 trong các file cũ)
+    uint64_t normsOffset;
+};
+static_assert(sizeof(FeatureStoreHeader) == 64, "FeatureStoreHeader must stay 64 bytes");
+
+// Tổng và tổng bình phương của từng cột (chiều) trên các hàng, cộng dồn khi ghi hàng
+struct ColumnStats {
+    std::vector<double> sums;
+    std::vector<double> squares;
+    uint64_t rows = 0;
+
+    void reset(size_t dimension);
+    void add(const float* row);
+    double variance(size_t column) const;
+};
+
+class FeatureStore {
+public:
+    static const uint32_t VERSION = 3;
+    static const size_t ALIGNMENT = 64;
+    // Các hàng là descriptor đóng gói, không phải vector float: không có norm / thống kê cột
+    static const uint32_t PACKED_ROWS = 1;
+
+    // Kiểm tra file có phải định dạng nhị phân hay không (dựa vào magic)
+    static bool isFeatureStore(const std::string& filePath);
+
+    // Đọc header và chuỗi cấu hình extractor; false nếu các vùng (ma trận, norm, thống kê cột,
+    // bảng đường dẫn) mà header mô tả không nằm trọn trong file
+    static bool readHeader(std::ifstream& in, FeatureStoreHeader& header, std::string& config);
+    // Kiểm tra các vùng của header so với kích thước file (không tràn số)
+    static bool validLayout(const FeatureStoreHeader& header, uint64_t fileSize);
+
+    // Đọc toàn bộ file: ma trận được đọc một lần (bulk read). stats rỗng (rows == 0) với file
+    // version 1-2 và PACKED_ROWS
+    static bool read(const std::string& filePath, FeatureStoreHeader& header, std::string& config,
+                     std::vector<std::string>& paths, FeatureMatrix& matrix, ColumnStats& stats);
+
+    // Đọc khối thống kê cột (file version 3+); false nếu file không có hoặc bị cắt cụt. File
+    // PACKED_ROWS: true, stats rỗng
+    static bool readColumnStats(std::ifstream& in, const FeatureStoreHeader& header, ColumnStats& stats);
+
+    // Tách bảng đường dẫn (uint32 length + bytes) thành danh sách string
+    static bool parsePathTable(const char* table, size_t tableSize, uint64_t rowCount,
+                               std::vector<std::string>& paths);
+
+    static uint64_t alignUp(uint64_t value) { return (value + ALIGNMENT - 1) & ~uint64_t(ALIGNMENT - 1); }
+};
+
+// Streaming writer: rows are written straight to disk and the row norms and path table are
+// spooled to temporary files, so memory use does not grow with the number of rows. Column
+// statistics are accumulated in memory (O(dimension)). close() appends all three and rewrites
+// the header.
+class FeatureStoreWriter {
+public:
+    FeatureStoreWriter() = default;
+    ~FeatureStoreWriter();
+
+    // flags: FeatureStore::PACKED_ROWS khi các hàng là descriptor đóng gói
+    bool open(const std::string& filePath, const std::string& config, size_t dimension, uint32_t flags = 0);
+    // Mở file đã có để ghi thêm hàng. File gốc không bị sửa: header và ma trận được chép sang
+    // <filePath>.tmp, các hàng mới ghi tiếp vào đó, norm và bảng đường dẫn cũ được chép sang file
+    // tạm; close() hoàn tất file .tmp, fsync rồi mới đổi tên đè lên file gốc. Writer bị hủy trước
+    // close() (ví dụ khi append ném lỗi) thì bỏ file .tmp, database cũ còn nguyên.
+    // Cái giá: mỗi lần append chép lại toàn bộ ma trận (I/O tỉ lệ với kích thước database, không
+    // chỉ với số hàng mới), vì norm và bảng đường dẫn nằm ngay sau ma trận nên không thể ghi đè
+    // tại chỗ mà vẫn an toàn khi crash.
+    // (file version 1-2 được tính norm / thống kê cột từ ma trận và nâng lên version hiện tại;
+    // flags được giữ nguyên)
+    bool openAppend(const std::string& filePath, const std::string& config, size_t dimension);
+    bool append(const std::string& path, const float* features);
+    bool close();
+
+    size_t rows() const { return rowCount; }
+    size_t dimension() const { return header.dimension; }
+
+private:
+    // Đóng và xóa file đang ghi cùng các file tạm (chế độ append: file gốc không đổi)
+    void abandon();
+
+    std::ofstream out;
+    std::ofstream pathsOut; // bảng đường dẫn tạm thời (filePath + ".paths")
+    std::ofstream normsOut; // norm của các hàng tạm thời (filePath + ".norms")
+    std::string filePath;   // file đang ghi
+    std::string targetPath; // chế độ append: file gốc, được thay bằng filePath khi close()
+    FeatureStoreHeader header{};
+    size_t rowCount = 0;
+    bool packed = false;    // FeatureStore::PACKED_ROWS: norm = 0, không cộng thống kê cột
+    ColumnStats stats;
+};
+
+// Read-only view of a feature store that does not copy the feature matrix.
+// Mapped mode serves rows straight from the page cache; streaming mode (used when
+// the file cannot be mapped or is larger than RAM) reads the matrix block by block.
+class FeatureStoreView {
+public:
+    typedef std::function<void(size_t firstRow, size_t count, const float* block)> BlockFn;
+
+    // Bảng đường dẫn được trả về qua paths (hàng i <-> paths[i]), view không giữ lại
+    bool open(const std::string& filePath, std::vector<std::string>& paths, bool streaming = false);
+    void close();
+    // Bỏ / map lại vùng map của ma trận; khi không map, scanBlocks() đọc tuần tự từ file
+    void unmap();
+    bool map();
+
+    bool isOpen() const { return !filePath.empty(); }
+    bool isMapped() const { return file.isOpen(); }
+    size_t rows() const { return header.rowCount; }
+    size_t dimension() const { return header.dimension; }
+    uint32_t flags() const { return header.flags; }
+    const std::string& config() const { return configString; }
+
+    // Con trỏ tới ma trận trong vùng map, nullptr ở chế độ streaming
+    const float* matrixData() const {
+        return isMapped() ? reinterpret_cast<const float*>(file.data() + header.matrixOffset) : nullptr;
+    }
+
+    // Bình phương norm L2 của từng hàng, tính sẵn lúc build (rỗng với file version 1 và PACKED_ROWS)
+    const std::vector<float>& norms() const { return rowNorms; }
+    // Thống kê cột tính sẵn lúc build / append (rows == 0 với file version 1-2 và PACKED_ROWS)
+    const ColumnStats& columnStats() const { return stats; }
+
+    // Duyệt ma trận theo khối liên tiếp, mỗi khối khoảng blockBytes
+    void scanBlocks(const BlockFn& fn, size_t blockBytes = DEFAULT_BLOCK_BYTES) const;
+
+    static const size_t DEFAULT_BLOCK_BYTES = size_t(32) << 20;
+
+private:
+    std::string filePath;
+    std::string configString;
+    FeatureStoreHeader header{};
+    MappedFile file;
+    bool dropBehind = false;                // bỏ các trang đã duyệt khi file lớn hơn RAM
+    std::vector<float> rowNorms;
+    ColumnStats stats;
+    mutable std::vector<float> blockBuffer; // buffer dùng lại cho chế độ streaming
+};
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef FILE_SYNC_H
+#define FILE_SYNC_H
+
+#include <cstdio>
+#include <string>
+
+// Đẩy dữ liệu xuống đĩa trước các thao tác rename "thay nguyên tử": rename chỉ bền vững sau khi
+// nội dung file mới đã được fsync, và chính rename chỉ bền vững sau khi thư mục được fsync.
+class FileSync {
+public:
+    // fflush rồi fsync một FILE* đang mở (fflush chỉ đẩy vào page cache)
+    static bool syncFile(FILE* file);
+    // fsync một file đã đóng (ví dụ file vừa ghi bằng ofstream)
+    static bool syncPath(const std::string& filePath);
+    // fsync thư mục để rename/xóa trong đó cũng bền vững (không cần trên Windows)
+    static void syncDirectory(const std::string& dir);
+    // Thư mục chứa filePath ("." nếu không có)
+    static std::string parentDirectory(const std::string& filePath);
+};
+
+#endif
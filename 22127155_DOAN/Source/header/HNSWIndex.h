@@ -0,0 +1,114 @@
+#ifndef HNSW_INDEX_H
+#define HNSW_INDEX_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "TopK.h"
+
+// Hierarchical Navigable Small World graph over the rows of a feature store.
+// Every row is a node. Layer 0 links each node to at most 2*M neighbours; a node also appears
+// on layers 1..level (level ~ -ln(U)/ln(M)) with at most M links each, which gives a short
+// coarse-to-fine path to the query's neighbourhood. A query descends greedily through the upper
+// layers and then runs a best-first search keeping efSearch candidates on layer 0.
+// Distances are Euclidean and the vectors stay in the .fdb matrix, so the graph only applies to
+// extractors with usesL2Distance().
+//
+// File <db>.hnsw (pathsHash: FNV-1a of the paths of the indexed rows; rows appended to the
+// .fdb later are inserted incrementally, a rewritten .fdb forces a rebuild):
+//   [magic "CBIRHNSW", uint32 version, uint32 dimension, uint64 rowCount, uint32 M,
+//    uint32 efConstruction, uint32 entryPoint, int32 maxLevel, uint64 pathsHash]
+//   [levels: rowCount x uint8]
+//   [layer 0: rowCount x (uint32 count + 2M uint32)]
+//   [layers 1..level of every node with level > 0: level x (uint32 count + M uint32)]
+class HNSWIndex {
+public:
+    struct Params {
+        size_t M = 16;               // số cạnh mỗi node ở các tầng trên (tầng 0: 2M)
+        size_t efConstruction = 200; // số ứng viên khi chèn: lớn hơn thì đồ thị tốt hơn, build chậm hơn
+    };
+
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t DEFAULT_EF_SEARCH = 64;
+
+    static std::string pathFor(const std::string& dbPath) { return dbPath + ".hnsw"; }
+
+    HNSWIndex();
+
+    // Build đồ thị cho rows hàng của data (rows x dimension), chèn song song trên ThreadPool::shared().
+    // data phải sống lâu hơn index (vùng map của .fdb hoặc ma trận trong bộ nhớ).
+    bool build(const float* data, size_t rows, size_t dimension, const Params& params);
+    // Chèn thêm các hàng [size(), rows) của data (ví dụ ảnh mới được append vào .fdb)
+    bool extend(const float* data, size_t rows);
+    // Gắn lại ma trận sau khi file được map lại (số hàng đã index không đổi)
+    void attach(const float* data) { vectors = data; }
+
+    bool save(const std::string& filePath, uint64_t pathsHash) const;
+    bool load(const std::string& filePath, size_t dimension, uint64_t& pathsHash);
+    void clear();
+
+    bool empty() const { return levels.empty(); }
+    size_t size() const { return levels.size(); }
+    const Params& params() const { return config; }
+    void setEfSearch(size_t ef) { efSearch = ef > 0 ? ef : 1; }
+
+    // Đẩy các node gần query nhất vào best (khoảng cách Euclidean). Hàng có dead[row] != 0 vẫn
+    // được đi qua nhưng không được trả về. Không gọi đồng thời từ nhiều luồng.
+    void search(const float* query, size_t k, const uint8_t* dead, TopK& best) const;
+
+private:
+    typedef std::pair<float, uint32_t> Candidate; // (bình phương khoảng cách, node)
+
+    // Đánh dấu node đã thăm theo "thế hệ", reset O(1) giữa các lần tìm
+    struct VisitedList {
+        std::vector<uint16_t> marks;
+        uint16_t epoch = 0;
+        void reset(size_t nodes);
+        bool visit(uint32_t node) {
+            if (marks[node] == epoch) return false;
+            marks[node] = epoch;
+            return true;
+        }
+    };
+
+    static constexpr uint32_t NO_NODE = 0xFFFFFFFFu;
+    static constexpr int MAX_LEVEL = 15;
+    static constexpr size_t LOCK_STRIPES = 4096;
+
+    float distance(const float* query, uint32_t node) const;
+    const float* row(uint32_t node) const { return vectors + size_t(node) * dim; }
+    uint32_t* links(uint32_t node, int layer);
+    const uint32_t* links(uint32_t node, int layer) const;
+    std::mutex& nodeLock(uint32_t node) const { return locks[node % LOCK_STRIPES]; }
+
+    int randomLevel(uint32_t node) const;
+    void allocate(size_t first, size_t rows);
+    void insertRange(size_t first, size_t last);
+    void insert(uint32_t node, size_t worker);
+    uint32_t greedyDescend(const float* query, uint32_t entry, int fromLayer, int toLayer, bool locked) const;
+    // Best-first search trên một tầng; trả về tối đa ef node gần nhất (max-heap theo khoảng cách)
+    std::vector<Candidate> searchLayer(const float* query, uint32_t entry, size_t ef, int layer,
+                                       size_t worker, bool locked, const uint8_t* dead) const;
+    // Heuristic chọn cạnh đa dạng hướng: bỏ ứng viên gần một cạnh đã chọn hơn là gần node
+    void selectNeighbours(std::vector<Candidate>& sorted, size_t maxCount) const;
+    void connect(uint32_t node, const std::vector<Candidate>& neighbours, int layer);
+
+    Params config;
+    size_t dim = 0;
+    size_t maxLinks0 = 0;            // 2M
+    size_t efSearch = DEFAULT_EF_SEARCH;
+    const float* vectors = nullptr;
+    std::vector<uint8_t> levels;
+    std::vector<uint32_t> links0;    // node i: [count, 2M id] tại i * (2M + 1)
+    std::vector<std::vector<uint32_t>> upperLinks; // node i: level x [count, M id]
+    uint32_t entryPoint = NO_NODE;
+    int maxLevel = -1;
+    std::mutex entryLock;            // giữ khi một node mới có thể trở thành entry point
+    std::unique_ptr<std::mutex[]> locks;
+    mutable std::vector<VisitedList> visited; // một danh sách cho mỗi luồng của ThreadPool
+};
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// FNV-1a 64-bit, đủ nhanh cho chuỗi cấu hình, danh sách đường dẫn...
+inline uint64_t fnv1a64(const void* data, size_t size, uint64_t hash = 1469598103934665603ULL) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+inline uint64_t fnv1a64(const std::string& text, uint64_t hash = 1469598103934665603ULL) {
+    return fnv1a64(text.data(), text.size(), hash);
+}
+
+#endif
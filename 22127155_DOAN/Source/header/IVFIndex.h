@@ -0,0 +1,60 @@
+#ifndef IVF_INDEX_H
+#define IVF_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Inverted-file (IVF) index over the rows of a feature store.
+// A k-means coarse quantiser splits the rows into listCount cells; a query only visits the
+// rows of the nprobe cells whose centroids are closest to it. Lists hold row ids, the vectors
+// themselves stay in the .fdb matrix. Distances are Euclidean, so the index only applies to
+// extractors with usesL2Distance().
+//
+// File <db>.ivf (sourceSize/sourceMtime identify the .fdb the index was built from):
+//   [magic "CBIRIVF\0", uint32 version, uint32 dimension, uint64 rowCount, uint32 listCount,
+//    uint32 reserved, uint64 sourceSize, int64 sourceMtime]
+//   [centroids: listCount x dimension float32]
+//   [list offsets: (listCount + 1) x uint64]
+//   [row ids: rowCount x uint32]
+class IVFIndex {
+public:
+    static constexpr uint32_t VERSION = 1;
+    // Số mẫu huấn luyện k-means cho mỗi cell và số vòng lặp tối đa
+    static constexpr size_t TRAIN_ROWS_PER_LIST = 32;
+    static constexpr int KMEANS_ITERATIONS = 10;
+
+    static std::string pathFor(const std::string& dbPath) { return dbPath + ".ivf"; }
+    // Số cell mặc định ~ sqrt(rows): mỗi cell khoảng sqrt(rows) hàng
+    static size_t defaultListCount(size_t rows);
+
+    // Huấn luyện trên một mẫu đều các hàng rồi gán mọi hàng vào cell gần nhất (song song)
+    bool build(const float* data, size_t rows, size_t dimension, size_t listCount);
+    bool save(const std::string& filePath, uint64_t sourceSize, int64_t sourceMtime) const;
+    // Chỉ nhận file khớp với database hiện tại (số hàng, số chiều, size + mtime của .fdb)
+    bool load(const std::string& filePath, size_t rows, size_t dimension, uint64_t sourceSize, int64_t sourceMtime);
+    void clear();
+
+    bool empty() const { return listCount == 0; }
+    size_t lists() const { return listCount; }
+    size_t dimension() const { return dim; }
+
+    // nprobe cell có centroid gần query nhất, gần nhất trước (dùng lại dung lượng của cells).
+    // Không gọi đồng thời từ nhiều luồng.
+    void probe(const float* query, size_t nprobe, std::vector<uint32_t>& cells) const;
+    const uint32_t* listRows(size_t cell) const { return rowIds.data() + offsets[cell]; }
+    size_t listSize(size_t cell) const { return static_cast<size_t>(offsets[cell + 1] - offsets[cell]); }
+
+private:
+    size_t dim = 0;
+    size_t listCount = 0;
+    std::vector<float> centroids;  // listCount x dim
+    std::vector<uint64_t> offsets; // list i: rowIds[offsets[i], offsets[i + 1])
+    std::vector<uint32_t> rowIds;
+
+    // Bộ đệm của probe(): (khoảng cách, cell) của mọi cell, dùng lại giữa các truy vấn
+    mutable std::vector<std::pair<float, uint32_t>> ranked;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef LSH_INDEX_H
+#define LSH_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "DescriptorStore.h"
+#include "DistanceKernels.h"
+#include "TopK.h"
+
+// Multi-table locality-sensitive hashing over binary descriptors (ORB, 256 bit).
+// Every table hashes a descriptor to the keyBits bits found at keyBits random positions (bit
+// sampling, the LSH family of the Hamming distance), so two descriptors that differ in few bits
+// collide in at least one of the tables with high probability. Nothing is trained: building
+// is one hashing pass over the gallery descriptors, and new images are hashed incrementally.
+//
+// A query descriptor looks up its bucket in every table; colliding gallery descriptors within
+// maxDistance bits vote once for their image. Images are ranked by votes (distance =
+// 1 - votes / query descriptors, in [0, 1]); the caller re-matches the top-voted ones.
+// Buckets are stored as CSR per table: descriptor indices of the DescriptorStore, sorted by key.
+// Keys are not kept: rebuilding the buckets hashes the descriptors of the store again.
+class LSHIndex {
+public:
+    struct Params {
+        size_t tables = 8;
+        size_t keyBits = 16;      // 2^keyBits bucket mỗi bảng
+        uint32_t maxDistance = 64; // descriptor va chạm xa hơn (bit) không được bầu
+        uint32_t seed = 0x15A7;
+    };
+    static constexpr size_t MAX_KEY_BITS = 24;
+
+    LSHIndex();
+
+    // Chọn vị trí bit cho các bảng và xóa dữ liệu; false nếu tham số không hợp lệ
+    bool setup(size_t descriptorBytes, const Params& params);
+    // Băm các descriptor của ảnh [images(), store.images()) (song song) rồi dựng lại các bucket.
+    // store phải là cùng store đã được append trước đó (chỉ được nối thêm ảnh).
+    void append(const DescriptorStore& store);
+    // Xóa các ảnh, giữ vị trí bit
+    void clearImages();
+    void clear();
+
+    bool empty() const { return tableCount == 0; }
+    size_t images() const { return imageCount; }
+    size_t descriptorBytes() const { return bytes; }
+
+    // Đếm phiếu của count descriptor query liên tiếp; store là store đã được index (để kiểm tra
+    // khoảng cách). Ảnh có dead[image] != 0 bị bỏ qua. Không gọi đồng thời từ nhiều luồng.
+    void search(const uint8_t* descriptors, size_t count, const DescriptorStore& store, const uint8_t* dead,
+                TopK& best) const;
+
+private:
+    uint32_t hashKey(const uint8_t* descriptor, size_t table) const;
+    // Dựng lại CSR của mọi bảng, băm lại các descriptor của store
+    void rebuildBuckets(const DescriptorStore& store);
+
+    size_t bytes = 0;
+    size_t tableCount = 0;
+    size_t keyBits = 0;
+    uint32_t maxDistance = 0;
+    std::vector<uint16_t> bitPositions;      // tables x keyBits vị trí bit
+    size_t imageCount = 0;
+    std::vector<uint32_t> owners;            // ảnh của từng descriptor
+    std::vector<uint32_t> bucketOffsets;     // tables x (2^keyBits + 1)
+    std::vector<uint32_t> entries;           // tables x descriptor, chỉ số descriptor theo bucket
+    DistanceKernels::HammingFn hammingFn;
+
+    // Bộ đệm của search()
+    mutable std::vector<uint32_t> seenStamp;  // theo descriptor
+    mutable std::vector<uint32_t> voteStamp;  // theo ảnh: descriptor query cuối cùng đã bầu
+    mutable std::vector<uint32_t> votes;
+    mutable std::vector<uint32_t> touched;
+    mutable uint32_t stamp = 0;
+};
+
+#endif
@@ -3,6 +3,8 @@
 
 #include "FeatureExtractor.h"
 #include <opencv2/features2d.hpp>
+#include <cstdint>
+#include <memory>
 
 class LocalFeature : public FeatureExtractor {
 protected:
@@ -10,9 +12,44 @@ protected:
     
 public:
     std::vector<float> extract(const cv::Mat& image) override;
-    
+
+    // So khớp hai hàng đóng gói: chỉ các descriptor thật của mỗi hàng được dùng
+    double compare(const std::vector<float>& feat1, const std::vector<float>& feat2) const override;
+    double compareRaw(const float* feat1, const float* feat2, size_t dim) const override;
+
+    // Số byte của một descriptor trong hàng đóng gói (ORB 32, SIFT 128)
+    virtual size_t descriptorBytes() const = 0;
+    // Descriptor nhị phân so bằng khoảng cách Hamming (ORB); ngược lại Euclidean trên các byte (SIFT)
+    virtual bool binaryDescriptors() const { return false; }
+    // Khoảng cách giữa hai tập n1, n2 descriptor nằm liên tiếp (không cần hàng đóng gói,
+    // dùng trực tiếp trên DescriptorStore). const, gọi đồng thời được từ nhiều luồng.
+    virtual double matchDescriptors(const uint8_t* desc1, size_t n1, const uint8_t* desc2, size_t n2) const = 0;
+
+    // Một query được so với nhiều ảnh: phần chuẩn bị phía query (đổi kiểu, norm...) chỉ làm một lần
+    class PreparedQuery {
+    public:
+        virtual ~PreparedQuery() = default;
+        // Như matchDescriptors(query, desc2), gọi đồng thời được từ nhiều luồng
+        virtual double match(const uint8_t* desc2, size_t n2) const = 0;
+    };
+    // Mặc định chỉ giữ con trỏ tới descriptors (phải còn sống) và gọi matchDescriptors()
+    virtual std::unique_ptr<PreparedQuery> prepareQuery(const uint8_t* descriptors, size_t count) const;
+
+    // Hàng đặc trưng "đóng gói" cho descriptor byte (CV_8U): phần tử 0 là số descriptor thật,
+    // tiếp theo là các byte descriptor nằm liên tiếp (4 byte trong mỗi float, chỉ được copy, không
+    // tính toán trên giá trị float), phần còn lại của hàng là 0. So khớp đọc thẳng các byte và chỉ
+    // chạy trên count descriptor, không chuyển đổi kiểu mỗi lần so sánh.
+    static size_t packedDimension(size_t maxDescriptors, size_t descriptorBytes) {
+        return 1 + (maxDescriptors * descriptorBytes + sizeof(float) - 1) / sizeof(float);
+    }
+    // Tối đa maxDescriptors hàng đầu của descriptors (CV_8U, descriptorBytes cột); Mat rỗng: count = 0
+    static std::vector<float> packDescriptors(const cv::Mat& descriptors, size_t maxDescriptors, size_t descriptorBytes);
+    // Số descriptor của một hàng dim phần tử (giới hạn bởi dung lượng của hàng nếu dữ liệu hỏng)
+    static size_t packedCount(const float* row, size_t dim, size_t descriptorBytes);
+    static const uint8_t* packedDescriptors(const float* row) { return reinterpret_cast<const uint8_t*>(row + 1); }
+
 protected:
     virtual cv::Mat computeDescriptors(const cv::Mat& image);
 };
 
-#endif
\ No newline at end of file
+#endif
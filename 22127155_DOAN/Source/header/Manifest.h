@@ -0,0 +1,53 @@
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per-database manifest (<db>.manifest): one entry per gallery file with its size,
+// modification time, content hash and the .fdb row holding its features. Rows of the
+// .fdb that no entry points to are tombstones (deleted or replaced images).
+//
+//   [magic "CBIRMAN\0", uint32 version, uint32 reserved, uint64 rowCount, uint64 entryCount]
+//   [entryCount x (uint32 length + path, uint64 size, int64 mtime, uint64 hash, uint32 row)]
+struct ManifestEntry {
+    std::string path;
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    uint64_t contentHash = 0; // 0: chưa biết (ví dụ ảnh được commit trước khi build resume)
+    uint32_t row = 0;
+};
+
+class Manifest {
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t NO_ROW = 0xFFFFFFFFu; // ảnh lỗi, không có hàng trong .fdb
+
+    static std::string pathFor(const std::string& dbPath) { return dbPath + ".manifest"; }
+
+    bool load(const std::string& filePath);
+    // Ghi file tạm rồi rename, manifest cũ vẫn nguyên vẹn nếu bị ngắt giữa chừng
+    bool save(const std::string& filePath) const;
+
+    // Các entry luôn được sắp xếp theo path
+    const std::vector<ManifestEntry>& entries() const { return items; }
+    void assign(std::vector<ManifestEntry>&& list);
+    const ManifestEntry* find(const std::string& path) const;
+
+    // Số hàng của file .fdb tương ứng (kể cả tombstone)
+    uint64_t rowCount() const { return rows; }
+    void setRowCount(uint64_t count) { rows = count; }
+    size_t liveRows() const;
+
+    // Kích thước và thời điểm sửa đổi của file trên đĩa
+    static bool statFile(const std::string& path, uint64_t& size, int64_t& mtime);
+    // Hash nội dung file (FNV-1a 64), false nếu không đọc được
+    static bool hashFile(const std::string& path, uint64_t& hash);
+
+private:
+    std::vector<ManifestEntry> items;
+    uint64_t rows = 0;
+};
+
+#endif
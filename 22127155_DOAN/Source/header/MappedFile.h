@@ -0,0 +1,39 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file (mmap on POSIX, MapViewOfFile on Windows).
+class MappedFile {
+public:
+    enum Advice { Normal, Sequential, Random, WillNeed, DontNeed };
+
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& filePath);
+    void close();
+
+    bool isOpen() const { return base != nullptr; }
+    const char* data() const { return static_cast<const char*>(base); }
+    size_t size() const { return length; }
+
+    // Gợi ý cho kernel về cách truy cập vùng [offset, offset + bytes) (madvise / PrefetchVirtualMemory)
+    void advise(size_t offset, size_t bytes, Advice advice) const;
+
+    // Tổng RAM vật lý của máy, 0 nếu không xác định được
+    static size_t physicalMemory();
+
+private:
+    void* base = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+#endif
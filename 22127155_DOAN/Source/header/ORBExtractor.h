@@ -8,10 +8,21 @@
 class ORBExtractor : public LocalFeature {
 public:
     ORBExtractor(int nFeatures = 1000);
+    std::unique_ptr<FeatureExtractor> clone() const override {
+        return std::make_unique<ORBExtractor>(nFeatures);
+    }
     std::vector<float> extract(const cv::Mat& image) override;
     std::string getMethodName() const override;  
-    double compare(const std::vector<float>& feat1, const std::vector<float>& feat2) override;
-    size_t getFeatureDimension() const override { return 32 * nFeatures; } // 32 là chiều descriptor ORB mặc định
+    std::string getConfig() const override;
+    // Hàng đóng gói: số descriptor + nFeatures x 32 byte (8 float mỗi descriptor thay vì 32)
+    size_t getFeatureDimension() const override { return packedDimension(nFeatures, DESCRIPTOR_BYTES); }
+
+    size_t descriptorBytes() const override { return DESCRIPTOR_BYTES; }
+    bool binaryDescriptors() const override { return true; }
+    // Khoảng cách Hamming trung bình (/32) của các cặp khớp chéo (crossCheck), 9999 nếu không có
+    double matchDescriptors(const uint8_t* desc1, size_t n1, const uint8_t* desc2, size_t n2) const override;
+
+    static constexpr size_t DESCRIPTOR_BYTES = 32; // descriptor ORB 256 bit
 protected:
     cv::Mat computeDescriptors(const cv::Mat& image) override;
 private:
@@ -0,0 +1,71 @@
+#ifndef PRODUCT_QUANTIZER_H
+#define PRODUCT_QUANTIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Product quantisation of feature rows into compact codes.
+// The dimensions are split into `subspaces` contiguous groups; each group has its own k-means
+// codebook of 256 centroids, so a row is stored as one byte per subspace (64 bytes instead of
+// 2 KB for a 512-float histogram). A query builds a table of squared distances from each of
+// its sub-vectors to every centroid once; the distance to a coded row is then one table lookup
+// per subspace (asymmetric distance computation). Distances approximate squared Euclidean
+// distance, so codes only apply to extractors with usesL2Distance().
+//
+// File <db>.pq (pathsHash identifies the coded rows like <db>.hnsw):
+//   [magic "CBIRPQ\0\0", uint32 version, uint32 dimension, uint32 subspaces, uint32 reserved,
+//    uint64 rowCount, uint64 pathsHash]
+//   [codebooks: for each subspace, 256 x subspace-width float32]
+//   [codes: rowCount x subspaces uint8]
+class ProductQuantizer {
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t CENTROIDS = 256;
+    static constexpr size_t DEFAULT_SUBSPACES = 64;
+    // Số hàng mẫu tối đa để huấn luyện codebook
+    static constexpr size_t MAX_TRAIN_ROWS = 32768;
+    static constexpr int KMEANS_ITERATIONS = 15;
+
+    static std::string pathFor(const std::string& dbPath) { return dbPath + ".pq"; }
+
+    // Huấn luyện codebook trên sampleRows hàng mẫu (cần ít nhất 256 hàng), xóa các code cũ.
+    // Số subspace bị giới hạn bởi số chiều; các subspace có độ rộng chênh nhau tối đa 1.
+    bool train(const float* samples, size_t sampleRows, size_t dimension, size_t subspaces);
+    // Mã hóa count hàng (song song trên ThreadPool::shared()) và nối vào cuối
+    void append(const float* rows, size_t count);
+
+    bool save(const std::string& filePath, uint64_t pathsHash) const;
+    bool load(const std::string& filePath, size_t dimension, uint64_t& pathsHash);
+    void clear();
+
+    bool empty() const { return subspaceCount == 0; }
+    size_t rows() const { return subspaceCount ? codes.size() / subspaceCount : 0; }
+    size_t subspaces() const { return subspaceCount; }
+    const uint8_t* code(size_t row) const { return codes.data() + row * subspaceCount; }
+
+    // Bảng ADC của query: subspaces x 256 bình phương khoảng cách (dùng lại dung lượng của table)
+    void computeTable(const float* query, std::vector<float>& table) const;
+    // Bình phương khoảng cách xấp xỉ từ query (qua bảng của nó) tới một hàng đã mã hóa
+    float distance(const float* table, size_t row) const {
+        const uint8_t* c = code(row);
+        float sum = 0.0f;
+        for (size_t j = 0; j < subspaceCount; ++j) sum += table[j * CENTROIDS + c[j]];
+        return sum;
+    }
+
+private:
+    size_t subspaceBegin(size_t j) const { return j * dim / subspaceCount; }
+    const float* centroid(size_t j, size_t c) const {
+        return codebooks.data() + CENTROIDS * subspaceBegin(j) + c * (subspaceBegin(j + 1) - subspaceBegin(j));
+    }
+    void encode(const float* row, uint8_t* out) const;
+
+    size_t dim = 0;
+    size_t subspaceCount = 0;
+    std::vector<float> codebooks; // subspace j: 256 x width(j) tại 256 * subspaceBegin(j)
+    std::vector<uint8_t> codes;   // rows x subspaces
+};
+
+#endif
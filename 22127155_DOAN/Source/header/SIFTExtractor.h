@@ -2,6 +2,7 @@
 #define SIFT_EXTRACTOR_H
 
 #include "LocalFeature.h"
+#include "SIFTMatcher.h"
 #include <opencv2/features2d.hpp>
 
 class SIFTExtractor : public LocalFeature {
@@ -9,12 +10,24 @@ public:
     SIFTExtractor(int nFeatures = 0, int nOctaveLayers = 3, 
                  double contrastThreshold = 0.04, double edgeThreshold = 10, 
                  double sigma = 1.6);
+    std::unique_ptr<FeatureExtractor> clone() const override {
+        return std::make_unique<SIFTExtractor>(nFeatures, nOctaveLayers, contrastThreshold, edgeThreshold, sigma);
+    }
 
     
     std::vector<float> extract(const cv::Mat& image) override;
     std::string getMethodName() const override;
-    double compare(const std::vector<float>& feat1, const std::vector<float>& feat2) override;
-    size_t getFeatureDimension() const override { return 128 * nFeatures; } // 128 là chiều descriptor SIFT
+    std::string getConfig() const override;
+    // Hàng đóng gói: số descriptor + nFeatures x 128 byte (giá trị SIFT nằm trong 0..255)
+    size_t getFeatureDimension() const override { return packedDimension(nFeatures, DESCRIPTOR_BYTES); }
+
+    size_t descriptorBytes() const override { return DESCRIPTOR_BYTES; }
+    // So khớp bằng SIFTMatcher (GEMM, ratio test, mutual NN); xem SIFTMatcher::match()
+    double matchDescriptors(const uint8_t* desc1, size_t n1, const uint8_t* desc2, size_t n2) const override;
+    // Descriptor query được đổi sang float32 và tính norm một lần cho mọi ảnh của database
+    std::unique_ptr<PreparedQuery> prepareQuery(const uint8_t* descriptors, size_t count) const override;
+
+    static constexpr size_t DESCRIPTOR_BYTES = 128;
     
 protected:
     cv::Mat computeDescriptors(const cv::Mat& image) override;
@@ -0,0 +1,41 @@
+#ifndef SIFT_MATCHER_H
+#define SIFT_MATCHER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <opencv2/core.hpp>
+
+// So khớp tập descriptor SIFT (uint8, 128 chiều) của một query với descriptor của nhiều ảnh.
+// Ma trận khoảng cách được tính theo ô bằng cv::gemm: ||q - x||² = ||q||² + ||x||² - 2 q·x, với
+// query đã đổi sang float32 và norm của nó chỉ tính một lần trong setQuery(). Giá trị descriptor là
+// số nguyên 0..255 nên mọi tích vô hướng và norm đều là số nguyên < 2^24: khoảng cách chính xác.
+// Trong cùng một lượt qua mỗi ô: láng giềng gần nhất và gần nhì của mỗi descriptor query, và
+// descriptor query gần nhất của mỗi descriptor ảnh. Một cặp được giữ nếu qua ratio test của Lowe
+// (d1 < ratio * d2) và là láng giềng gần nhất của nhau (mutual NN).
+class SIFTMatcher {
+public:
+    static constexpr size_t DESCRIPTOR_BYTES = 128;
+    static constexpr float DEFAULT_RATIO = 0.8f;
+    // Khoảng cách tính cho descriptor query không có cặp (norm của descriptor SIFT là ~512)
+    static constexpr double REJECT_DISTANCE = 512.0;
+    // Số descriptor query mỗi ô: ô khoảng cách QUERY_TILE x n2 float nằm trong cache L2
+    static constexpr size_t QUERY_TILE = 64;
+
+    explicit SIFTMatcher(float ratio = DEFAULT_RATIO) : ratio(ratio) {}
+
+    void setQuery(const uint8_t* descriptors, size_t count);
+    size_t queryCount() const { return queryNorms.size(); }
+
+    // Khoảng cách (0..1) từ query tới count descriptor của một ảnh: trung bình trên các descriptor
+    // query của khoảng cách tới cặp đã giữ, hoặc REJECT_DISTANCE nếu không có cặp, chia cho 512.
+    // 9999 nếu một trong hai tập rỗng. const, gọi đồng thời được (bộ đệm riêng của mỗi luồng).
+    double match(const uint8_t* descriptors, size_t count) const;
+
+private:
+    float ratio;
+    cv::Mat query;                 // queryCount() x 128 float32
+    std::vector<float> queryNorms; // bình phương norm của từng descriptor query
+};
+
+#endif
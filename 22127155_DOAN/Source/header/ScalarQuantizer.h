@@ -0,0 +1,68 @@
+#ifndef SCALAR_QUANTIZER_H
+#define SCALAR_QUANTIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "DistanceKernels.h"
+
+// Scalar quantisation of feature rows: every dimension is stored on its own in fewer bits.
+// Float16 keeps each value as an IEEE half float (2 bytes, relative error ~5e-4, no training).
+// Int8 maps dimension j linearly from [min_j, max_j] of a training sample onto 0..255
+// (1 byte, x ~ offset_j + scale_j * code; values outside the range are clamped).
+// Unlike PQ there is no per-query table: the DistanceKernels half/byte kernels decode the codes
+// in registers and compare them with the float32 query, so a scan reads 2x or 4x fewer bytes
+// than the .fdb matrix. Distances approximate squared Euclidean distance (usesL2Distance()).
+//
+// File <db>.sq (pathsHash identifies the coded rows like <db>.pq):
+//   [magic "CBIRSQ\0\0", uint32 version, uint32 dimension, uint32 type, uint32 reserved,
+//    uint64 rowCount, uint64 pathsHash]
+//   [scale: dimension float32][offset: dimension float32]
+//   [codes: rowCount x dimension x (uint16 half | uint8)]
+class ScalarQuantizer {
+public:
+    enum Type : uint32_t { Float16 = 1, Int8 = 2 };
+
+    static constexpr uint32_t VERSION = 1;
+    // Số hàng mẫu tối đa để tìm khoảng giá trị của từng chiều (Int8)
+    static constexpr size_t MAX_TRAIN_ROWS = 65536;
+
+    static std::string pathFor(const std::string& dbPath) { return dbPath + ".sq"; }
+    static const char* typeName(Type type) { return type == Int8 ? "int8" : "float16"; }
+
+    ScalarQuantizer();
+
+    // Chọn kiểu lưu và xóa các code cũ. Int8 lấy min/max từng chiều trên sampleRows hàng mẫu;
+    // Float16 không cần mẫu (samples có thể rỗng).
+    bool train(const float* samples, size_t sampleRows, size_t dimension, Type type);
+    // Mã hóa count hàng (song song trên ThreadPool::shared()) và nối vào cuối
+    void append(const float* rows, size_t count);
+
+    bool save(const std::string& filePath, uint64_t pathsHash) const;
+    bool load(const std::string& filePath, size_t dimension, uint64_t& pathsHash);
+    void clear();
+
+    bool empty() const { return dim == 0; }
+    size_t rows() const { return dim ? (kind == Float16 ? halves.size() : bytes.size()) / dim : 0; }
+    Type type() const { return kind; }
+    size_t bytesPerRow() const { return kind == Float16 ? dim * sizeof(uint16_t) : dim; }
+
+    // Bình phương khoảng cách xấp xỉ từ query (float32) tới một hàng đã mã hóa
+    float distance(const float* query, size_t row) const {
+        if (kind == Float16) return halfKernel(query, halves.data() + row * dim, dim);
+        return byteKernel(query, bytes.data() + row * dim, scale.data(), offset.data(), dim);
+    }
+
+private:
+    Type kind = Float16;
+    size_t dim = 0;
+    std::vector<float> scale;      // Int8: (max - min) / 255 theo từng chiều
+    std::vector<float> offset;     // Int8: min theo từng chiều
+    std::vector<uint16_t> halves;  // Float16: rows x dim
+    std::vector<uint8_t> bytes;    // Int8: rows x dim
+    DistanceKernels::SquaredL2HalfFn halfKernel;
+    DistanceKernels::SquaredL2ByteFn byteKernel;
+};
+
+#endif
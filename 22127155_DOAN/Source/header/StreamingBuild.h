@@ -0,0 +1,60 @@
+#ifndef STREAMING_BUILD_H
+#define STREAMING_BUILD_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Crash-safe database build. Finished rows are appended to segment files in
+// "<dbPath>.build/" as soon as they leave the pipeline; every few hundred images the
+// segment is fsync'd and a checkpoint (number of committed images, segment and byte
+// offset) is atomically replaced. A restarted build with the same image list and
+// extractor config resumes after the last committed image. finish() streams the
+// segments into the final .fdb file, so no stage ever holds the whole database in memory.
+class StreamingBuild {
+public:
+    static constexpr size_t CHECKPOINT_EVERY = 256;        // ảnh
+    static constexpr int CHECKPOINT_SECONDS = 30;
+    static constexpr uint64_t SEGMENT_BYTES = uint64_t(256) << 20;
+
+    // flags: cờ của file .fdb (FeatureStore::PACKED_ROWS)
+    StreamingBuild(const std::string& dbPath, const std::string& config, uint32_t flags = 0);
+    ~StreamingBuild();
+    StreamingBuild(const StreamingBuild&) = delete;
+    StreamingBuild& operator=(const StreamingBuild&) = delete;
+
+    // Chuẩn bị thư mục build. Trả về số ảnh đầu tiên của paths đã được commit ở lần chạy trước
+    size_t begin(const std::vector<std::string>& paths);
+
+    // Ghi một ảnh đã xử lý (features rỗng: ảnh lỗi, vẫn được ghi để không xử lý lại khi resume)
+    bool append(const std::string& path, const std::vector<float>& features);
+
+    // fsync segment hiện tại rồi ghi checkpoint mới (write tmp + fsync + rename)
+    bool checkpoint();
+
+    // Gộp các segment thành file database cuối cùng và xóa thư mục build
+    bool finish();
+
+    size_t committed() const { return committedImages; }
+
+private:
+    std::string segmentPath(uint64_t index) const;
+    bool openSegment(uint64_t index, bool append);
+    bool readCheckpoint(uint64_t& images, uint64_t& segment, uint64_t& bytes) const;
+
+    std::string dbPath;
+    std::string buildDir;
+    std::string config;
+    uint32_t storeFlags = 0;
+    uint64_t listHash = 0;
+    FILE* segment = nullptr;
+    uint64_t segmentIndex = 0;
+    uint64_t segmentBytes = 0;
+    size_t committedImages = 0;
+    size_t lastCheckpoint = 0;
+    std::chrono::steady_clock::time_point lastCheckpointTime;
+};
+
+#endif
@@ -7,9 +7,15 @@
 class TextureFeature : public FeatureExtractor {
 public:
     TextureFeature();
+    std::unique_ptr<FeatureExtractor> clone() const override {
+        return std::make_unique<TextureFeature>();
+    }
     
     std::vector<float> extract(const cv::Mat& image) override;
-    double compare(const std::vector<float>& feat1, const std::vector<float>& feat2) override;
+    double compare(const std::vector<float>& feat1, const std::vector<float>& feat2) const override;
+    double compareRaw(const float* feat1, const float* feat2, size_t dim) const override;
+    double compareBounded(const float* feat1, const float* feat2, size_t dim, double bound) const override;
+    bool usesL2Distance() const override { return true; }
     std::string getMethodName() const override;
     size_t getFeatureDimension() const override { return 8; } 
 private:
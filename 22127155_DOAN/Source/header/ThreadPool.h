@@ -0,0 +1,61 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool. Each worker owns a task deque: it pops its own tasks
+// from the back and, when idle, steals from the front of the other workers' deques,
+// so uneven tasks (large images, many keypoints) balance out automatically.
+class ThreadPool {
+public:
+    typedef std::function<void(size_t index, size_t worker)> IndexFn;
+
+    explicit ThreadPool(size_t threadCount = 0); // 0: số luồng phần cứng
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers.size(); }
+
+    // Gọi fn(i, worker) cho mọi i trong [begin, end), mỗi task gồm grain chỉ số liên tiếp.
+    // worker nằm trong [0, size()) nên có thể dùng làm chỉ số cho dữ liệu riêng của từng luồng.
+    // Chờ tới khi xong; exception đầu tiên (nếu có) được ném lại ở luồng gọi.
+    // Gọi lồng từ bên trong một task sẽ chạy tuần tự trên luồng hiện tại.
+    void parallelFor(size_t begin, size_t end, const IndexFn& fn, size_t grain = 1);
+
+    // Pool dùng chung cho toàn chương trình
+    static ThreadPool& shared();
+
+private:
+    struct Batch;
+    struct Task {
+        size_t begin;
+        size_t end;
+        Batch* batch;
+    };
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(size_t id);
+    bool popTask(size_t id, Task& task);
+    static void runTask(const Task& task, size_t worker);
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<size_t> pending{0};
+    bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef TOP_K_H
+#define TOP_K_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Một kết quả truy vấn: hàng trong database và khoảng cách tới query
+struct QueryHit {
+    uint32_t row;
+    double distance;
+
+    // Sắp theo khoảng cách, cùng khoảng cách thì hàng nhỏ hơn trước
+    bool operator<(const QueryHit& other) const {
+        return distance < other.distance || (distance == other.distance && row < other.row);
+    }
+};
+
+// Bounded max-heap that keeps the K smallest distances seen so far.
+// push() is O(1) for candidates worse than the current K-th best and O(log K) otherwise,
+// so ranking N rows costs O(N log K) and never stores more than K candidates.
+class TopK {
+public:
+    explicit TopK(size_t k = 0) { reset(k); }
+
+    // Dung lượng đã cấp phát được giữ lại, nên dùng lại một TopK không cấp phát thêm
+    void reset(size_t k) {
+        capacity = k;
+        heap.clear();
+        heap.reserve(k);
+    }
+
+    // Khoảng cách lớn nhất còn được nhận (dùng để bỏ sớm các ứng viên kém)
+    double worst() const { return full() ? heap.front().distance : std::numeric_limits<double>::infinity(); }
+    bool full() const { return heap.size() >= capacity; }
+    size_t size() const { return heap.size(); }
+
+    void push(double distance, uint32_t row) {
+        if (capacity == 0) return;
+        if (!full()) {
+            heap.push_back(QueryHit{row, distance});
+            std::push_heap(heap.begin(), heap.end());
+        } else if (QueryHit{row, distance} < heap.front()) {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.back() = QueryHit{row, distance};
+            std::push_heap(heap.begin(), heap.end());
+        }
+    }
+
+    // Gộp kết quả của một TopK khác (ví dụ của luồng khác)
+    void merge(const TopK& other) {
+        for (const auto& hit : other.heap) push(hit.distance, hit.row);
+    }
+
+    // Ghi các ứng viên theo khoảng cách tăng dần vào out (dùng lại dung lượng của out)
+    void sortedInto(std::vector<QueryHit>& out) const {
+        out.assign(heap.begin(), heap.end());
+        std::sort_heap(out.begin(), out.end());
+    }
+
+private:
+    size_t capacity = 0;
+    std::vector<QueryHit> heap;
+};
+
+#endif
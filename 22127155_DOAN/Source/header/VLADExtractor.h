@@ -0,0 +1,66 @@
+#ifndef VLAD_EXTRACTOR_H
+#define VLAD_EXTRACTOR_H
+
+#include "FeatureExtractor.h"
+#include "LocalFeature.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// VLAD (Vector of Locally Aggregated Descriptors): aggregates the local descriptors of a
+// SIFTExtractor/ORBExtractor into one fixed-size vector. A k-means codebook of `centres` centres
+// is trained on descriptors sampled from the gallery; each descriptor adds its residual
+// (x - nearest centre) to that centre's block, so the vector has centres x D dimensions
+// (D = 128 for SIFT, 256 bit values in {0, 1} for ORB). The vector is power-normalised
+// (sign(v) |v|^0.5, damps bursty repeated structures) and then L2-normalised, so ranking is a
+// plain Euclidean scan (usesL2Distance()) and every global-vector path applies: gemm batches,
+// IVF, HNSW, PQ/SQ codes.
+//
+// The codebook is part of the configuration: getConfig() contains its hash, so databases and
+// feature caches built with another codebook are not reused.
+// File (codebookPathFor(<db>)):
+//   [magic "CBIRVLAD", uint32 version, uint32 centres, uint32 descriptor dimension,
+//    uint32 base config length, base config bytes][centres: centres x D float32]
+class VLADExtractor : public FeatureExtractor {
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t DEFAULT_CENTRES = 64;
+    // Mẫu huấn luyện codebook: tối đa MAX_TRAIN_IMAGES ảnh và MAX_TRAIN_DESCRIPTORS descriptor
+    static constexpr size_t MAX_TRAIN_IMAGES = 1000;
+    static constexpr size_t MAX_TRAIN_DESCRIPTORS = 100000;
+    static constexpr int KMEANS_ITERATIONS = 20;
+
+    static std::string codebookPathFor(const std::string& dbPath) { return dbPath + ".vlad"; }
+
+    VLADExtractor(std::unique_ptr<LocalFeature> base, size_t centres = DEFAULT_CENTRES);
+    std::unique_ptr<FeatureExtractor> clone() const override;
+
+    // Huấn luyện codebook trên descriptor của một mẫu đều các ảnh (trích xuất song song)
+    bool train(const std::vector<std::string>& imagePaths);
+    bool saveCodebook(const std::string& filePath) const;
+    // Chỉ nhận codebook của cùng extractor cơ sở và cùng số tâm
+    bool loadCodebook(const std::string& filePath);
+    bool trained() const { return !codebook.empty(); }
+
+    // Ném runtime_error nếu codebook chưa được huấn luyện hoặc nạp
+    std::vector<float> extract(const cv::Mat& image) override;
+    double compare(const std::vector<float>& feat1, const std::vector<float>& feat2) const override;
+    double compareRaw(const float* feat1, const float* feat2, size_t dim) const override;
+    double compareBounded(const float* feat1, const float* feat2, size_t dim, double bound) const override;
+    bool usesL2Distance() const override { return true; }
+    std::string getMethodName() const override;
+    std::string getConfig() const override;
+    size_t getFeatureDimension() const override { return centreCount * descriptorDim; }
+
+private:
+    // Một descriptor dưới dạng descriptorDim float (ORB: mỗi bit một phần tử 0/1)
+    void unpackDescriptor(const uint8_t* descriptor, float* out) const;
+
+    std::unique_ptr<LocalFeature> base;
+    size_t centreCount;
+    size_t descriptorDim;
+    std::vector<float> codebook; // centreCount x descriptorDim
+    uint64_t codebookHash = 0;
+};
+
+#endif
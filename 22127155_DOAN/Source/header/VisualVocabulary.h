@@ -0,0 +1,86 @@
+#ifndef VISUAL_VOCABULARY_H
+#define VISUAL_VOCABULARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <utility>
+#include <vector>
+#include "DistanceKernels.h"
+
+// Vocabulary tree of visual words for local descriptors (hierarchical k-means).
+// The training descriptors are split into `branching` clusters, each cluster again into
+// `branching` clusters, down to `depth` levels; the leaves are the visual words (up to
+// branching^depth). Quantising a descriptor walks from the root to the nearest child at every
+// level, so it costs branching x depth distance computations instead of one per word.
+// Centres are stored as descriptors: uint8 means compared with squared Euclidean distance
+// (SIFT), or bitwise majority votes compared with Hamming distance (ORB, k-majority).
+//
+// Serialised inside the files of the structures that use it (write()/read()):
+//   [uint32 descriptorBytes, uint32 hamming, uint32 branching, uint32 depth, uint32 nodeCount,
+//    uint32 wordCount][nodes: nodeCount x (uint32 firstChild, uint32 childCount, uint32 word)]
+//   [centres: nodeCount x descriptorBytes uint8]
+class VisualVocabulary {
+public:
+    static constexpr size_t DEFAULT_BRANCHING = 10;
+    static constexpr size_t DEFAULT_DEPTH = 4;
+    // Số descriptor mẫu tối đa để huấn luyện
+    static constexpr size_t MAX_TRAIN_DESCRIPTORS = 200000;
+    static constexpr int KMEANS_ITERATIONS = 10;
+
+    VisualVocabulary();
+
+    // Huấn luyện trên count descriptor nằm liên tiếp (mỗi cái descriptorBytes byte), branching <= 256.
+    // Các nút cùng tầng được chia song song trên ThreadPool::shared(). hamming: descriptor nhị phân
+    // (bội số 8 byte).
+    bool train(const uint8_t* descriptors, size_t count, size_t descriptorBytes, bool hamming,
+               size_t branching = DEFAULT_BRANCHING, size_t depth = DEFAULT_DEPTH);
+    void clear();
+
+    bool empty() const { return nodes.empty(); }
+    size_t words() const { return wordCount; }
+    size_t descriptorBytes() const { return bytes; }
+    bool usesHamming() const { return hamming; }
+    size_t branching() const { return branch; }
+    size_t depth() const { return levels; }
+
+    // Từ (lá) của một descriptor: đi xuống nút con gần nhất ở mỗi tầng
+    uint32_t quantize(const uint8_t* descriptor) const;
+
+    // Nhánh chưa duyệt: (khoảng cách từ descriptor tới tâm, nút)
+    typedef std::pair<uint32_t, uint32_t> Branch;
+    // Như quantize() nhưng bắt đầu từ node (0: gốc); các nút con không được chọn ở mỗi tầng được
+    // đẩy vào min-heap pending (std::greater<Branch>) để duyệt tiếp theo thứ tự best-first
+    uint32_t descend(const uint8_t* descriptor, uint32_t node, std::vector<Branch>& pending) const;
+
+    void write(std::ofstream& out) const;
+    bool read(std::ifstream& in);
+
+private:
+    struct Node {
+        uint32_t firstChild = 0;
+        uint32_t childCount = 0; // 0: lá
+        uint32_t word = 0;       // chỉ có nghĩa với lá
+    };
+
+    // Khoảng cách từ query tới count tâm nằm liên tiếp
+    void distances(const uint8_t* query, const uint8_t* rows, size_t count, uint32_t* out) const {
+        if (hamming) hammingFn(query, rows, count, bytes, out);
+        else l2Fn(query, rows, count, bytes, out);
+    }
+    // k-means (k-majority nếu hamming) trên các descriptor members; labels[i] là cụm của members[i]
+    void kmeans(const uint8_t* descriptors, const std::vector<uint32_t>& members, size_t k, uint32_t seed,
+                std::vector<uint8_t>& centres, std::vector<uint32_t>& labels) const;
+
+    size_t bytes = 0;
+    bool hamming = false;
+    size_t branch = 0;
+    size_t levels = 0;
+    size_t wordCount = 0;
+    std::vector<Node> nodes;      // nút 0 là gốc, các con của một nút nằm liên tiếp
+    std::vector<uint8_t> centres; // nodes.size() x bytes (gốc: 0)
+    DistanceKernels::HammingFn hammingFn;
+    DistanceKernels::SquaredL2U8Fn l2Fn;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "BoundedQueue.h"
+#include "TestSupport.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Dung lượng được làm tròn lên lũy thừa của 2; tryPush báo đầy, tryPop báo rỗng, giữ thứ tự FIFO
+static void testSingleThread() {
+    BoundedQueue<int> queue(5);
+    CHECK(queue.capacity() == 8);
+    for (int i = 0; i < 8; ++i) CHECK(queue.tryPush(i));
+    CHECK(!queue.tryPush(8));
+    int value = -1;
+    for (int i = 0; i < 8; ++i) {
+        CHECK(queue.tryPop(value));
+        CHECK(value == i);
+    }
+    CHECK(!queue.tryPop(value));
+}
+
+// close() không làm mất phần tử: pop() vẫn trả hết những gì còn lại rồi mới trả false
+static void testCloseDrains() {
+    BoundedQueue<int> queue(4);
+    queue.push(1);
+    queue.push(2);
+    queue.close();
+    int value = 0;
+    CHECK(queue.pop(value) && value == 1);
+    CHECK(queue.pop(value) && value == 2);
+    CHECK(!queue.pop(value));
+}
+
+// Nhiều producer và consumer qua một hàng đợi nhỏ (push phải chờ khi đầy): mỗi phần tử được
+// nhận đúng một lần, và consumer thoát sau close() khi hàng đợi đã cạn
+static void testManyProducersConsumers() {
+    const int producers = 4, consumers = 3, perProducer = 20000;
+    BoundedQueue<int> queue(16);
+    vector<atomic<int>> seen(producers * perProducer);
+    for (auto& count : seen) count.store(0);
+
+    vector<thread> producerThreads, consumerThreads;
+    for (int c = 0; c < consumers; ++c) {
+        consumerThreads.emplace_back([&] {
+            int value;
+            while (queue.pop(value)) seen[value].fetch_add(1, memory_order_relaxed);
+        });
+    }
+    for (int p = 0; p < producers; ++p) {
+        producerThreads.emplace_back([&, p] {
+            for (int i = 0; i < perProducer; ++i) queue.push(p * perProducer + i);
+        });
+    }
+    for (auto& t : producerThreads) t.join();
+    queue.close();
+    for (auto& t : consumerThreads) t.join();
+
+    int missing = 0, duplicated = 0;
+    for (auto& count : seen) {
+        if (count.load() == 0) ++missing;
+        if (count.load() > 1) ++duplicated;
+    }
+    CHECK(missing == 0);
+    CHECK(duplicated == 0);
+}
+
+int main() {
+    testSingleThread();
+    testCloseDrains();
+    testManyProducersConsumers();
+    return testResult("BoundedQueueTest");
+}
@@ -0,0 +1,156 @@
+#include "DescriptorIndex.h"
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static const size_t BYTES = 128, IMAGES = 200, PER_IMAGE = 50, QUERIES = 300;
+
+static uint8_t clampByte(float value) { return static_cast<uint8_t>(min(255.0f, max(0.0f, value + 0.5f))); }
+
+static const size_t CENTRES = 64;
+
+// Một descriptor kiểu SIFT (128 byte) quanh một tâm ngẫu nhiên
+static void randomDescriptor(const vector<uint8_t>& centres, uint8_t* out, mt19937& rng) {
+    uniform_int_distribution<size_t> centreDist(0, CENTRES - 1);
+    normal_distribution<float> noise(0.0f, 20.0f);
+    const uint8_t* centre = centres.data() + centreDist(rng) * BYTES;
+    for (size_t i = 0; i < BYTES; ++i) out[i] = clampByte(centre[i] + noise(rng));
+}
+
+// Nạp PER_IMAGE descriptor mỗi ảnh vào store qua hàng đóng gói như database thật (số descriptor,
+// rồi các byte); all giữ mọi descriptor liên tiếp
+static void buildStore(const vector<uint8_t>& centres, DescriptorStore& store, vector<uint8_t>& all, mt19937& rng) {
+    const size_t dim = 1 + PER_IMAGE * BYTES / sizeof(float);
+    vector<float> row(dim);
+    store.reset(BYTES);
+    all.resize(IMAGES * PER_IMAGE * BYTES);
+    for (size_t image = 0; image < IMAGES; ++image) {
+        uint8_t* descriptors = all.data() + image * PER_IMAGE * BYTES;
+        for (size_t d = 0; d < PER_IMAGE; ++d) randomDescriptor(centres, descriptors + d * BYTES, rng);
+        row[0] = static_cast<float>(PER_IMAGE);
+        memcpy(row.data() + 1, descriptors, PER_IMAGE * BYTES);
+        store.appendRow(row.data(), dim);
+    }
+}
+
+// Ảnh chứa descriptor gần query nhất (brute force, L2 nguyên)
+static uint32_t nearestImage(const vector<uint8_t>& all, const uint8_t* query) {
+    uint64_t best = ~uint64_t(0);
+    size_t bestIndex = 0;
+    for (size_t index = 0; index < all.size() / BYTES; ++index) {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < BYTES; ++i) {
+            const int diff = int(query[i]) - int(all[index * BYTES + i]);
+            sum += static_cast<uint64_t>(diff * diff);
+        }
+        if (sum < best) {
+            best = sum;
+            bestIndex = index;
+        }
+    }
+    return static_cast<uint32_t>(bestIndex / PER_IMAGE);
+}
+
+// Tỉ lệ query mà ảnh của láng giềng gần nhất thật được bầu phiếu
+static double voteRecall(const DescriptorIndex& index, const DescriptorStore& store, const vector<uint8_t>& queries,
+                         const vector<uint32_t>& truth) {
+    size_t found = 0;
+    for (size_t q = 0; q < truth.size(); ++q) {
+        TopK best(IMAGES);
+        index.search(queries.data() + q * BYTES, 1, store, nullptr, best);
+        vector<QueryHit> hits;
+        best.sortedInto(hits);
+        for (const auto& hit : hits)
+            if (hit.row == truth[q] && hit.distance < 1.0) {
+                ++found;
+                break;
+            }
+    }
+    return static_cast<double>(found) / truth.size();
+}
+
+int main() {
+    mt19937 rng(25);
+    vector<uint8_t> centres(CENTRES * BYTES);
+    for (auto& value : centres) value = static_cast<uint8_t>(rng() & 0xFF);
+    DescriptorStore store;
+    vector<uint8_t> all;
+    buildStore(centres, store, all, rng);
+    CHECK(store.images() == IMAGES);
+    CHECK(store.size() == IMAGES * PER_IMAGE);
+
+    DescriptorIndex index;
+    const size_t depth = DescriptorIndex::depthFor(store.size(), store.size(), DescriptorIndex::DEFAULT_BRANCHING);
+    VisualVocabulary tree;
+    CHECK(tree.train(all.data(), store.size(), BYTES, false, DescriptorIndex::DEFAULT_BRANCHING, depth));
+    index.setTree(std::move(tree));
+    index.append(store);
+    CHECK(index.images() == IMAGES);
+    CHECK(index.size() == store.size());
+
+    // Query: descriptor mới cùng phân bố, không phải bản sao của descriptor gallery nào (trường hợp
+    // khó: láng giềng gần nhất thường nằm ở lá khác)
+    vector<uint8_t> queries(QUERIES * BYTES);
+    vector<uint32_t> truth(QUERIES);
+    for (size_t q = 0; q < QUERIES; ++q) {
+        randomDescriptor(centres, queries.data() + q * BYTES, rng);
+        truth[q] = nearestImage(all, queries.data() + q * BYTES);
+    }
+
+    // So với mọi descriptor thì luôn tìm được láng giềng gần nhất thật
+    index.setChecks(store.size());
+    CHECK(voteRecall(index, store, queries, truth) == 1.0);
+    index.setChecks(DescriptorIndex::LEAF_SIZE);
+    const double oneLeaf = voteRecall(index, store, queries, truth);
+    index.setChecks(DescriptorIndex::DEFAULT_CHECKS);
+    const double recall = voteRecall(index, store, queries, truth);
+    cout << "DescriptorIndexTest: nearest image voted at " << DescriptorIndex::LEAF_SIZE << " checks = " << oneLeaf
+         << ", at DEFAULT_CHECKS = " << recall << endl;
+    CHECK(recall >= oneLeaf);
+    CHECK(recall >= 0.95);
+
+    // Cả ảnh truy vấn (mọi descriptor của một ảnh cộng nhiễu) xếp chính ảnh đó đầu tiên
+    normal_distribution<float> noise(0.0f, 10.0f);
+    size_t top1 = 0;
+    vector<uint8_t> image(PER_IMAGE * BYTES);
+    for (size_t q = 0; q < 20; ++q) {
+        const size_t target = q * (IMAGES / 20);
+        const uint8_t* source = store.descriptors(target);
+        for (size_t i = 0; i < image.size(); ++i) image[i] = clampByte(source[i] + noise(rng));
+        TopK best(5);
+        index.search(image.data(), PER_IMAGE, store, nullptr, best);
+        vector<QueryHit> hits;
+        best.sortedInto(hits);
+        if (!hits.empty() && hits[0].row == target) ++top1;
+    }
+    CHECK(top1 == 20);
+
+    // Ảnh chết không được trả về
+    vector<uint8_t> dead(IMAGES, 1);
+    dead[7] = 0;
+    TopK best(5);
+    index.search(store.descriptors(3), PER_IMAGE, store, dead.data(), best);
+    vector<QueryHit> hits;
+    best.sortedInto(hits);
+    for (const auto& hit : hits) CHECK(hit.row == 7);
+
+    // Lưu rồi nạp lại cho cùng kết quả
+    const string dir = testDirectory("DescriptorIndexTest");
+    const string filePath = dir + "/gallery.fdb.kmt";
+    CHECK(index.save(filePath, 99));
+    DescriptorIndex loaded;
+    uint64_t pathsHash = 0;
+    CHECK(loaded.load(filePath, pathsHash));
+    CHECK(pathsHash == 99);
+    CHECK(loaded.size() == index.size());
+    CHECK(voteRecall(loaded, store, queries, truth) == recall);
+    fs::remove_all(dir);
+    return testResult("DescriptorIndexTest");
+}
@@ -0,0 +1,159 @@
+#include "DistanceKernels.h"
+#include "Half.h"
+#include "TestSupport.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+// Số chiều gồm các kích thước được unroll (8, 384, 512), bội số của khối 64 và phần đuôi lẻ
+static const size_t DIMS[] = {1, 7, 8, 15, 63, 64, 100, 384, 512, 1000};
+
+static vector<float> randomFloats(size_t count, mt19937& rng) {
+    uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    vector<float> values(count);
+    for (auto& value : values) value = dist(rng);
+    return values;
+}
+
+static bool close(double actual, double expected) {
+    return fabs(actual - expected) <= 1e-4 * (1.0 + fabs(expected));
+}
+
+// Mọi mức ISA mà CPU này chạy được (isa() là mức cao nhất đã phát hiện)
+static vector<DistanceKernels::Isa> supportedIsas() {
+    vector<DistanceKernels::Isa> isas;
+    for (int level = DistanceKernels::Scalar; level <= DistanceKernels::isa(); ++level)
+        isas.push_back(static_cast<DistanceKernels::Isa>(level));
+    return isas;
+}
+
+// Kernel L2 của từng mức khớp với kernel vô hướng và với tổng tính bằng double
+static void testSquaredL2() {
+    mt19937 rng(12);
+    DistanceKernels::SquaredL2Fn scalar = DistanceKernels::squaredL2Kernel(DistanceKernels::Scalar);
+    CHECK(scalar != nullptr);
+    for (size_t dim : DIMS) {
+        vector<float> a = randomFloats(dim, rng), b = randomFloats(dim, rng);
+        double expected = 0.0;
+        for (size_t i = 0; i < dim; ++i) expected += (double(a[i]) - b[i]) * (double(a[i]) - b[i]);
+        CHECK(close(scalar(a.data(), b.data(), dim), expected));
+        for (DistanceKernels::Isa isa : supportedIsas()) {
+            DistanceKernels::SquaredL2Fn kernel = DistanceKernels::squaredL2Kernel(isa);
+            if (!kernel) continue;
+            CHECK(close(kernel(a.data(), b.data(), dim), scalar(a.data(), b.data(), dim)));
+            CHECK(kernel(a.data(), a.data(), dim) == 0.0f);
+        }
+    }
+    const float x[2] = {3.0f, 0.0f}, y[2] = {0.0f, 4.0f};
+    CHECK(close(DistanceKernels::l2(x, y, 2), 5.0));
+}
+
+// Ngưỡng đủ lớn cho đúng tổng đầy đủ, ngưỡng nhỏ hơn khoảng cách thật cho +inf, mọi thứ tự khối
+// cho cùng kết quả
+static void testSquaredL2Bounded() {
+    mt19937 rng(14);
+    for (size_t dim : {8u, 64u, 100u, 384u, 1000u}) {
+        vector<float> a = randomFloats(dim, rng), b = randomFloats(dim, rng);
+        const float full = DistanceKernels::squaredL2(a.data(), b.data(), dim);
+        CHECK(close(DistanceKernels::squaredL2Bounded(a.data(), b.data(), dim, full * 1.01f), full));
+        CHECK(isinf(DistanceKernels::squaredL2Bounded(a.data(), b.data(), dim, full * 0.5f)));
+        CHECK(isinf(DistanceKernels::l2Bounded(a.data(), b.data(), dim, sqrt(full) * 0.5)));
+
+        const size_t blocks = (dim + DistanceKernels::BOUND_BLOCK - 1) / DistanceKernels::BOUND_BLOCK;
+        vector<uint32_t> order(blocks);
+        for (size_t i = 0; i < blocks; ++i) order[i] = static_cast<uint32_t>(blocks - 1 - i);
+        CHECK(close(DistanceKernels::squaredL2Bounded(a.data(), b.data(), dim, full * 1.01f, order.data()), full));
+    }
+}
+
+// Kernel float16 và byte của từng mức khớp với kernel vô hướng và với hàng đã giải mã
+static void testQuantizedKernels() {
+    mt19937 rng(18);
+    uniform_int_distribution<int> byteDist(0, 255);
+    for (size_t dim : DIMS) {
+        vector<float> query = randomFloats(dim, rng), decoded(dim), scale(dim), offset(dim);
+        vector<uint16_t> halfRow(dim);
+        vector<uint8_t> byteRow(dim);
+        for (size_t i = 0; i < dim; ++i) {
+            halfRow[i] = floatToHalf(randomFloats(1, rng)[0]);
+            byteRow[i] = static_cast<uint8_t>(byteDist(rng));
+            scale[i] = 2.0f / 255.0f;
+            offset[i] = -1.0f;
+        }
+
+        for (size_t i = 0; i < dim; ++i) decoded[i] = halfToFloat(halfRow[i]);
+        const double halfExpected = DistanceKernels::squaredL2Kernel(DistanceKernels::Scalar)(query.data(), decoded.data(), dim);
+        for (size_t i = 0; i < dim; ++i) decoded[i] = offset[i] + scale[i] * byteRow[i];
+        const double byteExpected = DistanceKernels::squaredL2Kernel(DistanceKernels::Scalar)(query.data(), decoded.data(), dim);
+
+        for (DistanceKernels::Isa isa : supportedIsas()) {
+            if (DistanceKernels::SquaredL2HalfFn kernel = DistanceKernels::squaredL2HalfKernel(isa))
+                CHECK(close(kernel(query.data(), halfRow.data(), dim), halfExpected));
+            if (DistanceKernels::SquaredL2ByteFn kernel = DistanceKernels::squaredL2ByteKernel(isa))
+                CHECK(close(kernel(query.data(), byteRow.data(), scale.data(), offset.data(), dim), byteExpected));
+        }
+    }
+}
+
+static vector<uint8_t> randomBytes(size_t count, mt19937& rng) {
+    uniform_int_distribution<int> dist(0, 255);
+    vector<uint8_t> values(count);
+    for (auto& value : values) value = static_cast<uint8_t>(dist(rng));
+    return values;
+}
+
+// Khoảng cách Hamming của từng mức khớp với đếm bit từng byte; ORB là 32 byte, count lẻ để
+// chạm phần đuôi của các kernel xử lý nhiều descriptor mỗi lượt
+static void testHamming() {
+    mt19937 rng(19);
+    for (size_t bytes : {8u, 32u, 64u}) {
+        for (size_t count : {1u, 2u, 5u, 13u}) {
+            vector<uint8_t> query = randomBytes(bytes, rng), rows = randomBytes(bytes * count, rng);
+            vector<uint32_t> expected(count, 0), out(count);
+            for (size_t r = 0; r < count; ++r)
+                for (size_t i = 0; i < bytes; ++i)
+                    for (uint8_t bits = query[i] ^ rows[r * bytes + i]; bits; bits &= bits - 1) ++expected[r];
+            for (DistanceKernels::Isa isa : supportedIsas()) {
+                DistanceKernels::HammingFn kernel = DistanceKernels::hammingKernel(isa);
+                if (!kernel) continue;
+                kernel(query.data(), rows.data(), count, bytes, out.data());
+                CHECK(out == expected);
+            }
+        }
+    }
+}
+
+// L2 nguyên trên uint8 của từng mức khớp chính xác với tổng tính tay; SIFT là 128 byte
+static void testSquaredL2U8() {
+    mt19937 rng(22);
+    for (size_t bytes : {8u, 32u, 128u}) {
+        for (size_t count : {1u, 3u, 9u}) {
+            vector<uint8_t> query = randomBytes(bytes, rng), rows = randomBytes(bytes * count, rng);
+            vector<uint32_t> expected(count, 0), out(count);
+            for (size_t r = 0; r < count; ++r)
+                for (size_t i = 0; i < bytes; ++i) {
+                    const int diff = int(query[i]) - int(rows[r * bytes + i]);
+                    expected[r] += static_cast<uint32_t>(diff * diff);
+                }
+            for (DistanceKernels::Isa isa : supportedIsas()) {
+                DistanceKernels::SquaredL2U8Fn kernel = DistanceKernels::squaredL2U8Kernel(isa);
+                if (!kernel) continue;
+                kernel(query.data(), rows.data(), count, bytes, out.data());
+                CHECK(out == expected);
+            }
+        }
+    }
+}
+
+int main() {
+    cout << "DistanceKernelsTest: isa " << DistanceKernels::isaName(DistanceKernels::isa()) << endl;
+    testSquaredL2();
+    testSquaredL2Bounded();
+    testQuantizedKernels();
+    testHamming();
+    testSquaredL2U8();
+    return testResult("DistanceKernelsTest");
+}
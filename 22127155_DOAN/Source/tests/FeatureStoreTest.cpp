@@ -0,0 +1,156 @@
+#include "FeatureStore.h"
+#include "TestSupport.h"
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static const size_t DIM = 12;
+
+static vector<float> rowValues(size_t row) {
+    vector<float> values(DIM);
+    for (size_t i = 0; i < DIM; ++i) values[i] = static_cast<float>(row * 100 + i) * 0.25f;
+    return values;
+}
+
+static string rowPath(size_t row) { return "images/" + to_string(row) + ".jpg"; }
+
+static bool writeStore(const string& filePath, size_t rows) {
+    FeatureStoreWriter writer;
+    if (!writer.open(filePath, "ColorHistogram", DIM)) return false;
+    for (size_t row = 0; row < rows; ++row)
+        if (!writer.append(rowPath(row), rowValues(row).data())) return false;
+    return writer.close();
+}
+
+// Kiểm tra đủ rows hàng đầu tiên: đường dẫn, ma trận và norm
+static void checkStore(const string& filePath, size_t rows) {
+    FeatureStoreHeader header{};
+    string config;
+    vector<string> paths;
+    FeatureMatrix matrix;
+    ColumnStats stats;
+    CHECK(FeatureStore::read(filePath, header, config, paths, matrix, stats));
+    CHECK(config == "ColorHistogram");
+    CHECK(header.rowCount == rows);
+    CHECK(paths.size() == rows);
+    CHECK(matrix.rows() == rows);
+    for (size_t row = 0; row < rows && row < paths.size() && row < matrix.rows(); ++row) {
+        CHECK(paths[row] == rowPath(row));
+        CHECK(vector<float>(matrix.row(row), matrix.row(row) + DIM) == rowValues(row));
+    }
+
+    for (bool streaming : {false, true}) {
+        FeatureStoreView view;
+        vector<string> viewPaths;
+        CHECK(view.open(filePath, viewPaths, streaming));
+        CHECK(view.rows() == rows);
+        CHECK(viewPaths == paths);
+        CHECK(view.norms().size() == rows);
+        for (size_t row = 0; row < rows && row < view.norms().size(); ++row) {
+            double norm = 0.0;
+            for (float value : rowValues(row)) norm += double(value) * value;
+            CHECK(fabs(view.norms()[row] - norm) <= 1e-4 * norm);
+        }
+        size_t scanned = 0;
+        bool matches = true;
+        view.scanBlocks([&](size_t firstRow, size_t count, const float* block) {
+            for (size_t i = 0; i < count; ++i)
+                matches = matches && vector<float>(block + i * DIM, block + (i + 1) * DIM) == rowValues(firstRow + i);
+            scanned += count;
+        }, DIM * sizeof(float) * 3);
+        CHECK(scanned == rows);
+        CHECK(matches);
+    }
+}
+
+// Ghi rồi đọc lại bằng read() và bằng view (map và streaming)
+static void testRoundTrip(const string& dir) {
+    const string filePath = dir + "/roundtrip.fdb";
+    CHECK(writeStore(filePath, 10));
+    CHECK(FeatureStore::isFeatureStore(filePath));
+    checkStore(filePath, 10);
+
+    const string emptyPath = dir + "/empty.fdb";
+    CHECK(writeStore(emptyPath, 0));
+    checkStore(emptyPath, 0);
+}
+
+// File bị cắt cụt ở bất kỳ vùng nào đều bị từ chối thay vì đọc quá cuối file
+static void testRejectsTruncated(const string& dir) {
+    const string filePath = dir + "/full.fdb";
+    CHECK(writeStore(filePath, 10));
+    const uint64_t size = fs::file_size(filePath);
+    for (uint64_t cut : {uint64_t(10), uint64_t(64), size / 2, size - 1}) {
+        const string truncated = dir + "/truncated.fdb";
+        fs::copy_file(filePath, truncated, fs::copy_options::overwrite_existing);
+        fs::resize_file(truncated, cut);
+        FeatureStoreHeader header{};
+        string config;
+        vector<string> paths;
+        FeatureMatrix matrix;
+        ColumnStats stats;
+        CHECK(!FeatureStore::read(truncated, header, config, paths, matrix, stats));
+        FeatureStoreView view;
+        CHECK(!view.open(truncated, paths));
+        CHECK(!view.isOpen());
+    }
+
+    // rowCount khổng lồ trong header: phép tính kích thước vùng không được tràn số
+    FeatureStoreHeader header{};
+    string config;
+    ifstream in(filePath, ios::binary);
+    CHECK(FeatureStore::readHeader(in, header, config));
+    header.rowCount = ~uint64_t(0) / 4;
+    CHECK(!FeatureStore::validLayout(header, size));
+}
+
+// Ghi thêm vào file có sẵn rồi mở lại: hàng cũ giữ nguyên, hàng mới nối tiếp, không còn file tạm
+static void testAppendAndReopen(const string& dir) {
+    const string filePath = dir + "/append.fdb";
+    CHECK(writeStore(filePath, 4));
+    for (size_t first : {size_t(4), size_t(7)}) {
+        FeatureStoreWriter writer;
+        CHECK(writer.openAppend(filePath, "ColorHistogram", DIM));
+        CHECK(writer.rows() == first);
+        for (size_t row = first; row < first + 3; ++row) CHECK(writer.append(rowPath(row), rowValues(row).data()));
+        CHECK(writer.close());
+    }
+    checkStore(filePath, 10);
+    CHECK(!fs::exists(filePath + ".tmp"));
+
+    // Cấu hình hoặc số chiều khác thì không được ghi thêm
+    FeatureStoreWriter mismatch;
+    CHECK(!mismatch.openAppend(filePath, "ColorHistogram", DIM + 1));
+    CHECK(!mismatch.openAppend(filePath, "EdgeFeature", DIM));
+}
+
+// Writer bị hủy trước close(): file gốc không đổi và file tạm bị xóa
+static void testAbandonedAppend(const string& dir) {
+    const string filePath = dir + "/abandon.fdb";
+    CHECK(writeStore(filePath, 5));
+    const uint64_t size = fs::file_size(filePath);
+    {
+        FeatureStoreWriter writer;
+        CHECK(writer.openAppend(filePath, "ColorHistogram", DIM));
+        CHECK(writer.append(rowPath(5), rowValues(5).data()));
+    }
+    CHECK(fs::file_size(filePath) == size);
+    CHECK(!fs::exists(filePath + ".tmp"));
+    checkStore(filePath, 5);
+}
+
+int main() {
+    const string dir = testDirectory("FeatureStoreTest");
+    testRoundTrip(dir);
+    testRejectsTruncated(dir);
+    testAppendAndReopen(dir);
+    testAbandonedAppend(dir);
+    fs::remove_all(dir);
+    return testResult("FeatureStoreTest");
+}
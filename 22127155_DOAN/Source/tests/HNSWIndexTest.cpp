@@ -0,0 +1,73 @@
+#include "HNSWIndex.h"
+#include "TestSupport.h"
+
+#include <filesystem>
+#include <vector>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static const size_t ROWS = 3000, DIM = 32, K = 10, QUERIES = 100;
+
+static vector<uint32_t> searchRows(const HNSWIndex& index, const float* query, const uint8_t* dead = nullptr) {
+    TopK best(K);
+    index.search(query, K, dead, best);
+    vector<QueryHit> hits;
+    best.sortedInto(hits);
+    vector<uint32_t> rows;
+    for (const auto& hit : hits) rows.push_back(hit.row);
+    return rows;
+}
+
+static double averageRecall(const HNSWIndex& index, const vector<float>& data, size_t rows, const vector<float>& queries) {
+    double total = 0.0;
+    for (size_t q = 0; q < QUERIES; ++q) {
+        const float* query = queries.data() + q * DIM;
+        total += recallOf(exactNeighbours(data.data(), rows, DIM, query, K), searchRows(index, query));
+    }
+    return total / QUERIES;
+}
+
+int main() {
+    // Các query là những hàng cuối được giữ lại, cùng phân bố nhưng không có trong index
+    const vector<float> all = clusteredRows(ROWS + QUERIES, DIM, 3, 16);
+    const vector<float> data(all.begin(), all.begin() + ROWS * DIM), queries(all.begin() + ROWS * DIM, all.end());
+
+    // Build song song trên một phần, chèn thêm phần còn lại như khi .fdb được append
+    HNSWIndex index;
+    CHECK(index.build(data.data(), ROWS * 2 / 3, DIM, HNSWIndex::Params()));
+    CHECK(index.extend(data.data(), ROWS));
+    CHECK(index.size() == ROWS);
+
+    const double recall = averageRecall(index, data, ROWS, queries);
+    cout << "HNSWIndexTest: recall@" << K << " at efSearch " << HNSWIndex::DEFAULT_EF_SEARCH << " = " << recall << endl;
+    CHECK(recall >= 0.95);
+    index.setEfSearch(256);
+    CHECK(averageRecall(index, data, ROWS, queries) >= recall);
+    index.setEfSearch(HNSWIndex::DEFAULT_EF_SEARCH);
+
+    // Hàng chết không bao giờ được trả về, kết quả vẫn đủ k
+    vector<uint8_t> dead(ROWS, 0);
+    for (size_t r = 0; r < ROWS; r += 3) dead[r] = 1;
+    for (size_t q = 0; q < QUERIES; ++q) {
+        vector<uint32_t> rows = searchRows(index, queries.data() + q * DIM, dead.data());
+        CHECK(rows.size() == K);
+        for (uint32_t row : rows) CHECK(!dead[row]);
+    }
+
+    // Lưu rồi nạp lại cho đúng cùng kết quả
+    const string dir = testDirectory("HNSWIndexTest");
+    const string filePath = dir + "/gallery.fdb.hnsw";
+    CHECK(index.save(filePath, 42));
+    HNSWIndex loaded;
+    uint64_t pathsHash = 0;
+    CHECK(!loaded.load(filePath, DIM + 1, pathsHash));
+    CHECK(loaded.load(filePath, DIM, pathsHash));
+    CHECK(pathsHash == 42);
+    CHECK(loaded.size() == ROWS);
+    loaded.attach(data.data());
+    for (size_t q = 0; q < QUERIES; ++q)
+        CHECK(searchRows(loaded, queries.data() + q * DIM) == searchRows(index, queries.data() + q * DIM));
+    fs::remove_all(dir);
+    return testResult("HNSWIndexTest");
+}
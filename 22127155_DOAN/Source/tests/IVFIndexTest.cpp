@@ -0,0 +1,88 @@
+#include "IVFIndex.h"
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static const size_t ROWS = 2000, DIM = 16, K = 10, QUERIES = 100;
+
+// Mỗi hàng nằm trong đúng một cell
+static void testListsPartitionRows(const IVFIndex& index) {
+    vector<int> seen(ROWS, 0);
+    size_t total = 0;
+    for (size_t cell = 0; cell < index.lists(); ++cell) {
+        for (size_t i = 0; i < index.listSize(cell); ++i) {
+            const uint32_t row = index.listRows(cell)[i];
+            CHECK(row < ROWS);
+            if (row < ROWS) seen[row]++;
+        }
+        total += index.listSize(cell);
+    }
+    CHECK(total == ROWS);
+    CHECK(count(seen.begin(), seen.end(), 1) == static_cast<long>(ROWS));
+}
+
+// Recall@K trung bình khi chỉ xếp hạng chính xác các hàng trong nprobe cell gần nhất
+static double probeRecall(const IVFIndex& index, const vector<float>& data, const vector<float>& queries, size_t nprobe) {
+    vector<uint32_t> cells;
+    double total = 0.0;
+    for (size_t q = 0; q < QUERIES; ++q) {
+        const float* query = queries.data() + q * DIM;
+        index.probe(query, nprobe, cells);
+        TopK best(K);
+        for (uint32_t cell : cells) {
+            for (size_t i = 0; i < index.listSize(cell); ++i) {
+                const uint32_t row = index.listRows(cell)[i];
+                double sum = 0.0;
+                for (size_t d = 0; d < DIM; ++d) sum += (double(data[row * DIM + d]) - query[d]) * (double(data[row * DIM + d]) - query[d]);
+                best.push(sum, row);
+            }
+        }
+        vector<QueryHit> hits;
+        best.sortedInto(hits);
+        vector<uint32_t> found;
+        for (const auto& hit : hits) found.push_back(hit.row);
+        total += recallOf(exactNeighbours(data.data(), ROWS, DIM, query, K), found);
+    }
+    return total / QUERIES;
+}
+
+int main() {
+    // Các query là những hàng cuối được giữ lại, cùng phân bố nhưng không có trong index
+    const vector<float> all = clusteredRows(ROWS + QUERIES, DIM, 40, 15);
+    const vector<float> data(all.begin(), all.begin() + ROWS * DIM), queries(all.begin() + ROWS * DIM, all.end());
+
+    IVFIndex index;
+    CHECK(index.build(data.data(), ROWS, DIM, IVFIndex::defaultListCount(ROWS)));
+    CHECK(index.lists() == IVFIndex::defaultListCount(ROWS));
+    testListsPartitionRows(index);
+
+    // Probe mọi cell thì chính xác; mặc định của DatabaseManager (8 cell) phải giữ recall cao
+    vector<uint32_t> cells;
+    index.probe(queries.data(), index.lists(), cells);
+    CHECK(cells.size() == index.lists());
+    CHECK(probeRecall(index, data, queries, index.lists()) == 1.0);
+    const double recall = probeRecall(index, data, queries, 8);
+    cout << "IVFIndexTest: recall@" << K << " with 8/" << index.lists() << " cells = " << recall << endl;
+    CHECK(recall >= 0.9);
+
+    // Lưu rồi nạp lại cho cùng các cell; file của database khác (size/mtime) bị bỏ qua
+    const string dir = testDirectory("IVFIndexTest");
+    const string filePath = dir + "/gallery.fdb.ivf";
+    CHECK(index.save(filePath, 1234, 56));
+    IVFIndex loaded;
+    CHECK(!loaded.load(filePath, ROWS, DIM, 1235, 56));
+    CHECK(!loaded.load(filePath, ROWS + 1, DIM, 1234, 56));
+    CHECK(loaded.load(filePath, ROWS, DIM, 1234, 56));
+    CHECK(loaded.lists() == index.lists());
+    for (size_t cell = 0; cell < index.lists() && cell < loaded.lists(); ++cell) {
+        CHECK(loaded.listSize(cell) == index.listSize(cell));
+        CHECK(equal(index.listRows(cell), index.listRows(cell) + index.listSize(cell), loaded.listRows(cell)));
+    }
+    fs::remove_all(dir);
+    return testResult("IVFIndexTest");
+}
@@ -0,0 +1,81 @@
+#include "LSHIndex.h"
+#include "TestSupport.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+static const size_t BYTES = 32, IMAGES = 200, PER_IMAGE = 50, QUERIES = 300;
+
+// Nạp ảnh [first, last) của all (PER_IMAGE descriptor ORB mỗi ảnh) vào store qua hàng đóng gói
+static void appendImages(DescriptorStore& store, const vector<uint8_t>& all, size_t first, size_t last) {
+    const size_t dim = 1 + PER_IMAGE * BYTES / sizeof(float);
+    vector<float> row(dim);
+    for (size_t image = first; image < last; ++image) {
+        row[0] = static_cast<float>(PER_IMAGE);
+        memcpy(row.data() + 1, all.data() + image * PER_IMAGE * BYTES, PER_IMAGE * BYTES);
+        store.appendRow(row.data(), dim);
+    }
+}
+
+// Ảnh có nhiều phiếu nhất cho count descriptor query (IMAGES nếu không ảnh nào được bầu)
+static uint32_t topImage(const LSHIndex& index, const DescriptorStore& store, const uint8_t* query, size_t count,
+                         const uint8_t* dead = nullptr) {
+    TopK best(1);
+    index.search(query, count, store, dead, best);
+    vector<QueryHit> hits;
+    best.sortedInto(hits);
+    return hits.empty() || hits[0].distance >= 1.0 ? static_cast<uint32_t>(IMAGES) : hits[0].row;
+}
+
+int main() {
+    mt19937 rng(24);
+    vector<uint8_t> all(IMAGES * PER_IMAGE * BYTES);
+    for (auto& value : all) value = static_cast<uint8_t>(rng() & 0xFF);
+
+    // Băm theo hai đợt như khi database được append
+    DescriptorStore store;
+    store.reset(BYTES);
+    LSHIndex index;
+    CHECK(index.setup(BYTES, LSHIndex::Params()));
+    appendImages(store, all, 0, IMAGES / 2);
+    index.append(store);
+    appendImages(store, all, IMAGES / 2, IMAGES);
+    index.append(store);
+    CHECK(index.images() == IMAGES);
+
+    // Tham số không hợp lệ bị từ chối
+    LSHIndex invalid;
+    LSHIndex::Params tooWide;
+    tooWide.keyBits = LSHIndex::MAX_KEY_BITS + 1;
+    CHECK(!invalid.setup(BYTES, tooWide));
+
+    // Descriptor gallery lật vài bit (nhiễu của ORB giữa hai ảnh cùng vật): một descriptor query đơn
+    // lẻ phải va chạm với bản gốc ở ít nhất một bảng trong phần lớn trường hợp
+    uniform_int_distribution<size_t> pick(0, store.size() - 1), bit(0, BYTES * 8 - 1);
+    for (size_t flips : {size_t(0), size_t(12)}) {
+        size_t found = 0;
+        vector<uint8_t> query(BYTES);
+        for (size_t q = 0; q < QUERIES; ++q) {
+            const size_t source = pick(rng);
+            memcpy(query.data(), store.descriptor(source), BYTES);
+            for (size_t f = 0; f < flips; ++f) {
+                const size_t b = bit(rng);
+                query[b / 8] ^= static_cast<uint8_t>(1u << (b % 8));
+            }
+            if (topImage(index, store, query.data(), 1) == store.imageOf(source)) ++found;
+        }
+        const double recall = static_cast<double>(found) / QUERIES;
+        cout << "LSHIndexTest: source image found with " << flips << " flipped bits = " << recall << endl;
+        CHECK(flips == 0 ? recall == 1.0 : recall >= 0.9);
+    }
+
+    // Cả ảnh truy vấn xếp chính ảnh đó đầu tiên; ảnh chết không được trả về
+    for (size_t image = 0; image < IMAGES; image += 10) CHECK(topImage(index, store, store.descriptors(image), PER_IMAGE) == image);
+    vector<uint8_t> dead(IMAGES, 0);
+    dead[5] = 1;
+    CHECK(topImage(index, store, store.descriptors(5), PER_IMAGE, dead.data()) != 5);
+    return testResult("LSHIndexTest");
+}
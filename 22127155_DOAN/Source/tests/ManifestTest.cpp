@@ -0,0 +1,127 @@
+#include "ColorHistogram.h"
+#include "DatabaseManager.h"
+#include "Manifest.h"
+#include "TestSupport.h"
+
+#include <filesystem>
+#include <opencv2/opencv.hpp>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+// Entry được sắp theo path, liveRows bỏ qua ảnh lỗi (NO_ROW), save/load giữ nguyên mọi trường
+static void testSaveLoad(const string& dir) {
+    Manifest manifest;
+    vector<ManifestEntry> entries(3);
+    entries[0].path = "c.png";
+    entries[0].row = 2;
+    entries[1].path = "a.png";
+    entries[1].row = 0;
+    entries[1].size = 123;
+    entries[1].mtime = -5;
+    entries[1].contentHash = 0xABCDEF;
+    entries[2].path = "b.png";
+    entries[2].row = Manifest::NO_ROW;
+    manifest.assign(std::move(entries));
+    manifest.setRowCount(4);
+    CHECK(manifest.entries().size() == 3);
+    CHECK(manifest.entries()[0].path == "a.png" && manifest.entries()[2].path == "c.png");
+    CHECK(manifest.liveRows() == 2);
+    CHECK(manifest.find("b.png") != nullptr);
+    CHECK(manifest.find("d.png") == nullptr);
+
+    const string filePath = dir + "/unit.manifest";
+    CHECK(manifest.save(filePath));
+    Manifest loaded;
+    CHECK(loaded.load(filePath));
+    CHECK(loaded.rowCount() == 4);
+    CHECK(loaded.entries().size() == 3);
+    const ManifestEntry* a = loaded.find("a.png");
+    CHECK(a && a->row == 0 && a->size == 123 && a->mtime == -5 && a->contentHash == 0xABCDEF);
+
+    // Manifest bị cắt cụt không được nạp một phần
+    fs::resize_file(filePath, fs::file_size(filePath) - 3);
+    CHECK(!loaded.load(filePath));
+    CHECK(loaded.entries().empty() && loaded.rowCount() == 0);
+}
+
+static string writeImage(const string& dir, const string& name, const cv::Scalar& color, int width = 32, int height = 24) {
+    const string path = dir + "/" + name;
+    cv::imwrite(path, cv::Mat(height, width, CV_8UC3, color));
+    return path;
+}
+
+// Mọi hàng của manifest khác nhau và nằm trong file; rowCount khớp với file .fdb
+static void checkManifest(const string& dbPath, size_t rowCount, size_t liveRows) {
+    Manifest manifest;
+    CHECK(manifest.load(Manifest::pathFor(dbPath)));
+    CHECK(manifest.rowCount() == rowCount);
+    CHECK(manifest.liveRows() == liveRows);
+    set<uint32_t> rows;
+    for (const auto& entry : manifest.entries()) {
+        if (entry.row == Manifest::NO_ROW) continue;
+        CHECK(entry.row < rowCount);
+        CHECK(rows.insert(entry.row).second);
+    }
+    FeatureStoreView view;
+    vector<string> paths;
+    CHECK(view.open(dbPath, paths, true));
+    CHECK(view.rows() == rowCount);
+    for (const auto& entry : manifest.entries())
+        if (entry.row != Manifest::NO_ROW && entry.row < paths.size()) CHECK(paths[entry.row] == entry.path);
+}
+
+// Build, rồi xóa 3/8 ảnh và sửa 1 ảnh: cập nhật chỉ trích xuất ảnh đã sửa, 4/9 hàng chết vượt
+// COMPACT_DEAD_RATIO nên file được nén lại còn 5 hàng; thêm một ảnh sau đó chỉ ghi thêm một hàng
+static void testUpdateAndCompaction(const string& dir) {
+    const cv::Scalar colors[] = {cv::Scalar(255, 0, 0),   cv::Scalar(0, 255, 0),     cv::Scalar(0, 0, 255),
+                                 cv::Scalar(0, 255, 255), cv::Scalar(255, 255, 0),   cv::Scalar(255, 0, 255),
+                                 cv::Scalar(128, 128, 128), cv::Scalar(0, 0, 0)};
+    vector<string> gallery;
+    for (int i = 0; i < 8; ++i) gallery.push_back(writeImage(dir, "img" + to_string(i) + ".png", colors[i]));
+    const string dbPath = dir + "/gallery.fdb";
+
+    DatabaseManager db(new ColorHistogram());
+    CHECK(db.buildDatabase(gallery, dbPath));
+    CHECK(db.getDatabaseSize() == 8);
+    checkManifest(dbPath, 8, 8);
+
+    // Không có gì thay đổi: file không bị ghi lại
+    const auto writeTime = fs::last_write_time(dbPath);
+    CHECK(db.updateDatabase(gallery, dbPath));
+    CHECK(fs::last_write_time(dbPath) == writeTime);
+    checkManifest(dbPath, 8, 8);
+
+    for (int i = 5; i < 8; ++i) fs::remove(gallery[i]);
+    gallery.resize(5);
+    writeImage(dir, "img0.png", cv::Scalar(255, 255, 255), 48, 40);
+    CHECK(db.updateDatabase(gallery, dbPath));
+    CHECK(db.getDatabaseSize() == 5);
+    checkManifest(dbPath, 5, 5);
+
+    // Ảnh đã sửa được trích xuất lại: truy vấn bằng chính nó trả về nó với khoảng cách 0
+    auto results = db.query(cv::Mat(40, 48, CV_8UC3, cv::Scalar(255, 255, 255)), 1);
+    CHECK(results.size() == 1);
+    if (!results.empty()) CHECK(results[0].first == gallery[0] && results[0].second < 1e-6);
+
+    gallery.push_back(writeImage(dir, "img8.png", colors[5]));
+    CHECK(db.updateDatabase(gallery, dbPath));
+    CHECK(db.getDatabaseSize() == 6);
+    checkManifest(dbPath, 6, 6);
+
+    // Database mở lại từ file thấy đúng các ảnh còn sống
+    DatabaseManager reopened(new ColorHistogram());
+    CHECK(reopened.openDatabase(dbPath));
+    CHECK(reopened.getDatabaseSize() == 6);
+}
+
+int main() {
+    const string dir = testDirectory("ManifestTest");
+    testSaveLoad(dir);
+    testUpdateAndCompaction(dir);
+    fs::remove_all(dir);
+    return testResult("ManifestTest");
+}
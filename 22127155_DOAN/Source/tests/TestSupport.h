@@ -0,0 +1,87 @@
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "TopK.h"
+
+// Bộ kiểm tra tối giản cho CTest: CHECK ghi lỗi rồi chạy tiếp, main trả về testResult()
+inline int& testFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                        \
+    do {                                                                                        \
+        if (!(condition)) {                                                                     \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+            ++testFailures();                                                                   \
+        }                                                                                       \
+    } while (0)
+
+inline int testResult(const char* name) {
+    if (testFailures() == 0) {
+        std::cout << name << ": ok" << std::endl;
+        return 0;
+    }
+    std::cerr << name << ": " << testFailures() << " check(s) failed" << std::endl;
+    return 1;
+}
+
+// Thư mục tạm riêng cho từng test, xóa sạch trước khi dùng
+inline std::string testDirectory(const std::string& name) {
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / ("22127155_" + name);
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    return dir.string();
+}
+
+// rows hàng dim chiều quanh clusters tâm ngẫu nhiên: gần với đặc trưng ảnh thật hơn dữ liệu đều,
+// và là trường hợp mà các index xấp xỉ phải xử lý tốt
+inline std::vector<float> clusteredRows(size_t rows, size_t dim, size_t clusters, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> centre(0.0f, 10.0f);
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    std::vector<float> centres(clusters * dim);
+    for (auto& value : centres) value = centre(rng);
+    std::vector<float> data(rows * dim);
+    for (size_t r = 0; r < rows; ++r) {
+        const float* c = centres.data() + (r % clusters) * dim;
+        for (size_t i = 0; i < dim; ++i) data[r * dim + i] = c[i] + noise(rng);
+    }
+    return data;
+}
+
+// k hàng gần query nhất theo L2, tính brute force
+inline std::vector<uint32_t> exactNeighbours(const float* data, size_t rows, size_t dim, const float* query, size_t k) {
+    TopK best(k);
+    for (size_t r = 0; r < rows; ++r) {
+        double sum = 0.0;
+        for (size_t i = 0; i < dim; ++i) sum += (double(data[r * dim + i]) - query[i]) * (double(data[r * dim + i]) - query[i]);
+        best.push(sum, static_cast<uint32_t>(r));
+    }
+    std::vector<QueryHit> hits;
+    best.sortedInto(hits);
+    std::vector<uint32_t> ids;
+    for (const auto& hit : hits) ids.push_back(hit.row);
+    return ids;
+}
+
+// Tỉ lệ hàng của truth có mặt trong found (recall@k)
+inline double recallOf(const std::vector<uint32_t>& truth, const std::vector<uint32_t>& found) {
+    if (truth.empty()) return 1.0;
+    size_t hit = 0;
+    for (uint32_t row : truth)
+        for (uint32_t other : found)
+            if (row == other) {
+                ++hit;
+                break;
+            }
+    return static_cast<double>(hit) / truth.size();
+}
+
+#endif
@@ -0,0 +1,97 @@
+#include "TestSupport.h"
+#include "TopK.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+// Giữ đúng K khoảng cách nhỏ nhất, trả về theo thứ tự tăng dần
+static void testKeepsSmallest() {
+    mt19937 rng(7);
+    uniform_real_distribution<double> dist(0.0, 100.0);
+    vector<QueryHit> all;
+    TopK top(10);
+    for (uint32_t row = 0; row < 1000; ++row) {
+        double d = dist(rng);
+        all.push_back(QueryHit{row, d});
+        top.push(d, row);
+    }
+    sort(all.begin(), all.end());
+    vector<QueryHit> hits;
+    top.sortedInto(hits);
+    CHECK(top.full());
+    CHECK(hits.size() == 10);
+    for (size_t i = 0; i < hits.size() && i < all.size(); ++i) {
+        CHECK(hits[i].row == all[i].row);
+        CHECK(hits[i].distance == all[i].distance);
+    }
+    CHECK(top.worst() == all[9].distance);
+}
+
+// Cùng khoảng cách thì hàng nhỏ hơn thắng, bất kể thứ tự push
+static void testTiesPreferLowerRow() {
+    TopK top(3);
+    for (uint32_t row : {9u, 4u, 7u, 1u, 5u}) top.push(2.0, row);
+    top.push(3.0, 0);
+    vector<QueryHit> hits;
+    top.sortedInto(hits);
+    CHECK(hits.size() == 3);
+    if (hits.size() == 3) {
+        CHECK(hits[0].row == 1);
+        CHECK(hits[1].row == 4);
+        CHECK(hits[2].row == 5);
+    }
+}
+
+// Gộp TopK từng luồng cho cùng kết quả như một TopK duy nhất
+static void testMerge() {
+    TopK whole(5), left(5), right(5);
+    for (uint32_t row = 0; row < 40; ++row) {
+        double d = static_cast<double>((row * 37) % 23);
+        whole.push(d, row);
+        (row % 2 ? left : right).push(d, row);
+    }
+    left.merge(right);
+    vector<QueryHit> expected, merged;
+    whole.sortedInto(expected);
+    left.sortedInto(merged);
+    CHECK(merged.size() == expected.size());
+    for (size_t i = 0; i < merged.size() && i < expected.size(); ++i) {
+        CHECK(merged[i].row == expected[i].row);
+        CHECK(merged[i].distance == expected[i].distance);
+    }
+}
+
+// K = 0 không nhận gì; ít ứng viên hơn K thì trả về tất cả
+static void testSmallCapacities() {
+    TopK empty(0);
+    empty.push(1.0, 1);
+    CHECK(empty.size() == 0);
+
+    TopK top(4);
+    top.push(3.0, 3);
+    top.push(1.0, 1);
+    CHECK(!top.full());
+    vector<QueryHit> hits;
+    top.sortedInto(hits);
+    CHECK(hits.size() == 2);
+    if (hits.size() == 2) CHECK(hits[0].row == 1 && hits[1].row == 3);
+
+    top.reset(1);
+    CHECK(top.size() == 0);
+    top.push(5.0, 2);
+    top.push(4.0, 8);
+    top.sortedInto(hits);
+    CHECK(hits.size() == 1);
+    if (hits.size() == 1) CHECK(hits[0].row == 8);
+}
+
+int main() {
+    testKeepsSmallest();
+    testTiesPreferLowerRow();
+    testMerge();
+    testSmallCapacities();
+    return testResult("TopKTest");
+}